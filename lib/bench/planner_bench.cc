@@ -0,0 +1,422 @@
+// Micro-benchmarks for the read planning path: chunk enumeration, hyperslab
+// mapping, segment planning, planning in parallel and the response scatter.
+// Everything runs on in-memory metadata; no client is created and nothing
+// touches the network.
+//
+//   arraymorph_bench --benchmark_filter=BM_Plan/rank:3
+//   arraymorph_bench --benchmark_out=plan.json --benchmark_out_format=json
+//
+// Arguments are {rank, pattern, chunk divisor}: the dataset is a hypercube of
+// DATASET_ELEMENTS elements split into divisor^rank chunks.
+
+#include "arraymorph/core/operators.h"
+#include "arraymorph/core/plan_stream.h"
+#include "arraymorph/core/planner.h"
+#include "arraymorph/core/utils.h"
+#include "arraymorph/s3vl/dataset_obj.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// ---- allocation counting
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+// ---- datasets and selections
+
+const hsize_t DATASET_ELEMENTS = 1 << 24;
+const int RANDOM_POINTS = 64;
+const int STRIDED_ROWS = 8;
+
+enum Pattern { ROW = 0, COLUMN, TILE, STRIDED, RANDOM };
+const char *PATTERN_NAMES[] = {"row", "column", "tile", "strided", "random"};
+
+typedef std::vector<std::vector<hsize_t>> Ranges;
+
+static hsize_t sideFor(int rank) {
+  return (hsize_t)std::floor(std::pow((double)DATASET_ELEMENTS, 1.0 / rank));
+}
+
+static std::unique_ptr<S3VLDatasetObj> makeDataset(int rank, hsize_t divisor) {
+  hsize_t side = sideFor(rank);
+  std::vector<hsize_t> shape(rank, side);
+  std::vector<hsize_t> chunk_shape(rank, (side + divisor - 1) / divisor);
+  int chunk_num = 1;
+  for (int i = 0; i < rank; i++)
+    chunk_num *= (side - 1) / chunk_shape[i] + 1;
+  return std::make_unique<S3VLDatasetObj>("bench", "bench", H5T_NATIVE_FLOAT,
+                                          rank, shape, chunk_shape, chunk_num,
+                                          nullptr);
+}
+
+// The connector plans a read by the bounding box of its selection, so strided
+// rows and random points are modelled as one H5Dread per row / point.
+static std::vector<Ranges> selections(const S3VLDatasetObj &dset,
+                                      Pattern pattern) {
+  int rank = dset.ndims;
+  hsize_t n = dset.shape[0];
+  Ranges full(rank);
+  for (int i = 0; i < rank; i++)
+    full[i] = {0, n - 1};
+  std::vector<Ranges> out;
+  switch (pattern) {
+  case ROW: {
+    Ranges r = full;
+    r[0] = {n / 2, n / 2};
+    out.push_back(r);
+    break;
+  }
+  case COLUMN: {
+    Ranges r = full;
+    r[rank - 1] = {n / 2, n / 2};
+    out.push_back(r);
+    break;
+  }
+  case TILE: {
+    Ranges r(rank);
+    for (int i = 0; i < rank; i++)
+      r[i] = {n / 4, 3 * n / 4 - 1};
+    out.push_back(r);
+    break;
+  }
+  case STRIDED:
+    for (int j = 0; j < STRIDED_ROWS; j++) {
+      Ranges r = full;
+      r[0] = {j * n / STRIDED_ROWS, j * n / STRIDED_ROWS};
+      out.push_back(r);
+    }
+    break;
+  case RANDOM: {
+    std::mt19937_64 rng(42);
+    for (int j = 0; j < RANDOM_POINTS; j++) {
+      Ranges r(rank);
+      for (int i = 0; i < rank; i++) {
+        hsize_t x = rng() % n;
+        r[i] = {x, x};
+      }
+      out.push_back(r);
+    }
+    break;
+  }
+  }
+  return out;
+}
+
+// destination is a packed buffer of the selection's shape, as h5py passes it
+static std::vector<std::list<std::vector<hsize_t>>>
+mapSelection(S3VLDatasetObj &dset,
+             std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
+             const Ranges &ranges) {
+  int rank = dset.ndims;
+  Ranges out_ranges(rank);
+  std::vector<hsize_t> out_shape(rank);
+  for (int i = 0; i < rank; i++) {
+    out_shape[i] = ranges[i][1] - ranges[i][0] + 1;
+    out_ranges[i] = {0, out_shape[i] - 1};
+  }
+  std::vector<hsize_t> out_offsets = calSerialOffsets(out_ranges, out_shape);
+  hsize_t out_row_size = out_shape[rank - 1];
+  std::vector<std::list<std::vector<hsize_t>>> mappings(chunk_objs.size());
+  for (size_t i = 0; i < chunk_objs.size(); i++) {
+    hsize_t input_row_size = chunk_objs[i]->ranges[rank - 1][1] -
+                             chunk_objs[i]->ranges[rank - 1][0] + 1;
+    mappings[i] = mapHyperslab(chunk_objs[i]->local_offsets,
+                               chunk_objs[i]->global_offsets, out_offsets,
+                               input_row_size, out_row_size, dset.data_size);
+  }
+  return mappings;
+}
+
+static hsize_t selectionBytes(const S3VLDatasetObj &dset, const Ranges &r) {
+  hsize_t n = dset.data_size;
+  for (auto &d : r)
+    n *= d[1] - d[0] + 1;
+  return n;
+}
+
+// ---- reporting
+
+struct Tally {
+  uint64_t chunks = 0;
+  uint64_t planned_bytes = 0;
+  uint64_t allocations = 0;
+};
+
+static void report(benchmark::State &state, const Tally &t, Pattern pattern) {
+  state.SetLabel(PATTERN_NAMES[pattern]);
+  state.counters["chunks"] = benchmark::Counter(
+      t.chunks, benchmark::Counter::kAvgIterations);
+  // seconds per chunk, printed with SI prefixes (ns, us)
+  state.counters["per_chunk"] = benchmark::Counter(
+      t.chunks, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["allocs"] = benchmark::Counter(
+      t.allocations, benchmark::Counter::kAvgIterations);
+  if (t.planned_bytes)
+    state.counters["planned_bytes"] = benchmark::Counter(
+        t.planned_bytes, benchmark::Counter::kAvgIterations,
+        benchmark::Counter::kIs1024);
+}
+
+// ---- benchmarks
+
+static void BM_GenerateChunks(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto &r : sels) {
+      auto chunk_objs = dset->generateChunks(r);
+      t.chunks += chunk_objs.size();
+      benchmark::DoNotOptimize(chunk_objs.data());
+    }
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+}
+
+static void BM_CalSerialOffsets(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  // the per-chunk local ranges calSerialOffsets sees inside generateChunks
+  std::vector<Ranges> local;
+  for (auto &r : sels)
+    for (auto &c : dset->generateChunks(r))
+      local.push_back(c->ranges);
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto &r : local) {
+      auto offsets = calSerialOffsets(r, dset->chunk_shape);
+      benchmark::DoNotOptimize(offsets.data());
+    }
+    t.chunks += local.size();
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+}
+
+static void BM_MapHyperslab(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  std::vector<std::vector<std::shared_ptr<S3VLChunkObj>>> chunks;
+  for (auto &r : sels)
+    chunks.push_back(dset->generateChunks(r));
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (size_t s = 0; s < sels.size(); s++) {
+      auto mappings = mapSelection(*dset, chunks[s], sels[s]);
+      t.chunks += mappings.size();
+      benchmark::DoNotOptimize(mappings.data());
+    }
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+}
+
+static void BM_GenerateSegments(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  std::vector<std::list<std::vector<hsize_t>>> mappings;
+  std::vector<hsize_t> sizes;
+  for (auto &r : sels) {
+    auto chunk_objs = dset->generateChunks(r);
+    for (auto &m : mapSelection(*dset, chunk_objs, r))
+      mappings.push_back(std::move(m));
+    for (auto &c : chunk_objs)
+      sizes.push_back(c->size);
+  }
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < mappings.size(); i++) {
+      auto segments = generateSegments(mappings[i], sizes[i]);
+      for (auto &s : segments)
+        t.planned_bytes += s->end_offset - s->start_offset + 1;
+    }
+    t.chunks += mappings.size();
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+}
+
+static void BM_PlanChunk(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  std::vector<std::list<std::vector<hsize_t>>> mappings;
+  std::vector<hsize_t> sizes;
+  for (auto &r : sels) {
+    auto chunk_objs = dset->generateChunks(r);
+    for (auto &m : mapSelection(*dset, chunk_objs, r))
+      mappings.push_back(std::move(m));
+    for (auto &c : chunk_objs)
+      sizes.push_back(c->size);
+  }
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < mappings.size(); i++) {
+      std::vector<std::unique_ptr<Segment>> segments;
+      QPlan qp = planChunk(mappings[i], sizes[i], segments);
+      benchmark::DoNotOptimize(qp);
+      for (auto &s : segments)
+        t.planned_bytes += s->end_offset - s->start_offset + 1;
+    }
+    t.chunks += mappings.size();
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+}
+
+// the whole planning path a read takes before its first request goes out
+static void BM_Plan(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto &r : sels) {
+      auto chunk_objs = dset->generateChunks(r);
+      auto mappings = mapSelection(*dset, chunk_objs, r);
+      for (size_t i = 0; i < chunk_objs.size(); i++) {
+        std::vector<std::unique_ptr<Segment>> segments;
+        planChunk(mappings[i], chunk_objs[i]->size, segments);
+        for (auto &s : segments)
+          t.planned_bytes += s->end_offset - s->start_offset + 1;
+      }
+      t.chunks += chunk_objs.size();
+    }
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+}
+
+// BM_Plan as a read runs it: planned on the planner pool and consumed as it
+// is produced. "first_plan" is the time until the first chunk is handed out,
+// when a read issues its first request.
+static void BM_PlanStream(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  Tally t;
+  double first_plan = 0;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto &r : sels) {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<int> chunks = dset->accessedChunks(r);
+      std::vector<std::vector<std::unique_ptr<Segment>>> segments(
+          chunks.size());
+      PlanStream stream(chunks.size(), [&](size_t i) {
+        std::vector<std::shared_ptr<S3VLChunkObj>> chunk_objs = {
+            dset->generateChunk(chunks[i], r)};
+        auto mappings = mapSelection(*dset, chunk_objs, r);
+        planChunk(mappings[0], chunk_objs[0]->size, segments[i]);
+        return true;
+      });
+      size_t i;
+      bool first = true;
+      while (stream.next(i)) {
+        if (first) {
+          std::chrono::duration<double> elapsed =
+              std::chrono::steady_clock::now() - start;
+          first_plan += elapsed.count();
+          first = false;
+        }
+        for (auto &s : segments[i])
+          t.planned_bytes += s->end_offset - s->start_offset + 1;
+      }
+      t.chunks += chunks.size();
+    }
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  report(state, t, pattern);
+  state.counters["first_plan"] =
+      benchmark::Counter(first_plan / sels.size(),
+                         benchmark::Counter::kAvgIterations);
+}
+
+// copy every planned extent out of chunk-sized responses (processResponse)
+static void BM_Scatter(benchmark::State &state) {
+  auto dset = makeDataset(state.range(0), state.range(2));
+  Pattern pattern = (Pattern)state.range(1);
+  auto sels = selections(*dset, pattern);
+  hsize_t out_bytes = 0;
+  for (auto &r : sels)
+    out_bytes = std::max(out_bytes, selectionBytes(*dset, r));
+  std::vector<char> out(out_bytes);
+  std::vector<char> response(dset->element_per_chunk * dset->data_size, 1);
+  std::vector<std::unique_ptr<AsyncReadInput>> inputs;
+  for (auto &r : sels) {
+    auto chunk_objs = dset->generateChunks(r);
+    for (auto &m : mapSelection(*dset, chunk_objs, r)) {
+      std::vector<std::vector<hsize_t>> mapping(m.begin(), m.end());
+      inputs.push_back(std::make_unique<AsyncReadInput>(out.data(), mapping));
+    }
+  }
+  hsize_t bytes = 0;
+  for (auto &r : sels)
+    bytes += selectionBytes(*dset, r);
+  Tally t;
+  for (auto _ : state) {
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto &input : inputs)
+      processResponse(*input, response.data());
+    benchmark::ClobberMemory();
+    t.chunks += inputs.size();
+    t.allocations += allocations.load(std::memory_order_relaxed) - before;
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+  report(state, t, pattern);
+}
+
+static void Shapes(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"rank", "pattern", "div"});
+  for (int rank = 1; rank <= 5; rank++)
+    for (int pattern = ROW; pattern <= RANDOM; pattern++)
+      for (int divisor : {4, 16})
+        if (std::pow(divisor, rank) <= (1 << 16))
+          b->Args({rank, pattern, divisor});
+}
+
+BENCHMARK(BM_GenerateChunks)->Apply(Shapes);
+BENCHMARK(BM_CalSerialOffsets)->Apply(Shapes);
+BENCHMARK(BM_MapHyperslab)->Apply(Shapes);
+BENCHMARK(BM_GenerateSegments)->Apply(Shapes);
+BENCHMARK(BM_PlanChunk)->Apply(Shapes);
+BENCHMARK(BM_Plan)->Apply(Shapes);
+BENCHMARK(BM_PlanStream)->Apply(Shapes);
+BENCHMARK(BM_Scatter)->Apply(Shapes);
+
+int main(int argc, char **argv) {
+  // measure the planner, not the console
+  Logger::setLevel(LogLevel::OFF);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
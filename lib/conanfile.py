@@ -8,13 +8,19 @@ class ArrayMorphRecipe(ConanFile):
 
     settings = "os", "compiler", "build_type", "arch"
 
+    # pulls in Google Benchmark for the arraymorph_bench target
+    options = {"with_benchmarks": [True, False]}
+
     requires = (
         "aws-sdk-cpp/1.11.692",
         "azure-sdk-for-cpp/1.16.1",
+        "libcurl/[>=7.78.0 <9]",  # event-loop transport; same range as the AWS SDK
         "hdf5/1.14.6",  # headers only in practice; runtime comes from h5py
     )
 
     default_options = {
+        "with_benchmarks": False,
+
         # We do NOT want to ship Conan's HDF5 runtime in the wheel.
         # Keeping this static reduces accidental runtime coupling.
         "hdf5/*:shared": False,
@@ -40,11 +46,18 @@ class ArrayMorphRecipe(ConanFile):
         "azure-sdk-for-cpp/*:with_storage_datalake": False,
     }
 
+    def requirements(self):
+        if self.options.with_benchmarks:
+            self.requires("benchmark/1.9.1")
+
     def layout(self):
         cmake_layout(self)
 
     def generate(self):
         tc = CMakeToolchain(self, generator="Ninja")
+        tc.cache_variables["ARRAYMORPH_BUILD_BENCHMARKS"] = bool(
+            self.options.with_benchmarks
+        )
         tc.generate()
 
         deps = CMakeDeps(self)
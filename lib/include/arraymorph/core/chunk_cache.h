@@ -0,0 +1,61 @@
+#ifndef CHUNK_CACHE
+#define CHUNK_CACHE
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Whole chunk objects fetched ahead of demand reads (readahead, prefetch),
+// keyed by object key and bounded in bytes. A fetch first reserves its
+// entry, so concurrent readers of a chunk that is still in flight wait for
+// it instead of issuing a second GET. Completed entries are evicted least
+// recently used; in-flight ones never are.
+class ChunkCache {
+public:
+  using Data = std::shared_ptr<const std::vector<char>>;
+
+  explicit ChunkCache(size_t capacity) : capacity(capacity) {}
+
+  // claim `key` for a fetch of `bytes`. Returns a ticket for fill(), or 0
+  // when the chunk is already cached or in flight, or cannot be made to fit.
+  uint64_t reserve(const std::string &key, size_t bytes);
+  // complete the fetch behind `ticket`; null data (a failed fetch) drops it
+  void fill(const std::string &key, uint64_t ticket, Data data);
+  // the cached chunk, waiting if it is in flight; null when not cached.
+  // `waited` reports whether the caller had to wait for the fetch.
+  Data get(const std::string &key, bool *waited = nullptr);
+  // the cached chunk without waiting; null when it is in flight, for
+  // callers on the pool that runs the fetch
+  Data peek(const std::string &key);
+  bool contains(const std::string &key);
+  // forget a chunk, e.g. after it was overwritten
+  void erase(const std::string &key);
+
+  const size_t capacity;
+  size_t used();
+
+private:
+  struct Entry {
+    Data data;
+    size_t bytes;
+    uint64_t ticket;
+    std::list<std::string>::iterator lru;
+  };
+
+  void evict(size_t bytes);
+  void drop(std::unordered_map<std::string, Entry>::iterator it);
+
+  std::unordered_map<std::string, Entry> entries;
+  // completed entries, most recently used first
+  std::list<std::string> lru;
+  size_t used_bytes = 0;
+  uint64_t next_ticket = 1;
+  std::mutex mtx;
+  std::condition_variable filled;
+};
+
+#endif
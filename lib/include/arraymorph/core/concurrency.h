@@ -0,0 +1,105 @@
+#ifndef CONCURRENCY
+#define CONCURRENCY
+#include "arraymorph/core/constants.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+// Overrides of a window; 0 leaves a field as it is. `fixed` pins the window
+// and turns adaptation off.
+struct ConcurrencyLimits {
+  size_t initial = 0;
+  size_t min = 0;
+  size_t max = 0;
+  size_t fixed = 0;
+
+  bool empty() const { return !initial && !min && !max && !fixed; }
+};
+
+// AIMD control of the requests in flight to one storage endpoint. Time is
+// cut into rounds of about one window of completions. While at least half
+// the window is in use it grows by one request per round; it is halved,
+// once per round, when the endpoint throttles (503 SlowDown, 429), and
+// shrunk by a tenth when a round's mean latency climbed past
+// CONCURRENCY_LATENCY_FACTOR times the best round seen without goodput
+// improving, i.e. the extra requests only queued. The window starts at
+// CONCURRENCY_INITIAL within [CONCURRENCY_MIN, CONCURRENCY_MAX];
+// ARRAYMORPH_CONCURRENCY pins it and ARRAYMORPH_{INITIAL,MIN,MAX}_CONCURRENCY
+// move the bounds. The controller also keeps the endpoint's moving average
+// latency, by which reads choose among replicas.
+class ConcurrencyController {
+public:
+  // the controller of `endpoint`, created on first use
+  static ConcurrencyController &forEndpoint(const std::string &endpoint);
+  // {"<endpoint>":{"window":..,"in_flight":..,"throttles":..,
+  //   "latency":..},...}
+  static std::string toJson();
+  static bool isThrottle(int http_status) {
+    return http_status == 503 || http_status == 429;
+  }
+
+  // apply overrides, e.g. from a file access property list
+  void configure(const ConcurrencyLimits &limits);
+
+  // take a slot if fewer than window() requests are in flight
+  bool tryAcquire();
+  // tryAcquire, sleeping up to `timeout` for a request to release a slot
+  bool waitAcquire(std::chrono::microseconds timeout);
+  // take a slot regardless of the window (hedges, fallbacks, write batches)
+  void acquire();
+  // a request holding a slot finished: `bytes` received after `seconds`
+  void release(uint64_t bytes, double seconds);
+  // a request holding a slot failed
+  void release();
+  // the endpoint asked to slow down; the request may still be retried
+  void throttled();
+
+  size_t window() const { return limit.load(std::memory_order_relaxed); }
+  size_t inFlight() const { return in_flight.load(std::memory_order_relaxed); }
+  // moving average of the request latency in seconds, 0 before the first
+  double latency() const {
+    return latency_ewma.load(std::memory_order_relaxed);
+  }
+  size_t maxWindow();
+
+  const std::string endpoint;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  explicit ConcurrencyController(const std::string &endpoint);
+  void setWindow(double w);
+  void wake();
+  void endRound(Clock::time_point now);
+
+  std::atomic<size_t> in_flight{0};
+  // cwnd rounded down, read without the lock
+  std::atomic<size_t> limit;
+  std::atomic<uint64_t> throttles{0};
+  std::atomic<double> latency_ewma{0};
+  // wakes waitAcquire when a slot is released
+  std::mutex slot_mtx;
+  std::condition_variable slot_freed;
+
+  std::mutex mtx;
+  double cwnd;
+  size_t min_window;
+  size_t max_window;
+  bool adaptive = true;
+
+  Clock::time_point round_start;
+  size_t round_target;
+  size_t round_done = 0;
+  uint64_t round_bytes = 0;
+  double round_latency = 0;
+  bool round_throttled = false;
+  double best_latency;
+  double last_goodput = 0;
+
+  ConcurrencyController(const ConcurrencyController &) = delete;
+  ConcurrencyController &operator=(const ConcurrencyController &) = delete;
+};
+
+#endif
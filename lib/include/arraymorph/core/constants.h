@@ -4,7 +4,6 @@
 #include <string>
 #include <vector>
 
-#define LOG_ENABLE
 // #define PROFILE_ENABLE
 #define ARRAYMORPH_SUCCESS 1
 #define ARRAYMORPH_FAIL -1
@@ -12,23 +11,100 @@
 #define PROCESS
 #define POOLEXECUTOR
 
-const int s3Connections = 256;
 const int requestTimeoutMs = 30000;
 const int connectTimeoutMs = 30000;
-const int poolSize = 8192;
 const int retries = 3;
 
-const int THREAD_NUM = 256;
+// requests in flight per endpoint: initial AIMD window and its bounds
+// (ARRAYMORPH_CONCURRENCY, ARRAYMORPH_{INITIAL,MIN,MAX}_CONCURRENCY)
+const size_t CONCURRENCY_INITIAL = 32;
+const size_t CONCURRENCY_MIN = 4;
+const size_t CONCURRENCY_MAX = 512;
+// a round whose mean latency exceeds this multiple of the best one, with no
+// more goodput, counts as queueing
+const double CONCURRENCY_LATENCY_FACTOR = 2;
+// weight of the newest request in an endpoint's moving average latency
+const double LATENCY_EWMA_WEIGHT = 0.1;
+// replicated files: every how many reads one goes to an endpoint other than
+// the fastest, and how long an endpoint is skipped after failing (doubled
+// per failure in a row, up to the maximum)
+const int ENDPOINT_PROBE_INTERVAL = 20;
+const int ENDPOINT_RETRY_MS = 1000;
+const int ENDPOINT_RETRY_MAX_MS = 60000;
+// workers for the blocking transports (Azure, local files)
+const int IO_THREAD_NUM = 64;
+// workers planning large selections, and how many chunks each job plans
+const int PLAN_THREAD_NUM = 4;
+const int PLAN_BATCH = 64;
+// batches a loader (arraymorph.Loader) reads at the same time
+const int LOADER_THREAD_NUM = 2;
+// event-loop transport (ARRAYMORPH_TRANSPORT=curl): loop threads, workers
+// scattering the responses, and the first retry backoff (doubled after)
+const int EVENT_LOOP_NUM = 2;
+const int COMPLETION_THREAD_NUM = 8;
+const int EVENT_LOOP_RETRY_BASE_MS = 25;
+// lifetime of the presigned URLs the event loop sends
+const int PRESIGN_EXPIRY_S = 900;
+// pending log messages; a power of two
+const int LOG_RING_SIZE = 1 << 14;
+// hashed key prefixes the chunks of a new dataset are spread over
+// (ARRAYMORPH_KEY_STRIPES); 0 keeps them under the dataset's own prefix
+const int KEY_STRIPES = 0;
+const int KEY_STRIPES_MAX = 1 << 16;
+// attribute values up to this size are kept in the dataset's metadata
+// object; larger ones are stored as objects of their own
+const size_t ATTR_INLINE_MAX = 64 << 10;
+// per-dataset readahead/prefetch buffer (ARRAYMORPH_READAHEAD_MB)
+const size_t READAHEAD_MB = 256;
+// node-wide chunk cache in POSIX shared memory (ARRAYMORPH_SHM_CACHE_MB,
+// 0 disables it), the largest chunk a slot holds
+// (ARRAYMORPH_SHM_CACHE_SLOT_KB), the slots a chunk key may map to, the
+// longest key kept, and after how long a slot that is still claimed is
+// taken to belong to a process that died holding it
+const size_t SHM_CACHE_MB = 0;
+const size_t SHM_CACHE_SLOT_KB = 4096;
+const int SHM_CACHE_WAYS = 8;
+const size_t SHM_CACHE_KEY_MAX = 256;
+const int SHM_CACHE_STALE_S = 30;
+// equal consecutive steps before a dataset counts as streaming
+const int READAHEAD_TRIGGER = 2;
+// selections fetched ahead, initially and at most
+const int READAHEAD_MIN_DEPTH = 2;
+const int READAHEAD_MAX_DEPTH = 64;
+// hedged GETs: percentile of recent latencies after which a duplicate is
+// sent, extra requests allowed (percent of primaries), latencies kept,
+// samples needed before hedging starts, lowest hedge delay and most
+// duplicates that may be sent back to back
+const double HEDGE_PERCENTILE = 95;
+const double HEDGE_BUDGET_PERCENT = 5;
+const size_t HEDGE_WINDOW = 1024;
+const size_t HEDGE_MIN_SAMPLES = 64;
+const double HEDGE_MIN_DELAY_MS = 1;
+const double HEDGE_MAX_BURST = 16;
+// how often a read waiting for its requests wakes to look for ones to
+// hedge, and how long it sleeps between checks when there are none
+const int HEDGE_SCAN_US = 1000;
+const int WAIT_SLICE_US = 100000;
+// trace events kept in memory before new ones are dropped
+const size_t TRACE_MAX_EVENTS = 1 << 20;
 
 extern std::string BUCKET_NAME;
 
 typedef struct Result {
   std::vector<char> data;
+  // ARRAYMORPH_FAIL when the object could not be read; `missing` tells a
+  // missing object apart from a failed request
+  int status = ARRAYMORPH_SUCCESS;
+  bool missing = false;
 } Result;
 
-enum QPlan { NONE = -1, GET = 0 };
+enum QPlan { NONE = -1, GET = 0, RANGE, MULTI_RANGE, PUSHDOWN };
 
-enum SPlan { S3 = 0, GOOGLE, AZURE_BLOB };
+// plan forced for every chunk (ARRAYMORPH_QUERY_PLAN), NONE lets the planner
+// decide
+extern QPlan SINGLE_PLAN;
+
+enum SPlan { S3 = 0, GOOGLE, AZURE_BLOB, LOCAL_FILE };
 
 extern SPlan SP;
 
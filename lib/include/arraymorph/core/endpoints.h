@@ -0,0 +1,68 @@
+#ifndef ENDPOINTS
+#define ENDPOINTS
+#include "arraymorph/core/concurrency.h"
+#include "arraymorph/core/operators.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One store holding a copy of a file's objects: its client, the bucket the
+// objects live in, and the request window of its endpoint
+struct StorageEndpoint {
+  // as in the "endpoints" section of the stats
+  std::string name;
+  std::string bucket;
+  CloudClient client;
+  ConcurrencyController *concurrency = nullptr;
+
+  // failed reads in a row, and when the endpoint may be tried again
+  int failures = 0;
+  std::chrono::steady_clock::time_point retry_at;
+};
+
+// The replicas of a file, in the order they were configured. Writes go to
+// the first (the primary); mirroring to the others is left to the stores.
+// Reads go to the endpoint whose requests currently answer fastest, by the
+// latency its ConcurrencyController measures; every
+// ENDPOINT_PROBE_INTERVAL-th pick goes to another one so its latency stays
+// current. An endpoint whose requests fail is skipped for
+// ENDPOINT_RETRY_MS, doubling with every failure in a row.
+class EndpointPool {
+public:
+  explicit EndpointPool(
+      std::vector<std::unique_ptr<StorageEndpoint>> endpoints);
+
+  StorageEndpoint &primary() { return *endpoints.front(); }
+  StorageEndpoint &at(size_t i) { return *endpoints[i]; }
+  // the endpoint to read from, not one of `tried`; null once all were tried
+  StorageEndpoint *
+  pick(const std::vector<const StorageEndpoint *> &tried = {});
+  void succeeded(StorageEndpoint &endpoint);
+  void failed(StorageEndpoint &endpoint);
+  size_t size() const { return endpoints.size(); }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  std::vector<std::unique_ptr<StorageEndpoint>> endpoints;
+  std::mutex mtx;
+  uint64_t picks = 0;
+  uint64_t probes = 0;
+
+  EndpointPool(const EndpointPool &) = delete;
+  EndpointPool &operator=(const EndpointPool &) = delete;
+};
+
+// Whole objects: metadata, indexes, spilled attribute values, or a chunk to
+// merge a write into. Result::status fails when the object could not be
+// read, and Result::missing is set when it does not exist.
+Result getObject(const StorageEndpoint &endpoint, const std::string &uri);
+// from the first replica that has it
+Result fetchObject(EndpointPool &endpoints, const std::string &key);
+herr_t putObject(const StorageEndpoint &endpoint, const std::string &key,
+                 const std::vector<char> &data);
+herr_t deleteObject(const StorageEndpoint &endpoint, const std::string &key);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef EVENT_LOOP
+#define EVENT_LOOP
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct EventLoopResponse {
+  // HTTP status, 0 when the transfer itself failed
+  long status = 0;
+  // curl's message when status is 0
+  std::string error;
+  std::vector<char> body;
+
+  bool ok() const { return status >= 200 && status < 300; }
+};
+
+// One GET or PUT of a presigned URL
+struct EventLoopRequest {
+  std::string url;
+  // "beg-end" for a range GET, empty for the whole object
+  std::string range;
+  // PUT payload; null for a GET
+  std::shared_ptr<char> body;
+  size_t body_size = 0;
+  // expected response size, reserved up front
+  size_t size_hint = 0;
+  // called on the loop thread before a retryable response is retried
+  std::function<void(const EventLoopResponse &, int attempt)> retrying;
+  // called with the final response on a completion worker
+  std::function<void(EventLoopResponse &&)> done;
+};
+
+// HTTP transport that drives every request from a few event-loop threads
+// (ARRAYMORPH_EVENT_LOOPS) with libcurl's multi interface, instead of one
+// SDK executor thread per request in flight. Finished transfers are handed
+// to a small pool of completion workers (ARRAYMORPH_COMPLETION_THREADS) for
+// the scatter. Throttling (503, 429), server errors and failed transfers
+// are retried up to `retries` times with exponential backoff. Selected with
+// ARRAYMORPH_TRANSPORT=curl; the SDK transport is used otherwise.
+class HttpEventLoop {
+public:
+  // null unless the event-loop transport is selected
+  static HttpEventLoop *getInstance();
+
+  void submit(EventLoopRequest &&request);
+
+  ~HttpEventLoop();
+
+private:
+  struct Loop;
+  struct Transfer;
+
+  HttpEventLoop(size_t loops, size_t workers);
+  void run(Loop &loop);
+  void start(Loop &loop, std::unique_ptr<Transfer> transfer);
+  void finish(Loop &loop, Transfer *transfer, int code);
+  // CURLOPT_READFUNCTION feeding a PUT body
+  static size_t onUpload(char *buf, size_t size, size_t n, void *transfer);
+
+  std::vector<std::unique_ptr<Loop>> loops;
+  std::atomic<size_t> next{0};
+  std::atomic<bool> stopping{false};
+  ThreadPool completions;
+
+  HttpEventLoop(const HttpEventLoop &) = delete;
+  HttpEventLoop &operator=(const HttpEventLoop &) = delete;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef HEDGING
+#define HEDGING
+#include "arraymorph/core/constants.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// One logical read that may be answered by several attempts (a hedge, the
+// pushdown fallback). The first successful response wins and is the only
+// one scattered; the batch counts the read as finished exactly once, when
+// it wins or when its last attempt fails.
+struct RequestState {
+  std::atomic<bool> done{false};
+  std::atomic<int> outstanding{1};
+  std::atomic<bool> hedged{false};
+};
+
+// When to send a duplicate of a slow GET. Latencies are taken relative to
+// what the cost model expects for the request's size, so whole-chunk GETs
+// are not hedged against the latency of small ranges; the threshold is a
+// percentile (ARRAYMORPH_HEDGE_PERCENTILE, 0 disables) of the latest
+// HEDGE_WINDOW such ratios, times the expected time of the request at
+// hand. Duplicates are paid from a budget that grows by
+// ARRAYMORPH_HEDGE_BUDGET percent of every primary request, so hedging
+// never adds more than that share of extra requests.
+class HedgePolicy {
+public:
+  static HedgePolicy &getInstance();
+
+  bool enabled() const { return percentile > 0; }
+  // a response after `seconds`, where `expected` was predicted
+  void observe(double seconds, double expected);
+  // age after which an outstanding request expected to take `expected`
+  // seconds is hedged; infinity until HEDGE_MIN_SAMPLES latencies have
+  // been seen
+  double threshold(double expected) const {
+    double ratio = threshold_ratio.load(std::memory_order_relaxed);
+    return std::max(ratio * expected, HEDGE_MIN_DELAY_MS / 1000.0);
+  }
+  // a primary request was issued
+  void issued();
+  // take one duplicate from the budget
+  bool tryHedge();
+
+private:
+  double percentile;
+  double budget;
+  std::atomic<double> threshold_ratio;
+
+  std::mutex mtx;
+  std::vector<double> window;
+  size_t next = 0;
+  size_t observed = 0;
+  double tokens = 0;
+
+  HedgePolicy();
+  HedgePolicy(const HedgePolicy &) = delete;
+  HedgePolicy &operator=(const HedgePolicy &) = delete;
+};
+
+#endif
@@ -1,16 +1,71 @@
 #include "arraymorph/core/constants.h"
-#include <iostream>
+#include <atomic>
 #include <sstream>
+#include <string>
 #ifndef __LOGGER__
 #define __LOGGER__
+
+enum class LogLevel : int { TRACE = 0, DEBUG, INFO, WARN, ERROR, OFF };
+
+// Messages below this level are compiled out entirely, arguments included
+// (e.g. -DARRAYMORPH_LOG_MIN_LEVEL=2 keeps INFO and above).
+#ifndef ARRAYMORPH_LOG_MIN_LEVEL
+#define ARRAYMORPH_LOG_MIN_LEVEL 0
+#endif
+
+// Leveled logger. The runtime threshold comes from ARRAYMORPH_LOG_LEVEL
+// (trace, debug, info, warn, error, off; warn by default) and is checked
+// before any formatting happens. Enabled messages are pushed onto a
+// lock-free ring buffer and written to stderr by a background thread, so
+// SDK callback threads never block on console I/O. When the ring is full
+// messages are dropped and counted instead of stalling the caller.
 class Logger {
 public:
+  static bool enabled(LogLevel level) {
+    int t = threshold.load(std::memory_order_relaxed);
+    if (t < 0)
+      t = initThreshold();
+    return static_cast<int>(level) >= t;
+  }
+
+  template <LogLevel L, typename... Args> static void write(Args &&...args) {
+    if constexpr (static_cast<int>(L) >= ARRAYMORPH_LOG_MIN_LEVEL) {
+      if (!enabled(L))
+        return;
+      std::ostringstream oss;
+      ((oss << std::forward<Args>(args) << ' '), ...);
+      enqueue(L, oss.str());
+    }
+  }
+
+  // per-request tracing on the I/O paths
+  template <typename... Args> static void trace(Args &&...args) {
+    write<LogLevel::TRACE>(std::forward<Args>(args)...);
+  }
+  // connector callbacks and metadata
   template <typename... Args> static void log(Args &&...args) {
-#ifdef LOG_ENABLE
-    std::ostringstream oss;
-    ((oss << std::forward<Args>(args) << ' '), ...);
-    std::cout << oss.str() << std::endl;
-#endif
+    write<LogLevel::DEBUG>(std::forward<Args>(args)...);
+  }
+  // one-off configuration
+  template <typename... Args> static void info(Args &&...args) {
+    write<LogLevel::INFO>(std::forward<Args>(args)...);
+  }
+  template <typename... Args> static void warn(Args &&...args) {
+    write<LogLevel::WARN>(std::forward<Args>(args)...);
+  }
+  template <typename... Args> static void error(Args &&...args) {
+    write<LogLevel::ERROR>(std::forward<Args>(args)...);
   }
+
+  static void setLevel(LogLevel level);
+  // write out everything queued so far
+  static void flush();
+
+private:
+  static int initThreshold();
+  static void enqueue(LogLevel level, std::string &&msg);
+
+  // -1 until ARRAYMORPH_LOG_LEVEL has been read
+  static inline std::atomic<int> threshold{-1};
 };
 #endif
@@ -1,10 +1,17 @@
 #ifndef OPERATORS
 #define OPERATORS
+#include "arraymorph/core/concurrency.h"
 #include "arraymorph/core/constants.h"
+#include "arraymorph/core/event_loop.h"
+#include "arraymorph/core/hedging.h"
 #include "arraymorph/core/logger.h"
+#include "arraymorph/core/reducer.h"
+#include "arraymorph/core/stats.h"
+#include "arraymorph/core/tracer.h"
 #include <aws/core/Aws.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>
 #include <aws/core/client/ClientConfiguration.h>
+#include <aws/core/client/RetryStrategy.h>
 #include <aws/core/http/Scheme.h> // for Scheme
 #include <aws/core/utils/logging/LogLevel.h>
 #include <aws/s3/S3Client.h>
@@ -26,8 +33,11 @@
 #include <azure/core/http/policies/policy.hpp>
 #include <azure/storage/blobs.hpp> // for Azure blob
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
 #include <hdf5.h>
+#include <list>
 #include <iostream>
 #include <mutex>
 #include <stdlib.h>
@@ -44,26 +54,90 @@ using namespace Aws::S3;
 using namespace Aws::S3::Model;
 using namespace Azure::Storage::Blobs;
 
+// Buckets and keys mapped onto a directory tree under `root`
+// (ARRAYMORPH_FILE_ROOT), e.g. a Lustre/GPFS scratch directory.
+class FileClient {
+public:
+  explicit FileClient(const std::string &root) : root(root) {}
+  std::string path(const std::string &bucket_name,
+                   const std::string &key) const {
+    return root + "/" + bucket_name + "/" + key;
+  }
+  const std::string root;
+};
+
 using CloudClient =
     std::variant<std::monostate, std::unique_ptr<Aws::S3::S3Client>,
-                 std::unique_ptr<BlobContainerClient>>;
+                 std::unique_ptr<BlobContainerClient>,
+                 std::unique_ptr<FileClient>>;
 
-extern CloudClient global_cloud_client;
+// S3 client pointed at the subsetting executor (ARRAYMORPH_PUSHDOWN_ENDPOINT),
+// null when pushdown is disabled
+extern std::unique_ptr<Aws::S3::S3Client> pushdown_client;
 
-class OperationTracker {
-public:
-  static OperationTracker &getInstance();
+// request window of the pushdown executor, null when pushdown is disabled;
+// every store has its own in its StorageEndpoint
+extern ConcurrencyController *pushdown_concurrency;
 
-  void add();
-  int get() const;
-  void reset();
+// StandardRetryStrategy that counts the retries it grants in the stats and
+// reports throttling responses to the window of its client's endpoint
+class CountingRetryStrategy : public Aws::Client::StandardRetryStrategy {
+public:
+  CountingRetryStrategy(ConcurrencyController *controller, long maxRetries)
+      : StandardRetryStrategy(maxRetries), controller(controller) {}
+  bool ShouldRetry(const Aws::Client::AWSError<Aws::Client::CoreErrors> &error,
+                   long attemptedRetries) const override {
+    if (controller && ConcurrencyController::isThrottle(
+                          static_cast<int>(error.GetResponseCode())))
+      controller->throttled();
+    bool retry = StandardRetryStrategy::ShouldRetry(error, attemptedRetries);
+    if (retry) {
+      StatsRegistry::getInstance().process().retry();
+      if (Tracer::enabled())
+        Tracer::getInstance().instant(
+            "retry", "request",
+            TraceArgs()
+                .add("error", std::string(error.GetExceptionName()))
+                .add("attempt", static_cast<uint64_t>(attemptedRetries + 1)));
+    }
+    return retry;
+  }
 
 private:
-  std::atomic<int> finish{0};
+  ConcurrencyController *const controller;
+};
 
-  OperationTracker() = default;
-  OperationTracker(const OperationTracker &) = delete;
-  OperationTracker &operator=(const OperationTracker &) = delete;
+// Completion of the requests one read or reduction issued; each finishes
+// it exactly once. Reads running concurrently, e.g. on the loader's
+// threads, count separately.
+struct ReadBatch {
+  std::atomic<size_t> finished{0};
+  std::atomic<size_t> failed{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  // `ok` is false when the request ended without data for another reason
+  // than a missing object
+  void finish(bool ok) {
+    if (!ok)
+      failed.fetch_add(1, std::memory_order_relaxed);
+    {
+      // taken so the wakeup cannot fall between a waiter's check and its
+      // sleep; the increment publishes what the response wrote to the
+      // buffer
+      std::lock_guard<std::mutex> lock(mtx);
+      finished.fetch_add(1, std::memory_order_release);
+    }
+    cv.notify_all();
+  }
+  bool over(size_t issued) const {
+    return finished.load(std::memory_order_acquire) >= issued;
+  }
+  // sleep until `issued` requests finished or `timeout` passed
+  bool wait(size_t issued, std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> lock(mtx);
+    return cv.wait_for(lock, timeout, [&] { return over(issued); });
+  }
 };
 
 class AsyncWriteInput : public AsyncCallerContext {
@@ -77,17 +151,47 @@ public:
   AsyncReadInput(const void *buf,
                  const std::vector<std::vector<hsize_t>> &mapping,
                  const int lambda = 0, const std::string bucket_name = "",
-                 const std::string uri = "")
+                 const std::string uri = "",
+                 const std::vector<std::vector<hsize_t>> &fallback_mapping = {})
       : buf(buf), mapping(mapping), lambda(lambda), bucket_name(bucket_name),
-        uri(uri) {}
+        uri(uri), fallback_mapping(fallback_mapping),
+        issued(std::chrono::steady_clock::now()) {}
   const void *buf;
   const std::vector<std::vector<hsize_t>> mapping;
   const int lambda;
   // for re-issuing GET if lambda fails
   const std::string bucket_name;
   const std::string uri;
+  // mapping against the whole object, used by the re-issued GET
+  const std::vector<std::vector<hsize_t>> fallback_mapping;
+  // store the re-issued GET goes to, and its window
+  const S3Client *fallback_client = nullptr;
+  ConcurrencyController *fallback_limiter = nullptr;
+  // when set, responses are folded into the reduction instead of being
+  // copied to buf
+  std::shared_ptr<Reducer> reducer;
+  // dataset counters the request is charged to; process totals when null
+  IOStats *stats = nullptr;
+  // shared by every attempt at the same read; null for one-shot requests
+  std::shared_ptr<RequestState> state;
+  // the read waiting for the request; null when the caller waits on a
+  // future instead
+  std::shared_ptr<ReadBatch> batch;
+  // this attempt is a duplicate sent for a slow request
+  bool hedge = false;
+  // window the attempt holds a slot of, released when it completes
+  ConcurrencyController *limiter = nullptr;
+  // feeds the planner's cost model once the response arrives
+  const std::chrono::steady_clock::time_point issued;
+
+  IOStats &statsOrProcess() const {
+    return stats ? *stats : StatsRegistry::getInstance().process();
+  }
 };
 
+// copy or reduce the mapped extents of a response
+void processResponse(const AsyncReadInput &input, const char *data);
+
 class Operators {
 public:
   // S3
@@ -104,9 +208,27 @@ public:
                       const std::shared_ptr<const AsyncCallerContext> input);
   static herr_t S3Put(const S3Client *client, const std::string &bucket_name,
                       const std::string &object_name, Result &re);
+  static herr_t
+  S3PushdownAsync(const S3Client *client, const std::string &bucket_name,
+                  const std::string &object_name, const std::string &query,
+                  const std::shared_ptr<const AsyncCallerContext> input);
   static herr_t S3PutBuf(const S3Client *client, const std::string &bucket_name,
                          const std::string &object_name,
                          std::shared_ptr<char> buf, hsize_t length);
+  // PUT without holding a thread while it is in flight; `done` gets the
+  // status on a transport thread. Throttling is reported to `limiter`.
+  static void S3PutBufAsync(const S3Client *client,
+                            const std::string &bucket_name,
+                            const std::string &object_name,
+                            std::shared_ptr<char> buf, hsize_t length,
+                            ConcurrencyController *limiter,
+                            std::function<void(herr_t)> done);
+  // GET through the HttpEventLoop; `range` is "beg-end" or empty
+  static herr_t
+  S3GetEventLoop(const S3Client *client, const std::string &bucket_name,
+                 const std::string &object_name, const std::string &range,
+                 size_t size_hint,
+                 const std::shared_ptr<const AsyncCallerContext> context);
   static herr_t S3PutAsync(const S3Client *client,
                            const std::string &bucket_name,
                            const Aws::String &object_name, Result &re);
@@ -124,6 +246,9 @@ public:
   static herr_t AzurePut(const BlobContainerClient *client,
                          const std::string &blob_name,
                          std::shared_ptr<char> buf, size_t length);
+  // a blob that does not exist counts as deleted
+  static herr_t AzureDelete(const BlobContainerClient *client,
+                            const std::string &blob_name);
   static herr_t
   AzureGetAndProcess(const BlobContainerClient *client,
                      const std::string &blob_name,
@@ -132,13 +257,41 @@ public:
   AzureGetRange(const BlobContainerClient *client, const std::string &blob_name,
                 uint64_t beg, uint64_t end,
                 const std::shared_ptr<const AsyncCallerContext> context);
+
+  // Local file system
+  static Result FileGet(const FileClient *client,
+                        const std::string &bucket_name,
+                        const std::string &object_name);
+  static herr_t FilePut(const FileClient *client,
+                        const std::string &bucket_name,
+                        const std::string &object_name,
+                        std::shared_ptr<char> buf, size_t length);
+  // a file that does not exist counts as deleted
+  static herr_t FileDelete(const FileClient *client,
+                           const std::string &bucket_name,
+                           const std::string &object_name);
+  // pwrite the mapped extents of buf straight into a chunk file of
+  // object_size bytes, creating it zero-filled if needed
+  static herr_t
+  FileWriteExtents(const FileClient *client, const std::string &bucket_name,
+                   const std::string &object_name, size_t object_size,
+                   const void *buf,
+                   const std::list<std::vector<hsize_t>> &mapping);
+  static herr_t
+  FileGetRange(const FileClient *client, const std::string &bucket_name,
+               const std::string &object_name, uint64_t beg, uint64_t end,
+               const std::shared_ptr<const AsyncCallerContext> context);
 };
 
 inline herr_t Operators::S3GetByteRangeAsync(
     const S3Client *client, const std::string &bucket_name,
     const Aws::String &object_name, uint64_t beg, uint64_t end,
     const std::shared_ptr<const AsyncCallerContext> input) {
-  Logger::log("------ S3getRangeAsync ", object_name);
+  Logger::trace("------ S3getRangeAsync ", object_name);
+  if (HttpEventLoop::getInstance())
+    return S3GetEventLoop(client, bucket_name, object_name,
+                          std::to_string(beg) + '-' + std::to_string(end),
+                          end - beg + 1, input);
   GetObjectRequest request;
   request.SetBucket(bucket_name);
   request.SetKey(object_name);
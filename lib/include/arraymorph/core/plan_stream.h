@@ -0,0 +1,55 @@
+#ifndef PLAN_STREAM
+#define PLAN_STREAM
+#include "arraymorph/core/thread_pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// The chunks of one read or write, planned in batches of PLAN_BATCH on the
+// planner pool and handed to the request loop as each batch is done, so
+// the first request goes out after one batch is planned instead of all of
+// them. `job(i)` plans chunk i, from any planner thread, and returns
+// whether it has requests to issue. Selections of up to PLAN_BATCH chunks
+// are planned on the calling thread.
+class PlanStream {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  PlanStream(size_t count, std::function<bool(size_t)> job);
+  // waits for the planner jobs, which reference the caller's state
+  ~PlanStream();
+
+  // the next planned chunk with requests, in the order they were planned;
+  // false once every one was handed out
+  bool next(size_t &i);
+  // hand every chunk out again, e.g. to retry them on another replica
+  void rewind();
+  // block until every chunk is planned
+  void wait();
+
+  const size_t count;
+  // when the last chunk was planned
+  Clock::time_point finished;
+
+  // the workers every stream plans on, sized by ARRAYMORPH_PLAN_THREADS,
+  // PLAN_THREAD_NUM by default
+  static ThreadPool &pool();
+
+private:
+  std::function<bool(size_t)> job;
+  std::mutex mtx;
+  std::condition_variable cv;
+  // chunks with requests, in planning order; only ever appended to
+  std::vector<size_t> ready;
+  size_t handed = 0;
+  size_t planned = 0;
+
+  void plan(size_t beg, size_t end);
+
+  PlanStream(const PlanStream &) = delete;
+  PlanStream &operator=(const PlanStream &) = delete;
+};
+
+#endif
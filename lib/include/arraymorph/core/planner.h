@@ -0,0 +1,80 @@
+#ifndef PLANNER
+#define PLANNER
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/utils.h"
+#include <atomic>
+#include <hdf5.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Per-request latency and bandwidth of the storage backend. Seeded from
+// ARRAYMORPH_LATENCY_MS / ARRAYMORPH_BANDWIDTH_MBPS (or per-platform
+// defaults) and refined with an EWMA over completed requests.
+class CostModel {
+public:
+  static CostModel &getInstance();
+
+  void observe(hsize_t bytes, double seconds);
+  double latency() const;   // seconds per request
+  double bandwidth() const; // bytes per second for a single request
+  // estimated time to serve `requests` requests moving `bytes` in total
+  double cost(size_t requests, hsize_t bytes) const;
+  // gap size below which fetching the gap is cheaper than another request
+  hsize_t mergeGap() const;
+
+  // subsetting pushdown is only considered once an executor is configured
+  void enablePushdown();
+  bool pushdownEnabled() const;
+  double pushdownCost(hsize_t bytes) const;
+
+private:
+  mutable std::mutex mtx;
+  double latency_s;
+  double bandwidth_bps;
+  // extra server-side time of a pushdown request (fetch + subset)
+  double pushdown_overhead_s;
+  bool pushdown_enabled{false};
+
+  CostModel();
+  CostModel(const CostModel &) = delete;
+  CostModel &operator=(const CostModel &) = delete;
+};
+
+// Process-wide counters of the planner's decisions.
+class PlannerStats {
+public:
+  static PlannerStats &getInstance();
+
+  void add(QPlan qp, size_t requests, hsize_t planned_bytes,
+           hsize_t required_bytes);
+  void reset();
+  std::string to_string() const;
+
+  std::atomic<uint64_t> get_plans{0};
+  std::atomic<uint64_t> range_plans{0};
+  std::atomic<uint64_t> multi_range_plans{0};
+  std::atomic<uint64_t> pushdown_plans{0};
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> planned_bytes{0};
+  std::atomic<uint64_t> required_bytes{0};
+
+private:
+  PlannerStats() = default;
+  PlannerStats(const PlannerStats &) = delete;
+  PlannerStats &operator=(const PlannerStats &) = delete;
+};
+
+QPlan parseQueryPlan(const std::string &name);
+const char *queryPlanName(QPlan qp);
+
+// choose between a whole-object GET, one covering range, several ranges and
+// a subsetting pushdown for a chunk; `mapping` must be sorted by chunk offset
+// (mapHyperslab order). A PUSHDOWN plan keeps one covering segment so the
+// request can fall back to a plain GET.
+QPlan planChunk(std::list<std::vector<hsize_t>> &mapping, hsize_t chunk_size,
+                std::vector<std::unique_ptr<Segment>> &segments);
+
+#endif
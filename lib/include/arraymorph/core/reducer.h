@@ -0,0 +1,44 @@
+#ifndef REDUCER
+#define REDUCER
+#include "arraymorph/core/constants.h"
+#include <cstdint>
+#include <hdf5.h>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+typedef struct ReduceResult {
+  double sum = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  uint64_t count = 0;
+
+  void combine(const ReduceResult &other);
+  double mean() const { return count ? sum / count : 0; }
+} ReduceResult;
+
+// Folds selected elements of chunk responses into a running sum/min/max/count
+// as they arrive, so a reduction never materializes the selection.
+class Reducer {
+public:
+  explicit Reducer(hid_t dtype);
+  // false for element types it cannot fold (long double, bitfields, ...),
+  // whose data consume() ignores
+  bool supported() const { return type != UNSUPPORTED; }
+
+  // reduce every {offset, -, length} extent of `mapping` (bytes) in `data`
+  void consume(const char *data,
+               const std::vector<std::vector<hsize_t>> &mapping);
+  ReduceResult result() const;
+
+private:
+  enum ElementType { INT8, INT16, INT32, INT64, UINT8, UINT16, UINT32,
+                     UINT64, FLOAT, DOUBLE, UNSUPPORTED };
+
+  ElementType type;
+  size_t data_size;
+  mutable std::mutex mtx;
+  ReduceResult total;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SHM_CACHE
+#define SHM_CACHE
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Whole chunks shared by every process on a node that maps the same POSIX
+// shared memory segment (ARRAYMORPH_SHM_CACHE_NAME under /dev/shm), e.g.
+// the DataLoader or Dask workers of one job. A chunk fetched by any of them
+// is read by the others without a request.
+//
+// The segment is an array of fixed-size slots, each a chunk of up to
+// ARRAYMORPH_SHM_CACHE_SLOT_KB. A key may live in SHM_CACHE_WAYS slots
+// picked by its hash, so the index is the slot headers themselves and
+// lookups, inserts and evictions only compare-and-swap a slot's state word:
+// no lock is shared between processes. Readers hold a reference on the slot
+// while they copy out of it, and a slot with references is never reused.
+// The least recently used free slot of the key's set is evicted. A process
+// that dies while holding a slot leaves it claimed; such slots are
+// reclaimed once nobody has taken them for SHM_CACHE_STALE_S.
+class SharedChunkCache {
+public:
+  // null when ARRAYMORPH_SHM_CACHE_MB is 0 or the segment cannot be mapped.
+  // Mappings survive fork(), so forked workers share the parent's.
+  static SharedChunkCache *getInstance();
+
+  // call `use` on the cached bytes of `key` while a reference keeps them
+  // in place; false, without calling it, unless `key` holds exactly
+  // `bytes` bytes
+  bool read(const std::string &key, size_t bytes,
+            const std::function<void(const char *)> &use);
+  bool contains(const std::string &key);
+  // publish a fetched chunk; false when it does not fit a slot or every
+  // slot it may use is in use
+  bool put(const std::string &key, const char *data, size_t bytes);
+  // forget a chunk, e.g. after it was overwritten. Readers already copying
+  // it finish; the slot is reused after them.
+  void erase(const std::string &key);
+  // the largest chunk a slot holds
+  size_t slotBytes() const;
+
+  ~SharedChunkCache();
+
+private:
+  struct Header;
+  struct Slot;
+
+  SharedChunkCache(void *base, size_t size);
+  static SharedChunkCache *map(const std::string &name, size_t size,
+                               size_t slot_bytes);
+  Slot &slot(uint64_t tag, int way);
+  char *slotData(const Slot &s);
+  // take a reference on a published slot, refreshing its last use
+  static bool acquire(Slot &s);
+  static void release(Slot &s);
+
+  void *base;
+  size_t size;
+  Header *header;
+  Slot *slots;
+  char *data;
+};
+
+#endif
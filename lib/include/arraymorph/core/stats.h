@@ -0,0 +1,102 @@
+#ifndef STATS
+#define STATS
+#include "arraymorph/core/constants.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Lock-free latency histogram with power-of-two microsecond buckets:
+// bucket i counts samples in [2^(i-1), 2^i) us, bucket 0 everything < 1 us.
+class LatencyHistogram {
+public:
+  static const int BUCKETS = 40;
+
+  void record(double seconds);
+  void reset();
+  uint64_t count() const;
+  double mean() const;                // seconds
+  double percentile(double p) const;  // seconds, upper bound of the bucket
+  std::string toJson() const;
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+  std::atomic<uint64_t> total_ns{0};
+};
+
+// Counters of one dataset or of the whole process. Every update on a dataset
+// is also applied to its parent (the process totals), so the two never drift.
+class IOStats {
+public:
+  explicit IOStats(IOStats *parent = nullptr) : parent(parent) {}
+
+  void read(uint64_t required_bytes, double seconds);
+  void write(uint64_t bytes, double seconds);
+  void request(uint64_t bytes, double seconds);
+  void retry();
+  void failure();
+  // a duplicate request was sent for a slow one, and it answered first
+  void hedge();
+  void hedgeWin();
+  void cacheHit(uint64_t bytes);
+  void cacheMiss();
+  void queueWait(double seconds);
+  void scatter(double seconds);
+  void plan(double seconds);
+
+  void reset();
+  std::string toJson() const;
+
+  std::atomic<uint64_t> reads{0};
+  std::atomic<uint64_t> writes{0};
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> bytes_transferred{0};
+  std::atomic<uint64_t> bytes_required{0};
+  std::atomic<uint64_t> bytes_written{0};
+  std::atomic<uint64_t> retries{0};
+  std::atomic<uint64_t> failures{0};
+  std::atomic<uint64_t> hedges{0};
+  std::atomic<uint64_t> hedge_wins{0};
+  std::atomic<uint64_t> cache_hits{0};
+  std::atomic<uint64_t> cache_misses{0};
+  std::atomic<uint64_t> cache_hit_bytes{0};
+
+  LatencyHistogram read_latency;
+  LatencyHistogram write_latency;
+  LatencyHistogram request_latency;
+  LatencyHistogram queue_wait;
+  LatencyHistogram scatter_time;
+  LatencyHistogram planner_time;
+
+private:
+  IOStats *const parent;
+};
+
+// Owner of the process totals and the per-dataset counters, keyed by dataset
+// uri. Entries live until exit so the pointers handed out stay valid.
+class StatsRegistry {
+public:
+  static StatsRegistry &getInstance();
+
+  IOStats &process() { return totals; }
+  IOStats *dataset(const std::string &uri);
+
+  // zero every counter, including the planner's decision counts
+  void reset();
+  std::string toJson() const;
+  std::string datasetJson(const std::string &uri) const;
+
+private:
+  IOStats totals;
+  mutable std::mutex mtx;
+  std::map<std::string, std::unique_ptr<IOStats>> datasets;
+
+  StatsRegistry() = default;
+  StatsRegistry(const StatsRegistry &) = delete;
+  StatsRegistry &operator=(const StatsRegistry &) = delete;
+};
+
+#endif
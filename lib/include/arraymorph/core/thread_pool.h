@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+#include "arraymorph/core/constants.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <hdf5.h>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers for blocking transports (Azure, local files). Jobs
+// queue up instead of each spawning an OS thread, so concurrency stays at
+// the pool size however many segments a read plans. Background jobs
+// (readahead, prefetch) only run when no demand job is queued and never
+// occupy more than half of the workers. Components that need workers of
+// their own (HTTP completions) create a separate pool.
+class ThreadPool {
+public:
+  // the shared I/O pool, sized by ARRAYMORPH_IO_THREADS, IO_THREAD_NUM by
+  // default
+  static ThreadPool &getInstance();
+
+  explicit ThreadPool(size_t n);
+
+  std::future<herr_t> submit(std::function<herr_t()> job);
+  void submitBackground(std::function<void()> job);
+  size_t size() const { return workers.size(); }
+
+  ~ThreadPool();
+
+private:
+  void work();
+
+  std::vector<std::thread> workers;
+  std::deque<std::packaged_task<herr_t()>> jobs;
+  std::deque<std::function<void()>> background;
+  size_t background_running = 0;
+  size_t background_limit;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping = false;
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+};
+
+#endif
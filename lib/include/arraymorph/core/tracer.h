@@ -0,0 +1,108 @@
+#ifndef TRACER
+#define TRACER
+#include "arraymorph/core/constants.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using TraceClock = std::chrono::steady_clock;
+
+// "key":value pairs of an event's args object, built only when tracing is on
+class TraceArgs {
+public:
+  TraceArgs &add(const char *key, const std::string &value);
+  TraceArgs &add(const char *key, uint64_t value);
+  TraceArgs &add(const char *key, double value);
+  const std::string &str() const { return body; }
+
+private:
+  void key(const char *key);
+  std::string body;
+};
+
+// Span tracing in Chrome trace event format, viewable in Perfetto
+// (ui.perfetto.dev) or chrome://tracing. Enabled by naming the output file
+// in ARRAYMORPH_TRACE; otherwise every entry point is one relaxed load.
+// Events are buffered in memory (up to TRACE_MAX_EVENTS) and the file is
+// rewritten whenever the VOL closes or flush() is called. Each process
+// writes its own file, named after its MPI rank or its pid
+// (trace.json -> trace.rank0.json, trace.pid1234.json).
+class Tracer {
+public:
+  static Tracer &getInstance();
+
+  static bool enabled() {
+    int s = state.load(std::memory_order_relaxed);
+    if (s < 0)
+      s = initState();
+    return s > 0;
+  }
+
+  // complete event ("X") on the calling thread
+  void span(const char *name, const char *cat, TraceClock::time_point start,
+            TraceClock::time_point end, const TraceArgs &args = {});
+  // instant event ("i") on the calling thread
+  void instant(const char *name, const char *cat, const TraceArgs &args = {});
+  void flush();
+
+  ~Tracer();
+
+private:
+  struct Event {
+    const char *name;
+    const char *cat;
+    char ph;
+    int64_t ts_us;
+    int64_t dur_us;
+    uint32_t tid;
+    std::string args;
+  };
+
+  void record(Event &&e);
+  int64_t micros(TraceClock::time_point t) const;
+  static uint32_t threadId();
+  static int initState();
+  std::string output();
+
+  std::string path;
+  // the file last written, and the MPI rank once known
+  std::string written;
+  int rank = -1;
+  const TraceClock::time_point epoch;
+  std::vector<Event> events;
+  size_t dropped = 0;
+  std::mutex mtx;
+
+  // -1 until ARRAYMORPH_TRACE has been read
+  static inline std::atomic<int> state{-1};
+
+  Tracer();
+  Tracer(const Tracer &) = delete;
+  Tracer &operator=(const Tracer &) = delete;
+};
+
+// Records a span from construction to destruction. Callers attach args
+// only when `active`, so a disabled tracer costs no formatting.
+class TraceSpan {
+public:
+  TraceSpan(const char *name, const char *cat)
+      : name(name), cat(cat), active(Tracer::enabled()) {
+    if (active)
+      start = TraceClock::now();
+  }
+  ~TraceSpan() {
+    if (active)
+      Tracer::getInstance().span(name, cat, start, TraceClock::now(), args);
+  }
+
+  const char *name;
+  const char *cat;
+  const bool active;
+  TraceClock::time_point start;
+  TraceArgs args;
+};
+
+#endif
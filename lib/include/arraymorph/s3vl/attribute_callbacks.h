@@ -0,0 +1,31 @@
+#ifndef S3VL_ATTRIBUTE_CALLBACKS
+
+#include "arraymorph/s3vl/attribute_obj.h"
+#include <hdf5.h>
+
+// Attributes of datasets, kept in their metadata (see attribute_obj.h).
+// Files and groups have none: iterating them visits nothing and creating
+// one fails.
+class S3VLAttrCallbacks {
+public:
+  static void *S3VL_attr_create(void *obj, const H5VL_loc_params_t *loc_params,
+                                const char *attr_name, hid_t type_id,
+                                hid_t space_id, hid_t acpl_id, hid_t aapl_id,
+                                hid_t dxpl_id, void **req);
+  static void *S3VL_attr_open(void *obj, const H5VL_loc_params_t *loc_params,
+                              const char *attr_name, hid_t aapl_id,
+                              hid_t dxpl_id, void **req);
+  static herr_t S3VL_attr_read(void *attr, hid_t mem_type_id, void *buf,
+                               hid_t dxpl_id, void **req);
+  static herr_t S3VL_attr_write(void *attr, hid_t mem_type_id, const void *buf,
+                                hid_t dxpl_id, void **req);
+  static herr_t S3VL_attr_get(void *obj, H5VL_attr_get_args_t *args,
+                              hid_t dxpl_id, void **req);
+  static herr_t S3VL_attr_specific(void *obj,
+                                   const H5VL_loc_params_t *loc_params,
+                                   H5VL_attr_specific_args_t *args,
+                                   hid_t dxpl_id, void **req);
+  static herr_t S3VL_attr_close(void *attr, hid_t dxpl_id, void **req);
+};
+#define S3VL_ATTRIBUTE_CALLBACKS
+#endif
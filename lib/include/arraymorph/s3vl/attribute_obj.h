@@ -0,0 +1,66 @@
+#ifndef S3VL_ATTRIBUTE_OBJ
+#define S3VL_ATTRIBUTE_OBJ
+#include <hdf5.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class S3VLDatasetObj;
+
+// One attribute of a dataset, kept in the dataset's metadata object so that
+// opening the dataset brings every attribute along. Values larger than
+// ATTR_INLINE_MAX are stored as "<dataset uri>/attr/<id>" instead and
+// fetched when first read. Fixed-size types are stored as their elements;
+// variable-length strings as a 4-byte length and the bytes of each string.
+class S3VLAttr {
+public:
+  // null if the type or dataspace cannot be stored: variable-length
+  // sequences, references, and variable-length strings nested in other types
+  static std::shared_ptr<S3VLAttr> create(const std::string &name,
+                                          uint32_t id, hid_t type_id,
+                                          hid_t space_id);
+  ~S3VLAttr();
+
+  // convert between mem_type_id and the stored type (H5Tconvert);
+  // variable-length strings are written and read as variable-length
+  // strings only, read back into memory from H5allocate_memory
+  herr_t write(hid_t mem_type_id, const void *buf);
+  herr_t read(hid_t mem_type_id, void *buf) const;
+  // a new dataspace of the attribute's extent
+  hid_t space() const;
+  hsize_t elements() const;
+
+  // the attribute's entry in the dataset metadata; `p` is advanced past
+  // it, null is returned if it is malformed
+  void encode(std::vector<char> &out) const;
+  static std::shared_ptr<S3VLAttr> decode(const char *&p, const char *end);
+
+  std::string name;
+  // names the object of a spilled value; unique within the dataset
+  const uint32_t id;
+  hid_t type;
+  // -1 for a null dataspace, 0 for a scalar
+  int rank;
+  std::vector<hsize_t> dims;
+  std::vector<char> value;
+  // bytes of value, also while a spilled value is not fetched yet
+  uint64_t size = 0;
+  bool spilled = false;
+  bool loaded = true;
+
+private:
+  S3VLAttr(const std::string &name, uint32_t id, hid_t type, int rank,
+           std::vector<hsize_t> dims);
+
+  S3VLAttr(const S3VLAttr &) = delete;
+  S3VLAttr &operator=(const S3VLAttr &) = delete;
+};
+
+// An open attribute: its entry, and the dataset it belongs to, which is
+// kept until the last of its attributes is closed
+typedef struct S3VLAttrObj {
+  S3VLDatasetObj *dset;
+  std::shared_ptr<S3VLAttr> attr;
+} S3VLAttrObj;
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef S3VL_C_API
+#define S3VL_C_API
+#include <hdf5.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Connector-specific operations, registered as dynamic VOL optional
+ * operations under these names and exported as plain C functions so they can
+ * be called from C, Fortran or Python (ctypes) on an h5py/HDF5 dataset id.
+ */
+#define ARRAYMORPH_OPT_REDUCE_NAME "arraymorph.reduce"
+#define ARRAYMORPH_OPT_STATS_NAME "arraymorph.stats"
+#define ARRAYMORPH_OPT_PREFETCH_NAME "arraymorph.prefetch"
+#define ARRAYMORPH_OPT_LOADER_NAME "arraymorph.loader"
+#define ARRAYMORPH_OPT_READ_NAME "arraymorph.read"
+#define ARRAYMORPH_OPT_WRITE_NAME "arraymorph.write"
+
+/* File access property list entries read when a file is created or opened,
+ * set with arraymorph_set_fapl_concurrency() */
+#define ARRAYMORPH_FAPL_CONCURRENCY "arraymorph.concurrency"
+#define ARRAYMORPH_FAPL_INITIAL_CONCURRENCY "arraymorph.initial_concurrency"
+#define ARRAYMORPH_FAPL_MIN_CONCURRENCY "arraymorph.min_concurrency"
+#define ARRAYMORPH_FAPL_MAX_CONCURRENCY "arraymorph.max_concurrency"
+
+/* Dataset creation property list entry, set with
+ * arraymorph_set_dcpl_key_stripes() */
+#define ARRAYMORPH_DCPL_KEY_STRIPES "arraymorph.key_stripes"
+
+/* Dataset transfer property list entry, set with
+ * arraymorph_set_dxpl_collective() */
+#define ARRAYMORPH_DXPL_COLLECTIVE "arraymorph.collective"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct arraymorph_reduce_result_t {
+  double sum;
+  double min;
+  double max;
+  double mean;
+  uint64_t count;
+} arraymorph_reduce_result_t;
+
+/* args of the ARRAYMORPH_OPT_REDUCE_NAME dataset optional operation */
+typedef struct arraymorph_reduce_args_t {
+  hid_t file_space_id;
+  arraymorph_reduce_result_t *result;
+} arraymorph_reduce_args_t;
+
+/* sum/min/max/mean/count over the selection of file_space_id (H5S_ALL for
+ * the whole dataset), streamed chunk by chunk */
+herr_t arraymorph_dataset_reduce(hid_t dset_id, hid_t file_space_id,
+                                 arraymorph_reduce_result_t *result);
+
+/* args of the ARRAYMORPH_OPT_PREFETCH_NAME dataset optional operation */
+typedef struct arraymorph_prefetch_args_t {
+  hid_t file_space_id;
+  size_t *queued;
+} arraymorph_prefetch_args_t;
+
+/* start fetching the chunks of the selection of file_space_id (H5S_ALL for
+ * the whole dataset) in the background and return immediately; later reads
+ * of those chunks are served from the dataset's readahead buffer. The number
+ * of chunk fetches queued (chunks already cached or in flight are skipped)
+ * is stored in *queued when it is not NULL. */
+herr_t arraymorph_dataset_prefetch(hid_t dset_id, hid_t file_space_id,
+                                   size_t *queued);
+
+/* args of the ARRAYMORPH_OPT_READ_NAME and ARRAYMORPH_OPT_WRITE_NAME dataset
+ * optional operations */
+typedef struct arraymorph_box_args_t {
+  const hsize_t *start;
+  const hsize_t *count;
+  void *buf;
+} arraymorph_box_args_t;
+
+/* read the block of count[i] elements from start[i] in every dimension
+ * into buf, which holds it densely in C order in the dataset's own type.
+ * The same as H5Dread with a hyperslab, minus the dataspaces and the type
+ * conversion path: meant for many small reads, where those cost more than
+ * the I/O. */
+herr_t arraymorph_dataset_read_box(hid_t dset_id, const hsize_t *start,
+                                   const hsize_t *count, void *buf);
+
+/* the same for writes */
+herr_t arraymorph_dataset_write_box(hid_t dset_id, const hsize_t *start,
+                                    const hsize_t *count, const void *buf);
+
+/* a background reader of batches of one dataset */
+typedef struct arraymorph_loader_t arraymorph_loader_t;
+
+/* args of the ARRAYMORPH_OPT_LOADER_NAME dataset optional operation */
+typedef struct arraymorph_loader_args_t {
+  arraymorph_loader_t **loader;
+} arraymorph_loader_args_t;
+
+/* a loader reading batches of dset_id on threads of its own, while the
+ * caller consumes the previous ones; NULL on failure. It keeps dset_id open
+ * until arraymorph_loader_close(). */
+arraymorph_loader_t *arraymorph_loader_open(hid_t dset_id);
+
+/* queue a read of the selection of file_space_id (H5S_ALL for the whole
+ * dataset) into buf, laid out by mem_space_id as in H5Dread, and return
+ * without waiting for it. The selection is resolved before the call returns,
+ * so both spaces may be closed right after; buf must stay valid until the
+ * returned ticket is waited for. Returns 0 when the selection is invalid. */
+int64_t arraymorph_loader_submit(arraymorph_loader_t *loader,
+                                 hid_t mem_space_id, hid_t file_space_id,
+                                 void *buf);
+
+/* block until the read of `ticket` is done; fails if it failed. Each ticket
+ * is waited for once. */
+herr_t arraymorph_loader_wait(arraymorph_loader_t *loader, int64_t ticket);
+
+/* finish the queued reads and release the loader and its reference on the
+ * dataset */
+herr_t arraymorph_loader_close(arraymorph_loader_t *loader);
+
+/* args of the ARRAYMORPH_OPT_STATS_NAME dataset optional operation */
+typedef struct arraymorph_stats_args_t {
+  char *buf;
+  size_t size;
+  size_t *length;
+} arraymorph_stats_args_t;
+
+/* I/O statistics as JSON: {"process": {...}, "planner": {...},
+ * "endpoints": {...}, "datasets": {"<uri>": {...}}}. Writes at most size
+ * bytes including the terminating NUL and returns the full length, like
+ * snprintf, so callers can retry with a larger buffer. */
+size_t arraymorph_stats_json(char *buf, size_t size);
+
+/* the same for one dataset; the full length is stored in *length */
+herr_t arraymorph_dataset_stats_json(hid_t dset_id, char *buf, size_t size,
+                                     size_t *length);
+
+/* zero every counter and histogram */
+void arraymorph_reset_stats(void);
+
+/* override the request window of the storage endpoint for files opened with
+ * fapl_id: `fixed` pins it and turns adaptation off, otherwise `initial`,
+ * `min` and `max` configure the AIMD controller; 0 leaves a value as it is.
+ * Takes precedence over the ARRAYMORPH_*CONCURRENCY variables. The
+ * connection pool is sized from the first file opened, so a larger `max`
+ * given later can only be reached up to that size. */
+herr_t arraymorph_set_fapl_concurrency(hid_t fapl_id, size_t initial,
+                                       size_t min, size_t max, size_t fixed);
+
+/* hash the chunk objects of datasets created with dcpl_id over `stripes`
+ * key prefixes ("<hex stripe>/<file>/<dataset>/<chunk>") instead of one, so
+ * S3's per-prefix request rate limits do not cap reads of a single dataset.
+ * 0 or 1 keeps the plain layout. The count is stored in the dataset's
+ * metadata, so readers need no setting. Takes precedence over
+ * ARRAYMORPH_KEY_STRIPES. */
+herr_t arraymorph_set_dcpl_key_stripes(hid_t dcpl_id, size_t stripes);
+
+/* open files with fapl_id through the connector, reading from the stores of
+ * `config`: "key=value;..." per store (bucket, endpoint, region, access_key,
+ * secret_key, connection_string, tls, path_style, signed_payloads), replicas
+ * of the same objects separated by '|'. Writes go to the first store; reads
+ * go to the one answering fastest and fail over to the others. Keys left out
+ * fall back to the environment. */
+herr_t arraymorph_set_fapl_endpoints(hid_t fapl_id, const char *config);
+
+/* make H5Dread and H5Dwrite with dxpl_id collective over the MPI
+ * communicator whose Fortran handle is comm_f (MPI_Comm_c2f(comm), or
+ * comm.py2f() in mpi4py); -1 makes them independent again. Each chunk the
+ * ranks touch is fetched or stored by one of them and its bytes are
+ * exchanged over MPI, so a chunk is GET or PUT once per call however many
+ * ranks share it. Every rank of the communicator must take part in each
+ * call. Fails unless the connector was built with ARRAYMORPH_ENABLE_MPI. */
+herr_t arraymorph_set_dxpl_collective(hid_t dxpl_id, int comm_f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
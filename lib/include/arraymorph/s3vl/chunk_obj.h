@@ -19,6 +19,8 @@ typedef struct CPlan {
   std::vector<std::unique_ptr<Segment>> segments;
   std::string lambda_query = "";
 
+  // an empty slot, filled in when its chunk is planned
+  CPlan() : chunk_id(-1), qp(QPlan::GET), num_requests(0) {}
   CPlan(int id, QPlan q, size_t reqs, std::vector<std::unique_ptr<Segment>> &&s)
       : chunk_id(id), qp(q), num_requests(reqs), segments(std::move(s)) {}
 
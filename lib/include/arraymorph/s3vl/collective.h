@@ -0,0 +1,27 @@
+#ifndef S3VL_COLLECTIVE
+#define S3VL_COLLECTIVE
+#include "arraymorph/s3vl/dataset_obj.h"
+#include <hdf5.h>
+#include <mpi.h>
+
+// Collective H5Dread and H5Dwrite, in builds with ARRAYMORPH_ENABLE_MPI.
+// The ranks of a communicator exchange the bounding boxes of their
+// selections, and every chunk any of them touches is assigned to one of the
+// ranks touching it. On reads that aggregator GETs the chunk once and sends
+// it to the other ranks that need it; on writes it receives their pieces,
+// merges them in rank order and PUTs the chunk once. Every rank of the
+// communicator must make the call, with an empty selection if it has
+// nothing to move, and all of them fail if one does.
+class S3VLCollective {
+public:
+  // whether dxpl_id asks for collective I/O, and over which communicator:
+  // arraymorph_set_dxpl_collective, or H5Pset_dxpl_mpio(H5FD_MPIO_COLLECTIVE)
+  // for MPI_COMM_WORLD when HDF5 is parallel
+  static bool requested(hid_t dxpl_id, MPI_Comm &comm);
+  static herr_t read(S3VLDatasetObj &dset, MPI_Comm comm, hid_t mem_space_id,
+                     hid_t file_space_id, void *buf);
+  static herr_t write(S3VLDatasetObj &dset, MPI_Comm comm, hid_t mem_space_id,
+                      hid_t file_space_id, const void *buf);
+};
+
+#endif
@@ -22,6 +22,10 @@ public:
   static herr_t S3VL_obj_get(void *obj, const H5VL_loc_params_t *loc_params,
                              H5VL_object_get_args_t *args, hid_t dxpl_id,
                              void **req);
+  static herr_t S3VL_obj_specific(void *obj,
+                                  const H5VL_loc_params_t *loc_params,
+                                  H5VL_object_specific_args_t *args,
+                                  hid_t dxpl_id, void **req);
   static void *S3VL_wrap_object(void *obj, H5I_type_t obj_type, void *wrap_ctx);
   static void *S3VL_get_object(const void *obj);
   static herr_t S3VL_dataset_read(size_t count, void **dset, hid_t *mem_type_id,
@@ -37,6 +41,19 @@ public:
   static herr_t S3VL_dataset_specific(void *obj,
                                       H5VL_dataset_specific_args_t *args,
                                       hid_t dxpl_id, void **req);
+  static herr_t S3VL_dataset_optional(void *obj, H5VL_optional_args_t *args,
+                                      hid_t dxpl_id, void **req);
+
+  // dynamic optional operations (see c_api.h)
+  static herr_t registerOptionalOps();
+  static herr_t unregisterOptionalOps();
+  static bool isOptionalOp(int op_type);
+  static int reduce_op;
+  static int stats_op;
+  static int prefetch_op;
+  static int loader_op;
+  static int read_op;
+  static int write_op;
 };
 #define S3VL_DATASET_CALLBACKS
 #endif
@@ -1,9 +1,16 @@
 #ifndef S3VL_DATASET_OBJ
 #define S3VL_DATASET_OBJ
+#include "arraymorph/core/chunk_cache.h"
 #include "arraymorph/core/constants.h"
+#include "arraymorph/core/endpoints.h"
 #include "arraymorph/core/operators.h"
+#include "arraymorph/core/reducer.h"
+#include "arraymorph/core/stats.h"
+#include "arraymorph/s3vl/attribute_obj.h"
 #include "arraymorph/s3vl/chunk_obj.h"
+#include "arraymorph/s3vl/group_obj.h"
 #include <hdf5.h>
+#include <list>
 #include <optional>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,44 +23,180 @@ public:
   S3VLDatasetObj(const std::string &name, const std::string &uri, hid_t dtype,
                  int ndims, std::vector<hsize_t> &shape,
                  std::vector<hsize_t> &chunk_shape, int chunk_num,
-                 const std::string &bucket_name, const CloudClient &client);
+                 std::shared_ptr<EndpointPool> endpoints,
+                 int key_stripes = 0, std::vector<hsize_t> max_shape = {});
   ~S3VLDatasetObj() {};
 
-  static S3VLDatasetObj *getDatasetObj(const CloudClient &client,
-                                       const std::string &bucket_name,
-                                       const std::string &uri);
-  static S3VLDatasetObj *getDatasetObj(const CloudClient &client,
-                                       const std::string &bucket_name,
-                                       std::vector<char> &buffer);
+  // the metadata object `uri`, from the first replica that has it
+  static S3VLDatasetObj *
+  getDatasetObj(const std::shared_ptr<EndpointPool> &endpoints,
+                const std::string &uri);
+  static S3VLDatasetObj *
+  getDatasetObj(const std::shared_ptr<EndpointPool> &endpoints,
+                std::vector<char> &buffer);
   char *toBuffer(int *length);
   std::vector<std::shared_ptr<S3VLChunkObj>>
   generateChunks(std::vector<std::vector<hsize_t>> ranges);
+  // one of the chunks generateChunks returns; safe to call concurrently
+  std::shared_ptr<S3VLChunkObj>
+  generateChunk(int chunk_idx,
+                const std::vector<std::vector<hsize_t>> &ranges) const;
+  // indices of the chunks a selection touches
+  std::vector<int>
+  accessedChunks(const std::vector<std::vector<hsize_t>> &ranges) const;
+  // object key of a chunk: "<uri>/<idx>", or "<uri>/<c0>.<c1>..." by grid
+  // coordinates when the dataset is extensible, behind a hashed "<stripe>/"
+  // prefix when the dataset is striped
+  std::string chunkKey(int chunk_idx) const;
+  // the key of a chunk in the node-wide cache (shm_cache.h): chunkKey
+  // behind the store and bucket, which other processes may not share
+  std::string sharedKey(const std::string &chunk_key) const;
   std::string to_string();
-  std::vector<hsize_t> getChunkOffsets(int chunk_idx);
-  std::vector<std::vector<hsize_t>> getChunkRanges(int chunk_idx);
+  std::vector<hsize_t> getChunkOffsets(int chunk_idx) const;
+  std::vector<std::vector<hsize_t>> getChunkRanges(int chunk_idx) const;
   std::vector<std::vector<hsize_t>> selectionFromSpace(hid_t space_id);
+  // the bounding box of the selection of file_space_id (H5S_ALL for the
+  // whole dataset), empty when nothing is selected; fails when it reaches
+  // past the extent
+  herr_t fileRanges(hid_t file_space_id,
+                    std::vector<std::vector<hsize_t>> &ranges);
+  // the block of count[i] elements from start[i] in every dimension, with
+  // the same checks; empty when a count is 0
+  herr_t boxRanges(const hsize_t *start, const hsize_t *count,
+                   std::vector<std::vector<hsize_t>> &ranges);
+  // the offsets of the rows of `ranges` in a buffer laid out by
+  // mem_space_id (H5S_ALL: like the dataset); returns the row length, 0
+  // when the layout is not supported
+  hsize_t bufferLayout(hid_t mem_space_id,
+                       const std::vector<std::vector<hsize_t>> &ranges,
+                       std::vector<hsize_t> &offsets);
+  // the runs that move the part of a chunk inside `ranges` between the
+  // whole chunk and such a buffer: {offset in chunk, offset in buffer,
+  // bytes}
+  std::list<std::vector<hsize_t>>
+  chunkMapping(int chunk_idx, const std::vector<std::vector<hsize_t>> &ranges,
+               std::vector<hsize_t> &buf_offsets,
+               hsize_t buf_row_size) const;
+
+  // H5Dset_extent: only the metadata changes, uploaded on flush or close.
+  // Dimensions may only grow, up to max_shape.
+  herr_t setExtent(const hsize_t *size);
+  // H5Drefresh: take the extent and attributes from the stored metadata,
+  // e.g. after another process appended
+  herr_t refresh();
+  // the attribute called `name`, null if there is none
+  std::shared_ptr<S3VLAttr> findAttr(const std::string &name) const;
+  // a new attribute; null if `name` is taken or cannot be stored
+  std::shared_ptr<S3VLAttr> createAttr(const std::string &name, hid_t type_id,
+                                       hid_t space_id);
+  herr_t deleteAttr(const std::string &name);
+  herr_t renameAttr(const std::string &old_name, const std::string &new_name);
+  // after a write: keep the value in the metadata, or store it as
+  // "<uri>/attr/<id>" when it is larger than ATTR_INLINE_MAX
+  herr_t storeAttr(S3VLAttr &attr);
+  // fetch the value of a spilled attribute before its first read
+  herr_t loadAttr(S3VLAttr &attr);
   // QPlan getQueryPlan(FileFormat format, vector<vector<hsize_t>> ranges);
 
-  void upload();
+  // store the metadata; is_modified stays set if the store failed
+  herr_t upload();
   herr_t write(hid_t mem_space_id, hid_t file_space_id, const void *buf);
+  // write a selection already resolved by fileRanges and bufferLayout
+  herr_t write(const std::vector<std::vector<hsize_t>> &ranges,
+               std::vector<hsize_t> &source_offsets, hsize_t source_row_size,
+               const void *buf);
   herr_t read(hid_t mem_space_id, hid_t file_space_id, void *buf);
+  // read a selection already resolved by fileRanges and bufferLayout; no
+  // HDF5 calls, so it may run off the application's thread. Reads that
+  // follow a schedule of their own skip the sequential-access detector.
+  herr_t read(const std::vector<std::vector<hsize_t>> &ranges,
+              std::vector<hsize_t> &out_offsets, hsize_t out_row_size,
+              void *buf, bool detect_readahead);
+  // read or write the block from `start` of `count` elements per dimension,
+  // held densely in C order in buf, without dataspaces (arraymorph.read
+  // and arraymorph.write)
+  herr_t readBox(const hsize_t *start, const hsize_t *count, void *buf);
+  herr_t writeBox(const hsize_t *start, const hsize_t *count,
+                  const void *buf);
+  // stream the selection through the fetch engine, keeping only partial
+  // sum/min/max/count per response
+  herr_t reduce(hid_t file_space_id, ReduceResult &result);
+  // queue background whole-chunk fetches into `cache` for the chunks that
+  // are not cached or in flight yet; returns how many were queued
+  size_t fetchAhead(const std::vector<int> &chunks);
+  // fetch the chunks of a selection ahead of the reads that will need them
+  size_t prefetch(hid_t file_space_id);
+  // feed a demand read to the sequential-access detector and read ahead
+  // along the detected stride
+  void readahead(const std::vector<std::vector<hsize_t>> &ranges, bool waited);
 
   const std::string name;
   const std::string uri;
   hid_t dtype;
   const int ndims;
-  const std::vector<hsize_t> shape;
+  std::vector<hsize_t> shape;
+  // H5S_UNLIMITED for unbounded dimensions; equal to shape when the dataset
+  // cannot be resized
+  const std::vector<hsize_t> max_shape;
   const std::vector<hsize_t> chunk_shape;
-  const int chunk_num;
-  const std::string bucket_name;
+  int chunk_num;
+  // key prefixes the chunks are hashed over, 0 for none; fixed at creation
+  // and stored in the metadata
+  const int key_stripes;
+  // created with a max_shape: chunks are keyed by grid coordinates, so a
+  // new extent leaves every stored chunk where it is
+  const bool extensible;
 
   hsize_t data_size;
   std::vector<hsize_t> num_per_dim;
   std::vector<hsize_t> reduc_per_dim;
   hsize_t element_per_chunk;
   bool is_modified{false};
+  // bounding box of the elements that may already be stored: the extent
+  // when opened, grown by every write. A write that covers a chunk in it
+  // only partially merges the stored chunk first.
+  std::vector<hsize_t> stored_shape;
+  // per-dataset counters, also rolled into the process totals
+  IOStats *stats;
+  // chunks fetched ahead of demand reads; null when readahead is disabled
+  // (ARRAYMORPH_READAHEAD_MB=0)
+  std::shared_ptr<ChunkCache> cache;
+  // sequential-access detector: the last selection, the dimension and step
+  // it moved by, how many reads in a row repeated that step, and how many
+  // selections ahead to fetch
+  struct {
+    std::vector<std::vector<hsize_t>> last;
+    int dim = -1;
+    long long step = 0;
+    int run = 0;
+    int depth = READAHEAD_MIN_DEPTH;
+  } sequential;
+
+  // the stores of the file; null for metadata-only use
+  std::shared_ptr<EndpointPool> endpoints;
+
+  // in creation order; stored with the metadata (see attribute_obj.h)
+  std::vector<std::shared_ptr<S3VLAttr>> attrs;
+  // the id of the next attribute; ids are never reused, so a spilled value
+  // still named by metadata a reader holds is never overwritten
+  uint32_t next_attr_id = 0;
+  // ids of spilled values no attribute refers to any more, deleted once the
+  // metadata without them is stored
+  std::vector<uint32_t> dropped_attrs;
+  // open attribute handles, and whether H5Dclose came before the last of
+  // them was closed
+  int open_attrs = 0;
+  bool closed = false;
+  // set on create: the group the dataset is linked into, whose index is
+  // stored once the metadata is, so listings only name stored datasets
+  std::shared_ptr<S3VLGroupIndex> parent;
 
-  const CloudClient &client;
+private:
+  // num_per_dim, reduc_per_dim and chunk_num for the current shape
+  void layoutGrid();
+  // whether a write of local_ranges to the chunk must keep stored data
+  bool needsMerge(int chunk_idx,
+                  const std::vector<std::vector<hsize_t>> &local_ranges) const;
 };
 
 #endif
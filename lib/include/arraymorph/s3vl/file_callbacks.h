@@ -1,9 +1,16 @@
 #ifndef S3VL_FILE_CALLBACKS
+#include "arraymorph/core/endpoints.h"
+#include "arraymorph/s3vl/group_obj.h"
 #include <hdf5.h>
+#include <memory>
 #include <string>
 
 typedef struct S3VLFileObj {
   std::string name;
+  // the stores the file is read from and written to
+  std::shared_ptr<EndpointPool> endpoints;
+  // its groups, shared with the group handles, which may outlive it
+  std::shared_ptr<S3VLGroupTree> groups;
 } S3VLFileObj;
 
 class S3VLFileCallbacks {
@@ -15,6 +22,8 @@ public:
   static herr_t S3VL_file_get(void *file, H5VL_file_get_args_t *args,
                               hid_t dxpl_id, void **req);
   static herr_t S3VL_file_close(void *file, hid_t dxpl_id, void **req);
+  // drop the clients of every store, at connector shutdown
+  static void disconnect();
 };
 #define S3VL_FILE_CALLBACKS
 #endif
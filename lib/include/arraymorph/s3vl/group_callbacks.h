@@ -1,14 +1,16 @@
 #ifndef S3VL_GROUP_CALLBACKS
+#include "arraymorph/s3vl/group_obj.h"
 #include <hdf5.h>
 #include <string>
-#include <vector>
-
-typedef struct S3VLGroupObj {
-  std::vector<std::string> keys;
-} S3VLGroupObj;
 
+// Groups and the links in them, served from the group indexes (see
+// group_obj.h). Every link is a hard link; soft and external links, and
+// deleting or moving links, are not supported.
 class S3VLGroupCallbacks {
 public:
+  static void *S3VLgroup_create(void *obj, const H5VL_loc_params_t *loc_params,
+                                const char *name, hid_t lcpl_id, hid_t gcpl_id,
+                                hid_t gapl_id, hid_t dxpl_id, void **req);
   static void *S3VLgroup_open(void *obj, const H5VL_loc_params_t *loc_params,
                               const char *name, hid_t gapl_id, hid_t dxpl_id,
                               void **req);
@@ -22,6 +24,15 @@ public:
                                   const H5VL_loc_params_t *loc_params,
                                   H5VL_link_specific_args_t *args,
                                   hid_t dxpl_id, void **req);
+
+  // the group `obj` is, or the root group of the file `obj` is; false for
+  // any other object
+  static bool locate(void *obj, H5I_type_t obj_type, S3VLGroupObj &loc);
+  // the path `loc_params` names from `obj`, which must be a file or group
+  static bool resolve(void *obj, const H5VL_loc_params_t *loc_params,
+                      S3VLGroupObj &loc);
+  // H5Pget_create_intermediate_group of a link creation property list
+  static bool intermediate(hid_t lcpl_id);
 };
 #define S3VL_GROUP_CALLBACKS
 #endif
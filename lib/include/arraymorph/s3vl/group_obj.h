@@ -0,0 +1,88 @@
+#ifndef S3VL_GROUP_OBJ
+#define S3VL_GROUP_OBJ
+#include "arraymorph/core/endpoints.h"
+#include <hdf5.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The links of one group: the name and object type of every dataset and
+// group in it, stored as the index object "<group uri>/.index" (the root's
+// is "<file>/.index"). Listing a group is one GET of its index, however many
+// chunks its datasets hold. Files written before groups had indexes list
+// nothing, though their datasets still open by name.
+class S3VLGroupIndex {
+public:
+  S3VLGroupIndex(std::shared_ptr<EndpointPool> endpoints,
+                 const std::string &key);
+
+  // the stored links; none if the index is not stored yet
+  herr_t load();
+  // store the links, together with those other writers stored since they
+  // were loaded unless `merge` is off, as for a group just created
+  herr_t publish(bool merge = true);
+  // in memory until the next publish()
+  void add(const std::string &name, H5O_type_t type);
+  // H5O_TYPE_UNKNOWN if there is no link called `name`
+  H5O_type_t find(const std::string &name);
+  // by name, the only order kept
+  std::vector<std::pair<std::string, H5O_type_t>> links();
+
+  const std::string key;
+
+private:
+  std::shared_ptr<EndpointPool> endpoints;
+  std::mutex mtx;
+  std::map<std::string, H5O_type_t> entries;
+
+  static bool decode(const std::vector<char> &buffer,
+                     std::map<std::string, H5O_type_t> &entries);
+  static std::vector<char> encode(const std::map<std::string, H5O_type_t> &);
+};
+
+// The groups of an open file by path, "" for the root and "a/b" below it;
+// each index is loaded on first use and shared by every handle on the file
+class S3VLGroupTree {
+public:
+  S3VLGroupTree(const std::string &file,
+                std::shared_ptr<EndpointPool> endpoints);
+
+  // the group at `path`, null if there is none
+  std::shared_ptr<S3VLGroupIndex> open(const std::string &path);
+  // a new group, linked into its parent; with `intermediate`
+  // (H5Pset_create_intermediate_group) missing parents are created too
+  std::shared_ptr<S3VLGroupIndex> create(const std::string &path,
+                                         bool intermediate);
+  // the group a new object at `path` is linked into; null if the name is
+  // taken or the group does not exist and `intermediate` is not set
+  std::shared_ptr<S3VLGroupIndex> parent(const std::string &path,
+                                         bool intermediate);
+  // the type of the object at `path`, H5O_TYPE_UNKNOWN if it is not linked
+  H5O_type_t type(const std::string &path);
+  // "<file>/<path>", the prefix of every key of the object at `path`
+  std::string uri(const std::string &path) const;
+
+  const std::string file;
+  const std::shared_ptr<EndpointPool> endpoints;
+
+private:
+  std::recursive_mutex mtx;
+  std::map<std::string, std::shared_ptr<S3VLGroupIndex>> groups;
+};
+
+// `name` relative to the group at `base`, or absolute when it starts with
+// "/"; "." and empty components are dropped
+std::string joinPath(const std::string &base, const std::string &name);
+// the parent path and the last component
+std::pair<std::string, std::string> splitPath(const std::string &path);
+
+// An open group, or the root group of a file
+typedef struct S3VLGroupObj {
+  std::shared_ptr<S3VLGroupTree> tree;
+  std::string path;
+} S3VLGroupObj;
+
+#endif
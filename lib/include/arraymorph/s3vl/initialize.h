@@ -4,6 +4,10 @@
 #include "arraymorph/core/constants.h"
 #include "arraymorph/core/logger.h"
 #include "arraymorph/core/operators.h"
+#include "arraymorph/core/planner.h"
+#include "arraymorph/core/tracer.h"
+#include "arraymorph/s3vl/dataset_callbacks.h"
+#include "arraymorph/s3vl/file_callbacks.h"
 #include "arraymorph/s3vl/vol_connector.h"
 #include <aws/core/Aws.h>
 #include <cstdlib>
@@ -38,33 +42,45 @@ inline herr_t S3VLINITIALIZE::s3VL_initialize_init(hid_t vipl_id) {
   if (platform.has_value()) {
     std::string platform_str = platform.value();
     if (platform_str == "S3")
-      Logger::log("------ Using S3");
+      Logger::info("------ Using S3");
     else if (platform_str == "Azure") {
-      Logger::log("------ Using Azure");
+      Logger::info("------ Using Azure");
       SP = SPlan::AZURE_BLOB;
+    } else if (platform_str == "File") {
+      Logger::info("------ Using local file system");
+      SP = SPlan::LOCAL_FILE;
     } else {
-      Logger::log("------ Unsupported platform");
+      Logger::error("------ Unsupported platform");
       return ARRAYMORPH_FAIL;
     }
   } else {
-    Logger::log("------ Using default platform S3");
+    Logger::info("------ Using default platform S3");
   }
   std::optional<std::string> bucket_name = getEnv("BUCKET_NAME");
   if (bucket_name.has_value()) {
     BUCKET_NAME = bucket_name.value();
-    Logger::log("------ Using bucket", BUCKET_NAME);
+    Logger::info("------ Using bucket", BUCKET_NAME);
   } else {
-    Logger::log("------ Bucekt not set");
-    return ARRAYMORPH_FAIL;
+    Logger::info("------ BUCKET_NAME not set, files name their bucket in the "
+                 "connector info");
   }
+  std::optional<std::string> query_plan = getEnv("ARRAYMORPH_QUERY_PLAN");
+  if (query_plan.has_value()) {
+    SINGLE_PLAN = parseQueryPlan(query_plan.value());
+    Logger::info("------ Using query plan", queryPlanName(SINGLE_PLAN));
+  }
+  S3VLDatasetCallbacks::registerOptionalOps();
   return S3_VOL_CONNECTOR_VALUE;
 }
 
 inline herr_t S3VLINITIALIZE::s3VL_initialize_close() {
   Logger::log("------ Close VOL");
+  S3VLDatasetCallbacks::unregisterOptionalOps();
+  if (Tracer::enabled())
+    Tracer::getInstance().flush();
+  Logger::flush();
   // Proper SDK shutdown.
-  global_cloud_client =
-      std::monostate{}; // Reset the client's state to trigger destructor
+  S3VLFileCallbacks::disconnect(); // drop the clients to run destructors
   //// Intentionally skip Aws::ShutdownAPI() — we're inside HDF5's atexit
   // teardown where static destruction order is undefined. The process is
   // exiting; the OS will reclaim all resources.
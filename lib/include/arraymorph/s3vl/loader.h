@@ -0,0 +1,41 @@
+#ifndef S3VL_LOADER
+#define S3VL_LOADER
+#include "arraymorph/core/thread_pool.h"
+#include "arraymorph/s3vl/dataset_obj.h"
+#include <hdf5.h>
+#include <map>
+#include <mutex>
+
+// Batches of one dataset read in the background into buffers the caller
+// owns, for input pipelines (arraymorph.Loader) that queue the next batches
+// while they consume the current one. Selections are resolved on the
+// caller's thread when queued; the reads themselves make no HDF5 calls and
+// run on LOADER_THREAD_NUM workers of the loader's own, so a caller blocked
+// in wait() does not hold up the shared I/O pool. Loader reads bypass the
+// sequential-access detector: the queue already says what comes next.
+class S3VLLoader {
+public:
+  explicit S3VLLoader(S3VLDatasetObj *dset);
+  // finishes the queued reads
+  ~S3VLLoader();
+
+  // queue a read of the selection of file_space_id into buf, laid out by
+  // mem_space_id; returns a ticket for wait(), 0 when the selection is
+  // invalid. buf must stay valid until the ticket is waited for.
+  int64_t submit(hid_t mem_space_id, hid_t file_space_id, void *buf);
+  // block until the read behind ticket is done; its status
+  herr_t wait(int64_t ticket);
+
+  // the dataset id the C API holds a reference on while the loader lives
+  hid_t dset_id = H5I_INVALID_HID;
+
+private:
+  S3VLDatasetObj *dset;
+  std::mutex mtx;
+  std::map<int64_t, std::future<herr_t>> pending;
+  int64_t next_ticket = 1;
+  // last: its destructor drains the queue while the rest is still alive
+  ThreadPool pool;
+};
+
+#endif
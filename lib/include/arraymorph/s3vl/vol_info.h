@@ -0,0 +1,45 @@
+#ifndef S3VL_VOL_INFO
+#define S3VL_VOL_INFO
+#include <hdf5.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Connection settings of one store; empty fields fall back to the
+// environment (BUCKET_NAME, AWS_*, AZURE_STORAGE_CONNECTION_STRING,
+// ARRAYMORPH_FILE_ROOT)
+struct EndpointConfig {
+  std::string bucket;
+  // S3 endpoint URL, or the root directory with STORAGE_PLATFORM=File
+  std::string endpoint;
+  std::string region;
+  std::string access_key;
+  std::string secret_key;
+  std::string connection_string;
+  std::optional<bool> tls;
+  std::optional<bool> path_style;
+  std::optional<bool> signed_payloads;
+};
+
+// Connector info: the stores a file is read from, as "key=value;..." per
+// store, replicas of the same data separated by '|', the first taking the
+// writes. Given after the connector name in HDF5_VOL_CONNECTOR, or with
+// arraymorph_set_fapl_endpoints(); empty means the environment alone.
+struct S3VLInfo {
+  std::string config;
+};
+
+// the stores of `config`, at least one; false if an entry is malformed
+bool parseEndpoints(const std::string &config,
+                    std::vector<EndpointConfig> &endpoints);
+
+class S3VLInfoCallbacks {
+public:
+  static void *copy(const void *info);
+  static herr_t cmp(int *cmp_value, const void *info1, const void *info2);
+  static herr_t free(void *info);
+  static herr_t to_str(const void *info, char **str);
+  static herr_t from_str(const char *str, void **info);
+};
+
+#endif
@@ -0,0 +1,216 @@
+"""
+End-to-end I/O benchmark for the ArrayMorph VOL plugin against mock_s3.py.
+
+Starts the mock object store in a child process, points the plugin at it,
+writes a chunked dataset through h5py and then reads it back with a set of
+standard access patterns. For every pattern it reports:
+
+  GB/s        selected bytes / wall time of the h5py call(s)
+  requests    GET/PUT requests the store served (503s counted separately)
+  p50 / p99   store-side service time per request, including injected delay
+  over-fetch  bytes sent by the store beyond the bytes selected
+
+Usage:
+
+    python io_bench.py --shape 4096 4096 --chunks 512 512 \\
+        --latency-ms 20 --jitter-ms 5 --bandwidth-mbps 80 --throttle 0.01
+
+Requires h5py, numpy and an installed arraymorph package (or HDF5_PLUGIN_PATH
+pointing at the built plugin). No cloud credentials are used.
+"""
+
+import argparse
+import json
+import os
+import socket
+import subprocess
+import sys
+import time
+import urllib.request
+from pathlib import Path
+
+PATTERNS = ("full", "row", "column", "tile", "random")
+BUCKET = "arraymorph-bench"
+
+
+def start_mock(args):
+    cmd = [
+        sys.executable,
+        str(Path(__file__).with_name("mock_s3.py")),
+        "--port", str(args.port),
+        "--latency-ms", str(args.latency_ms),
+        "--jitter-ms", str(args.jitter_ms),
+        "--bandwidth-mbps", str(args.bandwidth_mbps),
+        "--total-mbps", str(args.total_mbps),
+        "--throttle", str(args.throttle),
+        "--seed", str(args.seed),
+    ]  # fmt: skip
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL)
+    deadline = time.monotonic() + 10
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection(("127.0.0.1", args.port), timeout=0.2).close()
+            return proc
+        except OSError:
+            time.sleep(0.05)
+    proc.kill()
+    raise RuntimeError("mock S3 did not start")
+
+
+def mock_call(args, path, method="GET"):
+    url = f"http://127.0.0.1:{args.port}/__mock/{path}"
+    with urllib.request.urlopen(urllib.request.Request(url, method=method)) as r:
+        body = r.read()
+    return json.loads(body) if body else None
+
+
+def configure_plugin(args):
+    # must happen before h5py (and so HDF5) is imported
+    os.environ.update(
+        {
+            "STORAGE_PLATFORM": "S3",
+            "BUCKET_NAME": BUCKET,
+            "AWS_ACCESS_KEY_ID": "mock",
+            "AWS_SECRET_ACCESS_KEY": "mock",
+            "AWS_REGION": "us-east-1",
+            "AWS_ENDPOINT_URL_S3": f"http://127.0.0.1:{args.port}",
+            "AWS_USE_TLS": "false",
+            "AWS_S3_ADDRESSING_STYLE": "path",
+            "AWS_SIGNED_PAYLOADS": "false",
+        }
+    )
+    if "HDF5_PLUGIN_PATH" not in os.environ:
+        import arraymorph
+
+        arraymorph.enable()
+    os.environ.setdefault("HDF5_VOL_CONNECTOR", "arraymorph")
+
+
+def selections(shape, chunks, count, rng):
+    """(name, list of selections); each selection is one h5py read."""
+    mid = [s // 2 for s in shape]
+    rest = (slice(None),) * (len(shape) - 1)
+    yield "full", [tuple(slice(None) for _ in shape)]
+    yield "row", [(mid[0],) + rest]
+    yield "column", [rest + (mid[-1],)]
+    # one chunk's worth, straddling chunk boundaries in every dimension
+    tile = tuple(slice(s // 4, min(s, s // 4 + c)) for s, c in zip(shape, chunks))
+    yield "tile", [tile]
+    yield "random", [
+        tuple(int(rng.integers(0, s)) for s in shape) for _ in range(count)
+    ]
+
+
+def selected_bytes(data, sels):
+    import numpy as np
+
+    return sum(np.asarray(data[s]).nbytes for s in sels)
+
+
+def summarize(name, seconds, nbytes, stats):
+    import numpy as np
+
+    lat = np.array(stats["latencies"]) * 1000
+    requests = sum(stats["requests"].values())
+    moved = stats["bytes_out"] or stats["bytes_in"]
+    return {
+        "pattern": name,
+        "seconds": seconds,
+        "gbps": nbytes / seconds / 1e9 if seconds else 0.0,
+        "requests": requests,
+        "range_gets": stats["range_gets"],
+        "throttled": stats["throttled"],
+        "p50_ms": float(np.percentile(lat, 50)) if len(lat) else 0.0,
+        "p99_ms": float(np.percentile(lat, 99)) if len(lat) else 0.0,
+        "selected_bytes": nbytes,
+        "overfetch_bytes": max(0, moved - nbytes),
+    }
+
+
+def print_table(rows):
+    header = (
+        f"{'pattern':<8} {'GB/s':>8} {'seconds':>8} {'requests':>9} "
+        f"{'ranged':>7} {'503s':>5} {'p50 ms':>8} {'p99 ms':>8} {'over-fetch':>11}"
+    )
+    print(header)
+    print("-" * len(header))
+    for r in rows:
+        ratio = r["overfetch_bytes"] / r["selected_bytes"] if r["selected_bytes"] else 0
+        print(
+            f"{r['pattern']:<8} {r['gbps']:>8.3f} {r['seconds']:>8.3f} "
+            f"{r['requests']:>9} {r['range_gets']:>7} {r['throttled']:>5} "
+            f"{r['p50_ms']:>8.2f} {r['p99_ms']:>8.2f} {ratio:>10.2f}x"
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--shape", type=int, nargs="+", default=[4096, 4096])
+    parser.add_argument("--chunks", type=int, nargs="+", default=[512, 512])
+    parser.add_argument("--dtype", default="f4")
+    parser.add_argument("--patterns", nargs="+", choices=PATTERNS, default=PATTERNS)
+    parser.add_argument("--points", type=int, default=64, help="random reads")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--latency-ms", type=float, default=20.0)
+    parser.add_argument("--jitter-ms", type=float, default=5.0)
+    parser.add_argument("--bandwidth-mbps", type=float, default=80.0)
+    parser.add_argument("--total-mbps", type=float, default=0.0)
+    parser.add_argument("--throttle", type=float, default=0.0)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--no-verify", action="store_true")
+    parser.add_argument("--json", help="also write the results to this file")
+    args = parser.parse_args()
+    if len(args.shape) != len(args.chunks):
+        parser.error("--shape and --chunks need the same rank")
+
+    proc = start_mock(args)
+    try:
+        configure_plugin(args)
+        import h5py
+        import numpy as np
+
+        rng = np.random.default_rng(args.seed)
+        data = rng.random(args.shape).astype(args.dtype)
+        rows = []
+
+        mock_call(args, "reset", "POST")
+        started = time.perf_counter()
+        with h5py.File("io_bench.h5", "w") as f:
+            f.create_dataset("x", data=data, chunks=tuple(args.chunks))
+        rows.append(
+            summarize("write", time.perf_counter() - started, data.nbytes,
+                      mock_call(args, "stats"))
+        )  # fmt: skip
+
+        with h5py.File("io_bench.h5", "r") as f:
+            dset = f["x"]
+            for name, sels in selections(args.shape, args.chunks, args.points, rng):
+                if name not in args.patterns:
+                    continue
+                nbytes = selected_bytes(data, sels)
+                best = None
+                for _ in range(args.repeat):
+                    mock_call(args, "reset", "POST")
+                    started = time.perf_counter()
+                    out = [dset[s] for s in sels]
+                    row = summarize(name, time.perf_counter() - started, nbytes,
+                                    mock_call(args, "stats"))  # fmt: skip
+                    if best is None or row["seconds"] < best["seconds"]:
+                        best = row
+                    if not args.no_verify:
+                        for s, o in zip(sels, out):
+                            if not np.array_equal(data[s], o):
+                                raise SystemExit(f"{name}: data mismatch at {s}")
+                rows.append(best)
+
+        print_table(rows)
+        if args.json:
+            Path(args.json).write_text(json.dumps(rows, indent=2))
+    finally:
+        proc.terminate()
+        proc.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,285 @@
+"""
+In-memory S3 stand-in for benchmarking ArrayMorph without a cloud account.
+
+Speaks the subset of the path-style S3 REST API the plugin uses (GET with an
+optional single byte range, PUT, HEAD, DELETE) and shapes every response:
+
+  --latency-ms       fixed time to first byte per request
+  --jitter-ms        extra uniformly random delay in [0, jitter]
+  --bandwidth-mbps   per-request transfer rate cap (MiB/s, 0 = unlimited)
+  --total-mbps       aggregate cap shared by all requests (MiB/s, 0 = off)
+  --throttle         probability of answering 503 SlowDown instead
+
+Objects live in memory and are lost when the process exits. Request counts,
+bytes moved and per-request service times are exposed for the driver:
+
+  GET  /__mock/stats   JSON counters and latency samples (seconds)
+  POST /__mock/reset   clear the counters (objects are kept)
+
+Usage:
+
+    python mock_s3.py --port 9000 --latency-ms 20 --bandwidth-mbps 80
+    export AWS_ENDPOINT_URL_S3=http://127.0.0.1:9000 AWS_S3_ADDRESSING_STYLE=path
+
+Any access key is accepted; signatures are not checked.
+"""
+
+import argparse
+import json
+import random
+import re
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import unquote, urlsplit
+
+ERROR_BODY = (
+    '<?xml version="1.0" encoding="UTF-8"?>'
+    "<Error><Code>{code}</Code><Message>{message}</Message></Error>"
+)
+
+
+class Store:
+    def __init__(self):
+        self.objects = {}
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.counts = {}
+            self.range_gets = 0
+            self.throttled = 0
+            self.bytes_out = 0
+            self.bytes_in = 0
+            self.latencies = []
+
+    def record(self, method, seconds, bytes_out=0, bytes_in=0, ranged=False):
+        with self.lock:
+            self.counts[method] = self.counts.get(method, 0) + 1
+            self.range_gets += ranged
+            self.bytes_out += bytes_out
+            self.bytes_in += bytes_in
+            self.latencies.append(seconds)
+
+    def stats(self):
+        with self.lock:
+            return {
+                "requests": dict(self.counts),
+                "range_gets": self.range_gets,
+                "throttled": self.throttled,
+                "bytes_out": self.bytes_out,
+                "bytes_in": self.bytes_in,
+                "latencies": list(self.latencies),
+            }
+
+
+class Shaper:
+    """Delays a response by latency, jitter and the bandwidth caps."""
+
+    def __init__(self, latency, jitter, bandwidth, total):
+        self.latency = latency
+        self.jitter = jitter
+        self.bandwidth = bandwidth
+        self.total = total
+        self.lock = threading.Lock()
+        self.link_free = 0.0
+
+    def wait(self, nbytes):
+        delay = self.latency + random.uniform(0, self.jitter)
+        if self.bandwidth:
+            delay += nbytes / self.bandwidth
+        done = time.monotonic() + delay
+        if self.total:
+            # serialize transfers on one shared link
+            with self.lock:
+                start = max(time.monotonic(), self.link_free)
+                self.link_free = start + nbytes / self.total
+            done = max(done, self.link_free)
+        time.sleep(max(0.0, done - time.monotonic()))
+
+
+def decode_chunked(raw):
+    """Strip (aws-)chunked framing: <hex size>[;ext]\\r\\n<data>\\r\\n ... 0."""
+    out = bytearray()
+    pos = 0
+    while True:
+        eol = raw.index(b"\r\n", pos)
+        size = int(raw[pos:eol].split(b";")[0], 16)
+        if size == 0:
+            return bytes(out)
+        out += raw[eol + 2 : eol + 2 + size]
+        pos = eol + 2 + size + 2
+
+
+class MockS3Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    store = None
+    shaper = None
+    throttle = 0.0
+
+    def split_path(self):
+        path = unquote(urlsplit(self.path).path).lstrip("/")
+        bucket, _, key = path.partition("/")
+        return bucket, key
+
+    def send_xml_error(self, status, code, message):
+        body = ERROR_BODY.format(code=code, message=message).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/xml")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def throttled(self):
+        if self.throttle and random.random() < self.throttle:
+            with self.store.lock:
+                self.store.throttled += 1
+            self.shaper.wait(0)
+            self.send_xml_error(503, "SlowDown", "Please reduce your request rate.")
+            return True
+        return False
+
+    def read_body(self):
+        if self.headers.get("Transfer-Encoding", "").lower() == "chunked":
+            raw = bytearray()
+            while True:
+                line = self.rfile.readline()
+                raw += line
+                size = int(line.split(b";")[0], 16)
+                raw += self.rfile.read(size + 2)
+                if size == 0:
+                    break
+            body = decode_chunked(bytes(raw))
+        else:
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        encoding = self.headers.get("Content-Encoding", "")
+        sha = self.headers.get("x-amz-content-sha256", "")
+        if "aws-chunked" in encoding or sha.startswith("STREAMING-"):
+            body = decode_chunked(body)
+        return body
+
+    def do_GET(self):
+        started = time.monotonic()
+        if self.path.startswith("/__mock/stats"):
+            body = json.dumps(self.store.stats()).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            return
+        if self.throttled():
+            return
+        bucket, key = self.split_path()
+        data = self.store.objects.get((bucket, key))
+        if data is None:
+            self.shaper.wait(0)
+            self.send_xml_error(404, "NoSuchKey", "The specified key does not exist.")
+            return
+        status, first, last = 200, 0, len(data) - 1
+        match = re.fullmatch(r"bytes=(\d*)-(\d*)", self.headers.get("Range", ""))
+        if match and len(data):
+            lo, hi = match.groups()
+            if lo:
+                first, last = int(lo), min(int(hi), last) if hi else last
+            else:
+                first = max(0, len(data) - int(hi))
+            if first > last:
+                self.shaper.wait(0)
+                self.send_xml_error(416, "InvalidRange", "Range not satisfiable.")
+                return
+            status = 206
+        body = data[first : last + 1]
+        self.shaper.wait(len(body))
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        if status == 206:
+            self.send_header("Content-Range", f"bytes {first}-{last}/{len(data)}")
+        self.end_headers()
+        self.wfile.write(body)
+        self.store.record(
+            "GET", time.monotonic() - started, bytes_out=len(body), ranged=status == 206
+        )
+
+    def do_HEAD(self):
+        started = time.monotonic()
+        bucket, key = self.split_path()
+        data = self.store.objects.get((bucket, key))
+        self.shaper.wait(0)
+        self.send_response(200 if data is not None else 404)
+        self.send_header("Content-Length", str(len(data) if data is not None else 0))
+        self.end_headers()
+        self.store.record("HEAD", time.monotonic() - started)
+
+    def do_PUT(self):
+        started = time.monotonic()
+        body = self.read_body()
+        if self.throttled():
+            return
+        bucket, key = self.split_path()
+        self.shaper.wait(len(body))
+        with self.store.lock:
+            self.store.objects[(bucket, key)] = body
+        self.send_response(200)
+        self.send_header("ETag", '"mock"')
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+        self.store.record("PUT", time.monotonic() - started, bytes_in=len(body))
+
+    def do_DELETE(self):
+        started = time.monotonic()
+        bucket, key = self.split_path()
+        with self.store.lock:
+            self.store.objects.pop((bucket, key), None)
+        self.shaper.wait(0)
+        self.send_response(204)
+        self.end_headers()
+        self.store.record("DELETE", time.monotonic() - started)
+
+    def do_POST(self):
+        if self.path.startswith("/__mock/reset"):
+            self.store.reset()
+            self.send_response(204)
+            self.end_headers()
+            return
+        self.send_xml_error(501, "NotImplemented", "Only GET/PUT/HEAD/DELETE.")
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+class MockS3Server(ThreadingHTTPServer):
+    daemon_threads = True
+    request_queue_size = 1024
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--latency-ms", type=float, default=0.0)
+    parser.add_argument("--jitter-ms", type=float, default=0.0)
+    parser.add_argument("--bandwidth-mbps", type=float, default=0.0)
+    parser.add_argument("--total-mbps", type=float, default=0.0)
+    parser.add_argument("--throttle", type=float, default=0.0)
+    parser.add_argument("--seed", type=int, default=None)
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    MockS3Handler.store = Store()
+    MockS3Handler.shaper = Shaper(
+        args.latency_ms / 1000,
+        args.jitter_ms / 1000,
+        args.bandwidth_mbps * 1024 * 1024,
+        args.total_mbps * 1024 * 1024,
+    )
+    MockS3Handler.throttle = args.throttle
+    server = MockS3Server((args.host, args.port), MockS3Handler)
+    print(f"mock S3 listening on {args.host}:{args.port}", flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
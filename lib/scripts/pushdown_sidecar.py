@@ -0,0 +1,126 @@
+"""
+Reference subsetting executor for ArrayMorph's PUSHDOWN query plan.
+
+The sidecar listens for path-style S3 GETs of the form
+
+    GET /<bucket>/<chunk key>-<data size>-<ndims>-<shape...>-<ranges...>
+
+where the suffix is the description built by `createQuery` in
+`lib/src/core/utils.cc`. It fetches only the byte range of the chunk that
+covers the selection from the real object store, cuts out the selected
+elements and returns them packed in row-major order. Any failure is answered
+with a 5xx so the plugin falls back to a plain GET.
+
+Usage:
+
+    python pushdown_sidecar.py --port 8089
+    export ARRAYMORPH_PUSHDOWN_ENDPOINT=http://localhost:8089
+
+The upstream store is configured with the same variables as the plugin
+(AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY, AWS_REGION, AWS_ENDPOINT_URL_S3).
+Requires boto3.
+"""
+
+import argparse
+import os
+import re
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import unquote
+
+import boto3
+
+
+def parse_query(key):
+    """Split `key` into (chunk key, data size, shape, ranges)."""
+    tokens = key.split("-")
+    # the suffix has 2 + 3 * ndims fields; the chunk key itself may contain '-'
+    for ndims in range(1, 33):
+        n = 2 + 3 * ndims
+        if len(tokens) <= n:
+            break
+        fields = tokens[-n:]
+        if not all(f.isdigit() for f in fields) or int(fields[1]) != ndims:
+            continue
+        chunk_key = "-".join(tokens[:-n])
+        data_size = int(fields[0])
+        shape = [int(f) for f in fields[2 : 2 + ndims]]
+        flat = [int(f) for f in fields[2 + ndims :]]
+        ranges = [(flat[2 * i], flat[2 * i + 1]) for i in range(ndims)]
+        # chunk keys end in "/<chunk index>" and ranges lie inside the chunk
+        if not re.search(r"/\d+$", chunk_key):
+            continue
+        if any(not lo <= hi < s for (lo, hi), s in zip(ranges, shape)):
+            continue
+        return chunk_key, data_size, shape, ranges
+    raise ValueError(f"no subsetting query in key {key!r}")
+
+
+def row_offsets(shape, ranges):
+    """Byte-independent serial offsets of every selected row (calSerialOffsets)."""
+    strides = [1] * len(shape)
+    for i in range(len(shape) - 2, -1, -1):
+        strides[i] = strides[i + 1] * shape[i + 1]
+    offsets = [0]
+    for dim in range(len(shape) - 1):
+        lo, hi = ranges[dim]
+        offsets = [o + j * strides[dim] for o in offsets for j in range(lo, hi + 1)]
+    return [o + ranges[-1][0] for o in offsets]
+
+
+def subset(body, base, data_size, shape, ranges):
+    row_bytes = (ranges[-1][1] - ranges[-1][0] + 1) * data_size
+    out = bytearray()
+    for o in row_offsets(shape, ranges):
+        start = o * data_size - base
+        out += body[start : start + row_bytes]
+    return bytes(out)
+
+
+class PushdownHandler(BaseHTTPRequestHandler):
+    s3 = None
+
+    def do_GET(self):
+        try:
+            bucket, _, key = unquote(self.path.lstrip("/")).partition("/")
+            chunk_key, data_size, shape, ranges = parse_query(key)
+            offsets = row_offsets(shape, ranges)
+            row_bytes = (ranges[-1][1] - ranges[-1][0] + 1) * data_size
+            first = offsets[0] * data_size
+            last = offsets[-1] * data_size + row_bytes - 1
+            obj = self.s3.get_object(
+                Bucket=bucket, Key=chunk_key, Range=f"bytes={first}-{last}"
+            )
+            body = subset(obj["Body"].read(), first, data_size, shape, ranges)
+        except Exception as e:  # the plugin falls back to a plain GET
+            self.send_error(500, str(e))
+            return
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        if os.environ.get("ARRAYMORPH_SIDECAR_VERBOSE"):
+            sys.stderr.write(fmt % args + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8089)
+    args = parser.parse_args()
+
+    PushdownHandler.s3 = boto3.client(
+        "s3",
+        endpoint_url=os.environ.get("AWS_ENDPOINT_URL_S3"),
+        region_name=os.environ.get("AWS_REGION"),
+    )
+    server = ThreadingHTTPServer((args.host, args.port), PushdownHandler)
+    print(f"pushdown sidecar listening on {args.host}:{args.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,92 @@
+#include "arraymorph/core/chunk_cache.h"
+
+uint64_t ChunkCache::reserve(const std::string &key, size_t bytes) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (bytes > capacity || entries.count(key))
+    return 0;
+  evict(bytes);
+  if (used_bytes + bytes > capacity)
+    return 0;
+  uint64_t ticket = next_ticket++;
+  entries.emplace(key, Entry{nullptr, bytes, ticket, lru.end()});
+  used_bytes += bytes;
+  return ticket;
+}
+
+void ChunkCache::fill(const std::string &key, uint64_t ticket, Data data) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = entries.find(key);
+    // erased (or erased and reserved again) while the fetch was running
+    if (it == entries.end() || it->second.ticket != ticket)
+      return;
+    if (!data)
+      drop(it);
+    else {
+      it->second.data = std::move(data);
+      lru.push_front(key);
+      it->second.lru = lru.begin();
+    }
+  }
+  filled.notify_all();
+}
+
+ChunkCache::Data ChunkCache::get(const std::string &key, bool *waited) {
+  std::unique_lock<std::mutex> lock(mtx);
+  if (waited)
+    *waited = false;
+  while (true) {
+    auto it = entries.find(key);
+    if (it == entries.end())
+      return nullptr;
+    if (it->second.data) {
+      lru.splice(lru.begin(), lru, it->second.lru);
+      return it->second.data;
+    }
+    if (waited)
+      *waited = true;
+    filled.wait(lock);
+  }
+}
+
+ChunkCache::Data ChunkCache::peek(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = entries.find(key);
+  if (it == entries.end() || !it->second.data)
+    return nullptr;
+  lru.splice(lru.begin(), lru, it->second.lru);
+  return it->second.data;
+}
+
+bool ChunkCache::contains(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mtx);
+  return entries.count(key) > 0;
+}
+
+void ChunkCache::erase(const std::string &key) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = entries.find(key);
+    if (it == entries.end())
+      return;
+    drop(it);
+  }
+  filled.notify_all();
+}
+
+size_t ChunkCache::used() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return used_bytes;
+}
+
+void ChunkCache::evict(size_t bytes) {
+  while (used_bytes + bytes > capacity && !lru.empty())
+    drop(entries.find(lru.back()));
+}
+
+void ChunkCache::drop(std::unordered_map<std::string, Entry>::iterator it) {
+  used_bytes -= it->second.bytes;
+  if (it->second.data)
+    lru.erase(it->second.lru);
+  entries.erase(it);
+}
@@ -0,0 +1,181 @@
+#include "arraymorph/core/concurrency.h"
+#include "arraymorph/core/logger.h"
+#include "arraymorph/core/tracer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+
+static std::mutex registry_mtx;
+// endpoints live until exit so the references handed out stay valid
+static std::map<std::string, std::unique_ptr<ConcurrencyController>> &
+registry() {
+  static std::map<std::string, std::unique_ptr<ConcurrencyController>>
+      controllers;
+  return controllers;
+}
+
+static size_t envSize(const char *name) {
+  const char *env = getenv(name);
+  return env ? std::strtoull(env, nullptr, 10) : 0;
+}
+
+ConcurrencyController &
+ConcurrencyController::forEndpoint(const std::string &endpoint) {
+  std::lock_guard<std::mutex> lock(registry_mtx);
+  auto &entry = registry()[endpoint];
+  if (!entry)
+    entry.reset(new ConcurrencyController(endpoint));
+  return *entry;
+}
+
+std::string ConcurrencyController::toJson() {
+  std::lock_guard<std::mutex> lock(registry_mtx);
+  std::ostringstream ss;
+  ss << "{";
+  bool first = true;
+  for (auto &[endpoint, c] : registry()) {
+    ss << (first ? "" : ",") << "\"" << endpoint << "\":{\"window\":"
+       << c->window() << ",\"in_flight\":" << c->inFlight()
+       << ",\"throttles\":" << c->throttles.load(std::memory_order_relaxed)
+       << ",\"latency\":" << c->latency() << "}";
+    first = false;
+  }
+  ss << "}";
+  return ss.str();
+}
+
+ConcurrencyController::ConcurrencyController(const std::string &endpoint)
+    : endpoint(endpoint), limit(CONCURRENCY_INITIAL),
+      cwnd(CONCURRENCY_INITIAL), min_window(CONCURRENCY_MIN),
+      max_window(CONCURRENCY_MAX), round_start(Clock::now()),
+      round_target(CONCURRENCY_INITIAL),
+      best_latency(std::numeric_limits<double>::infinity()) {
+  ConcurrencyLimits env;
+  env.initial = envSize("ARRAYMORPH_INITIAL_CONCURRENCY");
+  env.min = envSize("ARRAYMORPH_MIN_CONCURRENCY");
+  env.max = envSize("ARRAYMORPH_MAX_CONCURRENCY");
+  env.fixed = envSize("ARRAYMORPH_CONCURRENCY");
+  configure(env);
+}
+
+void ConcurrencyController::configure(const ConcurrencyLimits &limits) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (limits.min)
+    min_window = limits.min;
+  if (limits.max)
+    max_window = limits.max;
+  max_window = std::max(max_window, min_window);
+  if (limits.fixed) {
+    adaptive = false;
+    min_window = max_window = limits.fixed;
+  }
+  setWindow(limits.initial ? limits.initial : cwnd);
+  Logger::info("------ Concurrency", endpoint, ": window=", window(),
+               "min=", min_window, "max=", max_window,
+               "adaptive=", adaptive);
+}
+
+size_t ConcurrencyController::maxWindow() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return max_window;
+}
+
+bool ConcurrencyController::tryAcquire() {
+  size_t cur = in_flight.load(std::memory_order_relaxed);
+  while (cur < window())
+    if (in_flight.compare_exchange_weak(cur, cur + 1,
+                                        std::memory_order_relaxed))
+      return true;
+  return false;
+}
+
+bool ConcurrencyController::waitAcquire(std::chrono::microseconds timeout) {
+  if (tryAcquire())
+    return true;
+  std::unique_lock<std::mutex> lock(slot_mtx);
+  return slot_freed.wait_for(lock, timeout, [this] { return tryAcquire(); });
+}
+
+// after in_flight dropped; the lock orders the wakeup after a waiter's
+// failed check
+void ConcurrencyController::wake() {
+  { std::lock_guard<std::mutex> lock(slot_mtx); }
+  slot_freed.notify_one();
+}
+
+void ConcurrencyController::acquire() {
+  in_flight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ConcurrencyController::release(uint64_t bytes, double seconds) {
+  // only a window that is at least half used grows, or an application
+  // issuing a few requests at a time would inflate it to the maximum
+  bool saturated =
+      2 * in_flight.fetch_sub(1, std::memory_order_relaxed) >= window();
+  wake();
+  std::lock_guard<std::mutex> lock(mtx);
+  double avg = latency_ewma.load(std::memory_order_relaxed);
+  latency_ewma.store(avg > 0 ? avg + LATENCY_EWMA_WEIGHT * (seconds - avg)
+                             : seconds,
+                     std::memory_order_relaxed);
+  if (!adaptive)
+    return;
+  round_done++;
+  round_bytes += bytes;
+  round_latency += seconds;
+  if (saturated && !round_throttled)
+    setWindow(cwnd + 1.0 / cwnd);
+  if (round_done >= round_target)
+    endRound(Clock::now());
+}
+
+void ConcurrencyController::release() {
+  in_flight.fetch_sub(1, std::memory_order_relaxed);
+  wake();
+}
+
+void ConcurrencyController::throttled() {
+  throttles.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(mtx);
+  // the requests already in flight were sent with the old window; one
+  // decrease per round keeps a burst of 503s from collapsing it
+  if (!adaptive || round_throttled)
+    return;
+  round_throttled = true;
+  setWindow(cwnd / 2);
+  Logger::info("------ Throttled by", endpoint, ", window=", window());
+  if (Tracer::enabled())
+    Tracer::getInstance().instant(
+        "throttled", "concurrency",
+        TraceArgs().add("endpoint", endpoint).add("window",
+                                                  (uint64_t)window()));
+}
+
+void ConcurrencyController::setWindow(double w) {
+  cwnd = std::clamp(w, (double)min_window, (double)max_window);
+  limit.store((size_t)cwnd, std::memory_order_relaxed);
+}
+
+void ConcurrencyController::endRound(Clock::time_point now) {
+  double elapsed = std::chrono::duration<double>(now - round_start).count();
+  double goodput = elapsed > 0 ? round_bytes / elapsed : 0;
+  double latency = round_latency / round_done;
+  // let the baseline drift up slowly so it follows larger objects
+  best_latency = std::min(best_latency * 1.01, latency);
+  if (!round_throttled &&
+      latency > CONCURRENCY_LATENCY_FACTOR * best_latency &&
+      goodput <= last_goodput * 1.05) {
+    setWindow(cwnd * 0.9);
+    Logger::log("------ Queueing at", endpoint, ", window=", window());
+  }
+  last_goodput = goodput;
+  round_start = now;
+  round_target = std::max<size_t>(1, window());
+  round_done = 0;
+  round_bytes = 0;
+  round_latency = 0;
+  round_throttled = false;
+}
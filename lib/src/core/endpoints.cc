@@ -0,0 +1,184 @@
+#include "arraymorph/core/endpoints.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+
+EndpointPool::EndpointPool(
+    std::vector<std::unique_ptr<StorageEndpoint>> endpoints)
+    : endpoints(std::move(endpoints)) {
+  assert(!this->endpoints.empty());
+}
+
+static double latency(const StorageEndpoint *e) {
+  return e->concurrency ? e->concurrency->latency() : 0;
+}
+
+StorageEndpoint *
+EndpointPool::pick(const std::vector<const StorageEndpoint *> &tried) {
+  if (endpoints.size() == 1)
+    return tried.empty() ? endpoints.front().get() : nullptr;
+  std::lock_guard<std::mutex> lock(mtx);
+  auto now = Clock::now();
+  std::vector<StorageEndpoint *> up, down;
+  for (auto &e : endpoints) {
+    if (std::find(tried.begin(), tried.end(), e.get()) != tried.end())
+      continue;
+    (e->retry_at <= now ? up : down).push_back(e.get());
+  }
+  if (up.empty()) {
+    if (down.empty())
+      return nullptr;
+    // every one left is backing off: try the one due back first
+    return *std::min_element(down.begin(), down.end(),
+                             [](StorageEndpoint *a, StorageEndpoint *b) {
+                               return a->retry_at < b->retry_at;
+                             });
+  }
+  // an endpoint not measured yet reports 0 and is tried first
+  std::stable_sort(up.begin(), up.end(),
+                   [](StorageEndpoint *a, StorageEndpoint *b) {
+                     return latency(a) < latency(b);
+                   });
+  if (up.size() > 1 && ++picks % ENDPOINT_PROBE_INTERVAL == 0)
+    return up[1 + probes++ % (up.size() - 1)];
+  return up.front();
+}
+
+void EndpointPool::succeeded(StorageEndpoint &endpoint) {
+  if (endpoints.size() == 1)
+    return;
+  std::lock_guard<std::mutex> lock(mtx);
+  endpoint.failures = 0;
+}
+
+void EndpointPool::failed(StorageEndpoint &endpoint) {
+  if (endpoints.size() == 1)
+    return;
+  std::lock_guard<std::mutex> lock(mtx);
+  endpoint.failures++;
+  long backoff =
+      std::min<long>((long)ENDPOINT_RETRY_MS
+                         << std::min(endpoint.failures - 1, 16),
+                     ENDPOINT_RETRY_MAX_MS);
+  endpoint.retry_at = Clock::now() + std::chrono::milliseconds(backoff);
+  Logger::warn("------ Endpoint", endpoint.name, "failed, skipped for",
+               backoff, "ms");
+}
+
+Result getObject(const StorageEndpoint &endpoint, const std::string &uri) {
+  const CloudClient &client = endpoint.client;
+  const std::string &bucket_name = endpoint.bucket;
+  Result re;
+  if (SP == SPlan::S3) {
+    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+
+    if (!s3_client || !s3_client->get()) {
+      Logger::error("------ No S3 client for", endpoint.name);
+      re.status = ARRAYMORPH_FAIL;
+      return re;
+    }
+    re = Operators::S3Get(s3_client->get(), bucket_name, uri);
+
+  } else if (SP == SPlan::LOCAL_FILE) {
+    auto file_client = std::get_if<std::unique_ptr<FileClient>>(&client);
+    if (!file_client || !file_client->get()) {
+      Logger::error("------ No File client for", endpoint.name);
+      re.status = ARRAYMORPH_FAIL;
+      return re;
+    }
+    re = Operators::FileGet(file_client->get(), bucket_name, uri);
+  } else {
+    auto azure_client =
+        std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
+    if (!azure_client || !azure_client->get()) {
+      Logger::error("------ No Azure client for", endpoint.name);
+      re.status = ARRAYMORPH_FAIL;
+      return re;
+    }
+    re = Operators::AzureGet(azure_client->get(), uri);
+  }
+
+  return re;
+}
+
+Result fetchObject(EndpointPool &endpoints, const std::string &key) {
+  Result re;
+  re.status = ARRAYMORPH_FAIL;
+  // missing only if no replica failed for another reason
+  bool missing = true;
+  std::vector<const StorageEndpoint *> tried;
+  while (StorageEndpoint *endpoint = endpoints.pick(tried)) {
+    re = getObject(*endpoint, key);
+    if (re.status >= 0)
+      return re;
+    missing = missing && re.missing;
+    tried.push_back(endpoint);
+  }
+  re.missing = missing && !tried.empty();
+  return re;
+}
+
+herr_t putObject(const StorageEndpoint &endpoint, const std::string &key,
+                 const std::vector<char> &data) {
+  const CloudClient &client = endpoint.client;
+  const std::string &bucket_name = endpoint.bucket;
+  if (SP == SPlan::S3) {
+    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+
+    if (!s3_client || !s3_client->get()) {
+      Logger::error("------ No S3 client for", endpoint.name);
+      return ARRAYMORPH_FAIL;
+    }
+    Result re{data};
+    return Operators::S3Put(s3_client->get(), bucket_name, key, re);
+  }
+  std::shared_ptr<char> buf(new char[data.size()],
+                            std::default_delete<char[]>());
+  memcpy(buf.get(), data.data(), data.size());
+  if (SP == SPlan::LOCAL_FILE) {
+    auto file_client = std::get_if<std::unique_ptr<FileClient>>(&client);
+    if (!file_client || !file_client->get()) {
+      Logger::error("------ No File client for", endpoint.name);
+      return ARRAYMORPH_FAIL;
+    }
+    return Operators::FilePut(file_client->get(), bucket_name, key, buf,
+                              data.size());
+  }
+  auto azure_client =
+      std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
+  if (!azure_client || !azure_client->get()) {
+    Logger::error("------ No Azure client for", endpoint.name);
+    return ARRAYMORPH_FAIL;
+  }
+  return Operators::AzurePut(azure_client->get(), key, buf, data.size());
+}
+
+herr_t deleteObject(const StorageEndpoint &endpoint, const std::string &key) {
+  const CloudClient &client = endpoint.client;
+  const std::string &bucket_name = endpoint.bucket;
+  if (SP == SPlan::S3) {
+    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+    if (!s3_client || !s3_client->get()) {
+      Logger::error("------ No S3 client for", endpoint.name);
+      return ARRAYMORPH_FAIL;
+    }
+    return Operators::S3Delete(s3_client->get(), bucket_name, key);
+  }
+  if (SP == SPlan::LOCAL_FILE) {
+    auto file_client = std::get_if<std::unique_ptr<FileClient>>(&client);
+    if (!file_client || !file_client->get()) {
+      Logger::error("------ No File client for", endpoint.name);
+      return ARRAYMORPH_FAIL;
+    }
+    return Operators::FileDelete(file_client->get(), bucket_name, key);
+  }
+  auto azure_client =
+      std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
+  if (!azure_client || !azure_client->get()) {
+    Logger::error("------ No Azure client for", endpoint.name);
+    return ARRAYMORPH_FAIL;
+  }
+  return Operators::AzureDelete(azure_client->get(), key);
+}
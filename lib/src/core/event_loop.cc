@@ -0,0 +1,220 @@
+#include "arraymorph/core/event_loop.h"
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <curl/curl.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using LoopClock = std::chrono::steady_clock;
+
+struct HttpEventLoop::Transfer {
+  EventLoopRequest request;
+  EventLoopResponse response;
+  CURL *easy = nullptr;
+  curl_slist *headers = nullptr;
+  size_t uploaded = 0;
+  int attempt = 0;
+  char error[CURL_ERROR_SIZE] = {0};
+
+  ~Transfer() {
+    if (easy)
+      curl_easy_cleanup(easy);
+    curl_slist_free_all(headers);
+  }
+};
+
+struct HttpEventLoop::Loop {
+  CURLM *multi = nullptr;
+  std::thread thread;
+  std::mutex mtx;
+  // submitted, not started yet
+  std::deque<std::unique_ptr<Transfer>> incoming;
+  // the rest is only touched by the loop thread: transfers in flight, and
+  // those waiting out a retry backoff
+  std::unordered_map<CURL *, std::unique_ptr<Transfer>> active;
+  std::multimap<LoopClock::time_point, std::unique_ptr<Transfer>> delayed;
+};
+
+HttpEventLoop *HttpEventLoop::getInstance() {
+  static HttpEventLoop *instance = []() -> HttpEventLoop * {
+    const char *transport = getenv("ARRAYMORPH_TRANSPORT");
+    if (!transport || strcmp(transport, "curl") != 0)
+      return nullptr;
+    size_t loops = EVENT_LOOP_NUM;
+    size_t workers = COMPLETION_THREAD_NUM;
+    if (const char *env = getenv("ARRAYMORPH_EVENT_LOOPS"))
+      loops = std::max(1L, std::strtol(env, nullptr, 10));
+    if (const char *env = getenv("ARRAYMORPH_COMPLETION_THREADS"))
+      workers = std::max(1L, std::strtol(env, nullptr, 10));
+    static HttpEventLoop loop(loops, workers);
+    return &loop;
+  }();
+  return instance;
+}
+
+HttpEventLoop::HttpEventLoop(size_t n, size_t workers)
+    : completions(workers) {
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+  Logger::info("------ Event-loop transport: loops=", n,
+               "completion threads=", workers);
+  for (size_t i = 0; i < n; i++) {
+    loops.push_back(std::make_unique<Loop>());
+    loops.back()->multi = curl_multi_init();
+  }
+  for (auto &loop : loops)
+    loop->thread = std::thread(&HttpEventLoop::run, this, std::ref(*loop));
+}
+
+HttpEventLoop::~HttpEventLoop() {
+  stopping = true;
+  for (auto &loop : loops) {
+    curl_multi_wakeup(loop->multi);
+    loop->thread.join();
+    for (auto &[easy, transfer] : loop->active)
+      curl_multi_remove_handle(loop->multi, easy);
+    loop->active.clear();
+    curl_multi_cleanup(loop->multi);
+  }
+}
+
+void HttpEventLoop::submit(EventLoopRequest &&request) {
+  auto transfer = std::make_unique<Transfer>();
+  transfer->request = std::move(request);
+  Loop &loop = *loops[next.fetch_add(1, std::memory_order_relaxed) %
+                      loops.size()];
+  {
+    std::lock_guard<std::mutex> lock(loop.mtx);
+    loop.incoming.push_back(std::move(transfer));
+  }
+  curl_multi_wakeup(loop.multi);
+}
+
+static size_t onData(char *data, size_t size, size_t n, void *user) {
+  auto &body = *static_cast<std::vector<char> *>(user);
+  body.insert(body.end(), data, data + size * n);
+  return size * n;
+}
+
+void HttpEventLoop::start(Loop &loop, std::unique_ptr<Transfer> transfer) {
+  Transfer *t = transfer.get();
+  const EventLoopRequest &r = t->request;
+  if (!t->easy) {
+    CURL *easy = curl_easy_init();
+    t->easy = easy;
+    curl_easy_setopt(easy, CURLOPT_URL, r.url.c_str());
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, t);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, t->error);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, (long)requestTimeoutMs);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS,
+                     (long)connectTimeoutMs);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, onData);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &t->response.body);
+    if (!r.range.empty())
+      curl_easy_setopt(easy, CURLOPT_RANGE, r.range.c_str());
+    if (r.body) {
+      curl_easy_setopt(easy, CURLOPT_UPLOAD, 1L);
+      curl_easy_setopt(easy, CURLOPT_READFUNCTION, onUpload);
+      curl_easy_setopt(easy, CURLOPT_READDATA, t);
+      curl_easy_setopt(easy, CURLOPT_INFILESIZE_LARGE,
+                       (curl_off_t)r.body_size);
+      // no 100-continue round trip before the body
+      t->headers = curl_slist_append(t->headers, "Expect:");
+      curl_easy_setopt(easy, CURLOPT_HTTPHEADER, t->headers);
+    }
+  }
+  t->response = EventLoopResponse();
+  t->response.body.reserve(r.size_hint);
+  t->uploaded = 0;
+  t->error[0] = '\0';
+  curl_multi_add_handle(loop.multi, t->easy);
+  loop.active.emplace(t->easy, std::move(transfer));
+}
+
+size_t HttpEventLoop::onUpload(char *buf, size_t size, size_t n,
+                               void *user) {
+  auto *t = static_cast<Transfer *>(user);
+  size_t k = std::min(size * n, t->request.body_size - t->uploaded);
+  memcpy(buf, t->request.body.get() + t->uploaded, k);
+  t->uploaded += k;
+  return k;
+}
+
+static bool retryable(int code, long status) {
+  return code != CURLE_OK || status == 429 ||
+         (status >= 500 && status != 501);
+}
+
+void HttpEventLoop::finish(Loop &loop, Transfer *t, int code) {
+  auto node = loop.active.extract(t->easy);
+  std::unique_ptr<Transfer> transfer = std::move(node.mapped());
+  curl_multi_remove_handle(loop.multi, t->easy);
+  if (code == CURLE_OK)
+    curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &t->response.status);
+  else
+    t->response.error =
+        t->error[0] ? t->error : curl_easy_strerror((CURLcode)code);
+  if (retryable(code, t->response.status) && t->attempt < retries &&
+      !stopping) {
+    t->attempt++;
+    if (t->request.retrying)
+      t->request.retrying(t->response, t->attempt);
+    auto backoff = std::chrono::milliseconds(EVENT_LOOP_RETRY_BASE_MS
+                                             << (t->attempt - 1));
+    loop.delayed.emplace(LoopClock::now() + backoff, std::move(transfer));
+    return;
+  }
+  // the connection stays cached in the multi handle for the next request
+  curl_easy_cleanup(t->easy);
+  t->easy = nullptr;
+  std::shared_ptr<Transfer> done(std::move(transfer));
+  completions.submit([done] {
+    done->request.done(std::move(done->response));
+    return ARRAYMORPH_SUCCESS;
+  });
+}
+
+void HttpEventLoop::run(Loop &loop) {
+  while (!stopping) {
+    std::deque<std::unique_ptr<Transfer>> submitted;
+    {
+      std::lock_guard<std::mutex> lock(loop.mtx);
+      submitted.swap(loop.incoming);
+    }
+    for (auto &t : submitted)
+      start(loop, std::move(t));
+    auto now = LoopClock::now();
+    while (!loop.delayed.empty() && loop.delayed.begin()->first <= now) {
+      start(loop, std::move(loop.delayed.begin()->second));
+      loop.delayed.erase(loop.delayed.begin());
+    }
+
+    int running;
+    curl_multi_perform(loop.multi, &running);
+    CURLMsg *msg;
+    int pending;
+    while ((msg = curl_multi_info_read(loop.multi, &pending))) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+      char *t;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &t);
+      finish(loop, reinterpret_cast<Transfer *>(t), msg->data.result);
+    }
+
+    // sleep until a socket is ready, a request is submitted (wakeup) or a
+    // backoff runs out
+    int timeout_ms = 100;
+    if (!loop.delayed.empty())
+      timeout_ms = std::clamp<long>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              loop.delayed.begin()->first - LoopClock::now())
+              .count(),
+          0, timeout_ms);
+    curl_multi_poll(loop.multi, nullptr, 0, timeout_ms, nullptr);
+  }
+}
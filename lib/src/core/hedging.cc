@@ -0,0 +1,57 @@
+#include "arraymorph/core/hedging.h"
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+HedgePolicy &HedgePolicy::getInstance() {
+  static HedgePolicy instance;
+  return instance;
+}
+
+HedgePolicy::HedgePolicy()
+    : percentile(HEDGE_PERCENTILE), budget(HEDGE_BUDGET_PERCENT / 100.0),
+      threshold_ratio(std::numeric_limits<double>::infinity()) {
+  if (const char *env = getenv("ARRAYMORPH_HEDGE_PERCENTILE"))
+    percentile = std::clamp(std::strtod(env, nullptr), 0.0, 99.99);
+  if (const char *env = getenv("ARRAYMORPH_HEDGE_BUDGET"))
+    budget = std::max(0.0, std::strtod(env, nullptr)) / 100.0;
+  window.reserve(HEDGE_WINDOW);
+  Logger::info("------ Hedging: percentile=", percentile,
+               "budget=", budget);
+}
+
+void HedgePolicy::observe(double seconds, double expected) {
+  if (!enabled() || expected <= 0)
+    return;
+  double ratio = seconds / expected;
+  std::lock_guard<std::mutex> lock(mtx);
+  if (window.size() < HEDGE_WINDOW)
+    window.push_back(ratio);
+  else
+    window[next] = ratio;
+  next = (next + 1) % HEDGE_WINDOW;
+  // the percentile moves slowly; recompute it every few samples
+  if (++observed < HEDGE_MIN_SAMPLES || observed % 16 != 0)
+    return;
+  std::vector<double> sorted = window;
+  size_t k = std::min(sorted.size() - 1,
+                      (size_t)(sorted.size() * percentile / 100.0));
+  std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+  threshold_ratio.store(sorted[k], std::memory_order_relaxed);
+}
+
+void HedgePolicy::issued() {
+  if (!enabled())
+    return;
+  std::lock_guard<std::mutex> lock(mtx);
+  tokens = std::min(tokens + budget, HEDGE_MAX_BURST);
+}
+
+bool HedgePolicy::tryHedge() {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (tokens < 1)
+    return false;
+  tokens -= 1;
+  return true;
+}
@@ -0,0 +1,202 @@
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+static const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::TRACE:
+    return "TRACE";
+  case LogLevel::DEBUG:
+    return "DEBUG";
+  case LogLevel::INFO:
+    return "INFO";
+  case LogLevel::WARN:
+    return "WARN";
+  case LogLevel::ERROR:
+    return "ERROR";
+  default:
+    return "";
+  }
+}
+
+// Bounded multi-producer ring (Vyukov): each slot carries a sequence number
+// telling producers whether it is free and the consumer whether it is
+// filled, so pushing is one CAS on the tail and never takes a lock.
+class LogRing {
+public:
+  LogRing() : slots(new Slot[LOG_RING_SIZE]) {
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+      slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(LogLevel level, std::string &&msg) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &slots[pos & (LOG_RING_SIZE - 1)];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->level = level;
+    slot->msg = std::move(msg);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // single consumer: callers hold the sink's drain mutex
+  bool pop(LogLevel &level, std::string &msg) {
+    Slot &slot = slots[head & (LOG_RING_SIZE - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != head + 1)
+      return false;
+    level = slot.level;
+    msg = std::move(slot.msg);
+    slot.seq.store(head + LOG_RING_SIZE, std::memory_order_release);
+    head++;
+    return true;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    LogLevel level;
+    std::string msg;
+  };
+  std::unique_ptr<Slot[]> slots;
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) size_t head = 0;
+};
+
+// Owns the ring and the thread writing it out. Producers do not signal the
+// thread; it polls every few milliseconds, which keeps push wait-free.
+class LogSink {
+public:
+  static LogSink &getInstance() {
+    static LogSink instance;
+    return instance;
+  }
+
+  void push(LogLevel level, std::string &&msg) {
+    if (!ring.push(level, std::move(msg)))
+      dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void drain() {
+    std::lock_guard<std::mutex> lock(drain_mtx);
+    std::string out;
+    LogLevel level;
+    std::string msg;
+    while (ring.pop(level, msg)) {
+      out += "[arraymorph ";
+      out += levelName(level);
+      out += "] ";
+      out += msg;
+      out += '\n';
+    }
+    if (size_t n = dropped.exchange(0, std::memory_order_relaxed))
+      out += "[arraymorph WARN] " + std::to_string(n) +
+             " log messages dropped (ring full)\n";
+    if (!out.empty()) {
+      fwrite(out.data(), 1, out.size(), stderr);
+      fflush(stderr);
+    }
+  }
+
+  ~LogSink() {
+    {
+      std::lock_guard<std::mutex> lock(stop_mtx);
+      stopping = true;
+    }
+    cv.notify_one();
+    if (worker.joinable())
+      worker.join();
+    drain();
+  }
+
+private:
+  LogSink() : worker(&LogSink::run, this) {}
+
+  void run() {
+    std::unique_lock<std::mutex> lock(stop_mtx);
+    while (!stopping) {
+      cv.wait_for(lock, std::chrono::milliseconds(5));
+      lock.unlock();
+      drain();
+      lock.lock();
+    }
+  }
+
+  LogRing ring;
+  std::atomic<size_t> dropped{0};
+  std::mutex drain_mtx;
+  std::mutex stop_mtx;
+  std::condition_variable cv;
+  bool stopping = false;
+  std::thread worker;
+};
+
+static int parseLevel(const char *env) {
+  std::string s(env);
+  std::transform(s.begin(), s.end(), s.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (s == "trace")
+    return static_cast<int>(LogLevel::TRACE);
+  if (s == "debug")
+    return static_cast<int>(LogLevel::DEBUG);
+  if (s == "info")
+    return static_cast<int>(LogLevel::INFO);
+  if (s == "warn" || s == "warning")
+    return static_cast<int>(LogLevel::WARN);
+  if (s == "error")
+    return static_cast<int>(LogLevel::ERROR);
+  if (s == "off" || s == "none")
+    return static_cast<int>(LogLevel::OFF);
+  return -1;
+}
+
+int Logger::initThreshold() {
+  int level = static_cast<int>(LogLevel::WARN);
+  if (const char *env = getenv("ARRAYMORPH_LOG_LEVEL")) {
+    int parsed = parseLevel(env);
+    if (parsed >= 0)
+      level = parsed;
+    else
+      fprintf(stderr, "[arraymorph WARN] unknown ARRAYMORPH_LOG_LEVEL %s\n",
+              env);
+  }
+  int unset = -1;
+  threshold.compare_exchange_strong(unset, level, std::memory_order_relaxed);
+  return threshold.load(std::memory_order_relaxed);
+}
+
+void Logger::setLevel(LogLevel level) {
+  threshold.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+// set once the sink (and its thread) exists, so flush() never creates it
+static std::atomic<bool> sink_started{false};
+
+void Logger::flush() {
+  if (sink_started.load(std::memory_order_acquire))
+    LogSink::getInstance().drain();
+}
+
+void Logger::enqueue(LogLevel level, std::string &&msg) {
+  LogSink::getInstance().push(level, std::move(msg));
+  sink_started.store(true, std::memory_order_release);
+}
@@ -1,102 +1,265 @@
 #include "arraymorph/core/operators.h"
 #include "arraymorph/core/logger.h"
+#include "arraymorph/core/planner.h"
 #include <assert.h>
 #include <time.h>
 #include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
 
 
-CloudClient global_cloud_client;
+std::unique_ptr<Aws::S3::S3Client> pushdown_client;
+ConcurrencyController *pushdown_concurrency = nullptr;
 
 
-OperationTracker& OperationTracker::getInstance() {
-    static OperationTracker instance;
-    return instance;
-}
-
-void OperationTracker::add() {
-    finish.fetch_add(1, std::memory_order_relaxed);
-}
-
-int OperationTracker::get() const {
-    return finish.load(std::memory_order_relaxed);
-}
-
-void OperationTracker::reset() {
-    finish.store(0, std::memory_order_relaxed);
-}
-
 void PutAsyncCallback(const Aws::S3::S3Client* s3Client, 
     const Aws::S3::Model::PutObjectRequest& request, 
     const Aws::S3::Model::PutObjectOutcome& outcome,
     const std::shared_ptr<const Aws::Client::AsyncCallerContext>& context) {
     if (outcome.IsSuccess()) {
-        Logger::log("write async successfully: ", request.GetKey());
-        OperationTracker::getInstance().add();
+        Logger::trace("write async successfully: ", request.GetKey());
     }
     else {
-        Logger::log("write async failed: ", request.GetKey());
+        Logger::error("write async failed: ", request.GetKey());
     }
     const std::shared_ptr<const AsyncWriteInput> input = std::static_pointer_cast<const AsyncWriteInput>(context);
     delete[] input->buf;
 }
 
 
+// time a pooled request spent waiting for a worker
+static void traceQueued(const AsyncReadInput &input,
+                        std::chrono::steady_clock::time_point started) {
+    if (Tracer::enabled())
+        Tracer::getInstance().span("queued", "request", input.issued, started);
+}
+
+void processResponse(const AsyncReadInput &input, const char *data) {
+    TraceSpan span("scatter", "copy");
+    if (span.active)
+        span.args.add("extents", static_cast<uint64_t>(input.mapping.size()));
+    auto start = std::chrono::steady_clock::now();
+    if (input.reducer)
+        input.reducer->consume(data, input.mapping);
+    else
+        for (auto &m: input.mapping)
+            memcpy((char*)input.buf + m[1], data + m[0], m[2]);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    input.statsOrProcess().scatter(elapsed.count());
+}
+
+// a chunk never written reads as the fill value, zero
+static void fillMissing(const AsyncReadInput &input) {
+    if (input.reducer)
+        return;
+    for (auto &m: input.mapping)
+        memset((char*)input.buf + m[1], 0, m[2]);
+}
+
+// bookkeeping of an answered GET, whichever transport carried it. Returns
+// false when another attempt at the same read already answered, so this
+// response must not be scattered.
+static bool acceptResponse(const AsyncReadInput &input, const std::string &key,
+                           const std::string &range, size_t length) {
+    Logger::trace("read async successfully: ", key);
+    auto received = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = received - input.issued;
+    // predicted before this response moves the model
+    double expected = CostModel::getInstance().cost(1, length);
+    CostModel::getInstance().observe(length, elapsed.count());
+    HedgePolicy::getInstance().observe(elapsed.count(), expected);
+    if (input.limiter)
+        input.limiter->release(length, elapsed.count());
+    input.statsOrProcess().request(length, elapsed.count());
+    if (Tracer::enabled())
+        Tracer::getInstance().span(
+            "GET", "request", input.issued, received,
+            TraceArgs()
+                .add("key", key)
+                .add("range", range)
+                .add("bytes", static_cast<uint64_t>(length))
+                .add("lambda", static_cast<uint64_t>(input.lambda))
+                .add("hedge", static_cast<uint64_t>(input.hedge)));
+
+    // another attempt at the same read already answered
+    if (input.state && input.state->done.exchange(true))
+        return false;
+    if (input.hedge)
+        input.statsOrProcess().hedgeWin();
+    return true;
+}
+
+static void finishRead(const AsyncReadInput &input, bool ok) {
+    if (input.batch)
+        input.batch->finish(ok);
+}
+
+// bookkeeping of a failed GET attempt: a pushdown falls back to a plain GET,
+// and the read is finished once its last attempt has failed. A `missing`
+// object is a chunk never written, which reads as the fill value and is no
+// reason to try another replica.
+static void rejectResponse(const AsyncReadInput &input, const std::string &key,
+                           const std::string &range, const std::string &error,
+                           const std::string &message, bool missing) {
+    if (input.limiter)
+        input.limiter->release();
+    if (missing)
+        Logger::trace("GetObject: no chunk", key);
+    else
+        Logger::warn("GetObject:", key, error + ":", message);
+    input.statsOrProcess().failure();
+    if (Tracer::enabled())
+        Tracer::getInstance().span(
+            "GET failed", "request", input.issued,
+            std::chrono::steady_clock::now(),
+            TraceArgs().add("key", key).add("range", range).add("error", error));
+    if (input.lambda == 1) {
+        // the executor sits in front of the store, so the plain GET goes
+        // to the store itself with the whole-object mapping
+        auto fallback = std::make_shared<AsyncReadInput>(input.buf, input.fallback_mapping);
+        fallback->reducer = input.reducer;
+        fallback->stats = input.stats;
+        fallback->state = input.state;
+        fallback->batch = input.batch;
+        fallback->limiter = input.fallback_limiter;
+        if (fallback->limiter)
+            fallback->limiter->acquire();
+        if (input.state)
+            input.state->outstanding.fetch_add(1);
+        input.statsOrProcess().retry();
+        if (Tracer::enabled())
+            Tracer::getInstance().instant(
+                "pushdown fallback", "request",
+                TraceArgs().add("key", input.uri));
+        Operators::S3GetAsync(input.fallback_client, input.bucket_name, input.uri, fallback);
+        Logger::warn("Lambda fails, retry on GET");
+    }
+    // the read is over once its last attempt has failed
+    if (input.state && input.state->outstanding.fetch_sub(1) == 1 &&
+        !input.state->done.exchange(true)) {
+        if (missing)
+            fillMissing(input);
+        finishRead(input, missing);
+    }
+#ifndef PROCESS
+    // for profiling
+    finishRead(input, true);
+#endif
+}
+
 void Operators::GetAsyncCallback(const Aws::S3::S3Client* s3Client, 
     const Aws::S3::Model::GetObjectRequest& request, 
     Aws::S3::Model::GetObjectOutcome outcome,
     const std::shared_ptr<const Aws::Client::AsyncCallerContext>& context) {
     const std::shared_ptr<const AsyncReadInput> input = std::static_pointer_cast<const AsyncReadInput>(context);
     if (outcome.IsSuccess()) {
-        Logger::log("read async successfully: ", request.GetKey());
         auto& file = outcome.GetResultWithOwnership().GetBody();
         file.seekg(0, file.end);
         size_t length = file.tellg();
         file.seekg(0, file.beg);
-      
+        if (!acceptResponse(*input, request.GetKey(), request.GetRange(), length))
+            return;
 #ifdef PROCESS
         if (length < 1024 * 1024 * 1024) {
             char* buf = new char[length];
             file.read(buf, length);
-            // std::stringstream ss;
-            // ss << "object length: " << length << std::endl;
-            for (auto &m: input->mapping) {
-                memcpy((char*)input->buf + m[1], buf + m[0], m[2]);
-                // ss << m[0] << " " << m[1] << " " << m[2] << std::endl;
-            }
-            // std::cout << ss.str();
+            processResponse(*input, buf);
             delete[] buf;
         }
         else {
             for (auto &m: input->mapping) {
                 file.seekg(m[0], file.beg);
-                file.read((char*)input->buf + m[1], m[2]);
+                if (input->reducer) {
+                    std::vector<char> extent(m[2]);
+                    file.read(extent.data(), m[2]);
+                    input->reducer->consume(extent.data(), {{0, 0, m[2]}});
+                }
+                else
+                    file.read((char*)input->buf + m[1], m[2]);
             }
         }
 #endif
-    OperationTracker::getInstance().add();
+        finishRead(*input, true);
     } else {
         auto err = outcome.GetError();
-        std::cerr << request.GetKey() << std::endl;
-        std::cerr << "Error: GetObject: " <<
-            err.GetExceptionName() << ": " << err.GetMessage() << std::endl;
-        if (input->lambda == 1) {
-            S3GetAsync(s3Client, input->bucket_name, input->uri, context);
-            Logger::log("Lambda fails, retry on GET");
-        }
-#ifndef PROCESS
-        // for profiling
-        OperationTracker::getInstance().add();
-#endif
+        rejectResponse(*input, request.GetKey(), request.GetRange(),
+                       err.GetExceptionName(), err.GetMessage(),
+                       err.GetResponseCode() == HttpResponseCode::NOT_FOUND);
     }
-    Logger::log("process async successfully: ", request.GetKey());
+    Logger::trace("process async successfully: ", request.GetKey());
+}
+
+// presigned URLs are signed locally with the client's credentials, region
+// and addressing style; GeneratePresignedUrl is not const
+static std::string presign(const S3Client *client, const std::string &bucket_name,
+                           const std::string &object_name, Aws::Http::HttpMethod method) {
+    return const_cast<S3Client *>(client)->GeneratePresignedUrl(
+        bucket_name, object_name, method, PRESIGN_EXPIRY_S);
+}
+
+// throttles and retries of the event-loop transport, counted as the SDK's
+// CountingRetryStrategy counts its own
+static void loopRetry(ConcurrencyController *limiter, const EventLoopResponse &response,
+                      int attempt) {
+    if (limiter && ConcurrencyController::isThrottle(response.status))
+        limiter->throttled();
+    StatsRegistry::getInstance().process().retry();
+    if (Tracer::enabled())
+        Tracer::getInstance().instant(
+            "retry", "request",
+            TraceArgs()
+                .add("error", response.status ? "HTTP " + std::to_string(response.status)
+                                              : response.error)
+                .add("attempt", static_cast<uint64_t>(attempt)));
 }
 
+herr_t Operators::S3GetEventLoop(const S3Client *client, const std::string &bucket_name,
+                                 const std::string &object_name, const std::string &range,
+                                 size_t size_hint,
+                                 const std::shared_ptr<const AsyncCallerContext> context)
+{
+    Logger::trace("------ S3GetEventLoop ", object_name, range);
+    auto input = std::static_pointer_cast<const AsyncReadInput>(context);
+    EventLoopRequest request;
+    request.url = presign(client, bucket_name, object_name, Aws::Http::HttpMethod::HTTP_GET);
+    request.range = range;
+    request.size_hint = size_hint;
+    request.retrying = [input](const EventLoopResponse &response, int attempt) {
+        loopRetry(input->limiter, response, attempt);
+    };
+    request.done = [input, object_name, range](EventLoopResponse &&response) {
+        if (!response.ok()) {
+            // the last attempt is not reported to `retrying`
+            if (input->limiter && ConcurrencyController::isThrottle(response.status))
+                input->limiter->throttled();
+            if (response.status)
+                rejectResponse(*input, object_name, range, "HTTP " + std::to_string(response.status),
+                               std::string(response.body.begin(), response.body.end()),
+                               response.status == 404);
+            else
+                rejectResponse(*input, object_name, range, "Transfer", response.error, false);
+            return;
+        }
+        if (!acceptResponse(*input, object_name, range, response.body.size()))
+            return;
+#ifdef PROCESS
+        processResponse(*input, response.body.data());
+#endif
+        finishRead(*input, true);
+    };
+    HttpEventLoop::getInstance()->submit(std::move(request));
+    return ARRAYMORPH_SUCCESS;
+}
 
 herr_t Operators::S3GetAsync(const S3Client *client, const std::string& bucket_name, const Aws::String &object_name,
                     const std::shared_ptr<const AsyncCallerContext> input)
 {
-    Logger::log("------ S3getAsync ", object_name);
-    Logger::log("------ S3getAsync ", bucket_name);
+    Logger::trace("------ S3getAsync ", object_name);
+    Logger::trace("------ S3getAsync ", bucket_name);
+    if (HttpEventLoop::getInstance())
+        return S3GetEventLoop(client, bucket_name, object_name, "", 0, input);
     GetObjectRequest request;
     request.SetBucket(bucket_name);
     request.SetKey(object_name);
@@ -117,13 +280,28 @@ herr_t Operators::S3GetAsync(const S3Client *client, const std::string& bucket_n
     return ARRAYMORPH_SUCCESS;
 }
 
+// the key carries the createQuery() description; the executor answers with
+// only the selected elements, packed in row-major order
+herr_t Operators::S3PushdownAsync(const S3Client *client, const std::string& bucket_name, const std::string &object_name,
+                    const std::string &query, const std::shared_ptr<const AsyncCallerContext> input)
+{
+    Logger::trace("------ S3PushdownAsync ", object_name, query);
+    if (HttpEventLoop::getInstance())
+        return S3GetEventLoop(client, bucket_name, object_name + query, "", 0, input);
+    GetObjectRequest request;
+    request.SetBucket(bucket_name);
+    request.SetKey(object_name + query);
+    client->GetObjectAsync(request, GetAsyncCallback, input);
+    return ARRAYMORPH_SUCCESS;
+}
+
 Result Operators::S3Get(const S3Client *client, const std::string& bucket_name, const Aws::String &object_name)
 {
     Result re;
 
 
-    Logger::log("------ S3get ", object_name);
-    Logger::log("bucket_name ", bucket_name);
+    Logger::trace("------ S3get ", object_name);
+    Logger::trace("bucket_name ", bucket_name);
     GetObjectRequest request;
     request.SetBucket(bucket_name);
     request.SetKey(object_name);
@@ -138,14 +316,17 @@ Result Operators::S3Get(const S3Client *client, const std::string& bucket_name,
         file.read(re.data.data(), length);
     } else {
         auto err = outcome.GetError();
-        std::cerr << "Error: GetObject: " <<
-            err.GetExceptionName() << ": " << err.GetMessage() << std::endl;
+        re.status = ARRAYMORPH_FAIL;
+        re.missing = err.GetResponseCode() == HttpResponseCode::NOT_FOUND;
+        if (!re.missing)
+            Logger::error("GetObject:", object_name, err.GetExceptionName() + ":",
+                          err.GetMessage());
     }
     return re;
 }
 
 herr_t Operators::S3Delete(const S3Client *client, const std::string& bucket_name, const Aws::String &object_name) {
-    Logger::log("------ S3Delete ", object_name);
+    Logger::trace("------ S3Delete ", object_name);
     DeleteObjectRequest request;
     request.SetBucket(bucket_name);
     request.SetKey(object_name);
@@ -154,8 +335,8 @@ herr_t Operators::S3Delete(const S3Client *client, const std::string& bucket_nam
     if (!outcome.IsSuccess())
     {
         auto err = outcome.GetError();
-        std::cerr << "Error: DeleteObject: " <<
-            err.GetExceptionName() << ": " << err.GetMessage() << std::endl;
+        Logger::error("DeleteObject:", object_name, err.GetExceptionName() + ":",
+                      err.GetMessage());
         return ARRAYMORPH_FAIL;
     }
     return ARRAYMORPH_SUCCESS;
@@ -183,7 +364,7 @@ herr_t Operators::S3Delete(const S3Client *client, const std::string& bucket_nam
 
 herr_t Operators::S3PutBuf(const S3Client *client, const std::string& bucket_name, const std::string& object_name, std::shared_ptr<char> buf, hsize_t length)
 {
-    Logger::log("------ S3Put ", object_name);
+    Logger::trace("------ S3Put ", object_name);
     PutObjectRequest request;
     request.SetBucket(bucket_name);
     request.SetKey(object_name);
@@ -195,16 +376,65 @@ herr_t Operators::S3PutBuf(const S3Client *client, const std::string& bucket_nam
     auto outcome = client->PutObject(request);
     if (!outcome.IsSuccess()) {
         auto err = outcome.GetError();
-        std::cerr << "ERROR: PutObject: " << object_name << " " << 
-            err.GetExceptionName() << ": " << err.GetMessage() << std::endl;
+        Logger::error("PutObject:", object_name, err.GetExceptionName() + ":",
+                      err.GetMessage());
         return ARRAYMORPH_FAIL;
     }
     return ARRAYMORPH_SUCCESS;
 }
 
+void Operators::S3PutBufAsync(const S3Client *client, const std::string& bucket_name, const std::string& object_name,
+                              std::shared_ptr<char> buf, hsize_t length,
+                              ConcurrencyController *limiter, std::function<void(herr_t)> done)
+{
+    Logger::trace("------ S3PutAsync ", object_name);
+    if (HttpEventLoop::getInstance()) {
+        EventLoopRequest request;
+        request.url = presign(client, bucket_name, object_name, Aws::Http::HttpMethod::HTTP_PUT);
+        request.body = buf;
+        request.body_size = length;
+        request.retrying = [limiter](const EventLoopResponse &response, int attempt) {
+            loopRetry(limiter, response, attempt);
+        };
+        request.done = [object_name, limiter, done](EventLoopResponse &&response) {
+            if (response.ok()) {
+                done(ARRAYMORPH_SUCCESS);
+                return;
+            }
+            if (limiter && ConcurrencyController::isThrottle(response.status))
+                limiter->throttled();
+            Logger::error("PutObject:", object_name,
+                          response.status ? "HTTP " + std::to_string(response.status) : response.error);
+            done(ARRAYMORPH_FAIL);
+        };
+        HttpEventLoop::getInstance()->submit(std::move(request));
+        return;
+    }
+    PutObjectRequest request;
+    request.SetBucket(bucket_name);
+    request.SetKey(object_name);
+
+    auto input_data = Aws::MakeShared<Aws::StringStream>("PutObjectInputStream", std::stringstream::in | std::stringstream::out | std::stringstream::binary);
+    input_data->write(buf.get(), length);
+    request.SetBody(input_data);
+    client->PutObjectAsync(request,
+        [object_name, done](const S3Client *, const PutObjectRequest &,
+                            const PutObjectOutcome &outcome,
+                            const std::shared_ptr<const AsyncCallerContext> &) {
+            if (outcome.IsSuccess()) {
+                done(ARRAYMORPH_SUCCESS);
+                return;
+            }
+            auto err = outcome.GetError();
+            Logger::error("PutObject:", object_name, err.GetExceptionName() + ":",
+                          err.GetMessage());
+            done(ARRAYMORPH_FAIL);
+        });
+}
+
 herr_t Operators::S3Put(const S3Client *client, const std::string& bucket_name, const std::string& object_name, Result &re)
 {
-    Logger::log("------ S3Put ", object_name);
+    Logger::trace("------ S3Put ", object_name);
     PutObjectRequest request;
     request.SetBucket(bucket_name);
     request.SetKey(object_name);
@@ -216,8 +446,8 @@ herr_t Operators::S3Put(const S3Client *client, const std::string& bucket_name,
     auto outcome = client->PutObject(request);
     if (!outcome.IsSuccess()) {
         auto err = outcome.GetError();
-        std::cerr << "ERROR: PutObject: " << object_name << " " << 
-            err.GetExceptionName() << ": " << err.GetMessage() << std::endl;
+        Logger::error("PutObject:", object_name, err.GetExceptionName() + ":",
+                      err.GetMessage());
         return ARRAYMORPH_FAIL;
     }
     return ARRAYMORPH_SUCCESS;
@@ -225,7 +455,7 @@ herr_t Operators::S3Put(const S3Client *client, const std::string& bucket_name,
 
 herr_t Operators::S3PutAsync(const S3Client *client, const std::string& bucket_name, const Aws::String &object_name, Result &re)
 {
-    Logger::log("------ S3PutAsync ", object_name);
+    Logger::trace("------ S3PutAsync ", object_name);
     PutObjectRequest request;
     request.SetBucket(bucket_name);
     request.SetKey(object_name);
@@ -241,46 +471,90 @@ herr_t Operators::S3PutAsync(const S3Client *client, const std::string& bucket_n
 
 // Azure
 
+// the window slot a blocking read holds, given back when it is over
+static void releaseSlot(const AsyncReadInput &input, herr_t status,
+                        size_t bytes) {
+    if (!input.limiter)
+        return;
+    if (status < 0) {
+        input.limiter->release();
+        return;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - input.issued;
+    input.limiter->release(bytes, elapsed.count());
+}
+
+// per-worker response buffer, grown on demand and reused across requests
+static char *scratchBuffer(size_t size) {
+    thread_local std::vector<char> scratch;
+    if (scratch.size() < size)
+        scratch.resize(size);
+    return scratch.data();
+}
+
 Result Operators::AzureGet(const BlobContainerClient *client, const std::string& blob_name)
 {
     Result re;
-    Logger::log("------ AzureGet ", blob_name);
+    Logger::trace("------ AzureGet ", blob_name);
     BlockBlobClient blclient = client->GetBlockBlobClient(blob_name);
-    auto properties = blclient.GetProperties().Value;
-    size_t size = properties.BlobSize;
-    re.data.resize(size);
-    blclient.DownloadTo(reinterpret_cast<uint8_t*>(re.data.data()), size);
+    try {
+        // a single download; the size comes back with the body
+        auto body = blclient.Download().Value.BodyStream->ReadToEnd();
+        re.data.assign(body.begin(), body.end());
+    } catch (const Azure::Core::RequestFailedException &e) {
+        re.status = ARRAYMORPH_FAIL;
+        re.missing = e.StatusCode == Azure::Core::Http::HttpStatusCode::NotFound;
+        if (!re.missing)
+            Logger::error("AzureGet:", blob_name, e.what());
+    }
     return re;
 }
 
 herr_t Operators::AzurePut(const BlobContainerClient *client, const std::string& blob_name, std::shared_ptr<char> buf, size_t length)
 {
-    Logger::log("------ AzurePut ", blob_name);
+    Logger::trace("------ AzurePut ", blob_name);
     BlockBlobClient blclient = client->GetBlockBlobClient(blob_name);
     blclient.UploadFrom((uint8_t*)(buf.get()), length);
     return ARRAYMORPH_SUCCESS;
 }
 
+herr_t Operators::AzureDelete(const BlobContainerClient *client, const std::string& blob_name)
+{
+    Logger::trace("------ AzureDelete ", blob_name);
+    try {
+        client->DeleteBlob(blob_name);
+    } catch (const Azure::Core::RequestFailedException &e) {
+        if (e.StatusCode == Azure::Core::Http::HttpStatusCode::NotFound)
+            return ARRAYMORPH_SUCCESS;
+        Logger::error("AzureDelete:", blob_name, e.what());
+        return ARRAYMORPH_FAIL;
+    }
+    return ARRAYMORPH_SUCCESS;
+}
+
 herr_t Operators::AzureGetAndProcess(const BlobContainerClient *client, const std::string& blob_name, const std::shared_ptr<const AsyncCallerContext> context)
 {
-    Logger::log("------ AzureGet ", blob_name);
+    Logger::trace("------ AzureGet ", blob_name);
     std::shared_ptr<const AsyncReadInput> input = std::static_pointer_cast<const AsyncReadInput>(context);
     BlockBlobClient blclient = client->GetBlockBlobClient(blob_name);
-    auto properties = blclient.GetProperties().Value;
-    size_t size = properties.BlobSize;
-    uint8_t *buf = new uint8_t[size];
-    blclient.DownloadTo(buf, size);
+    try {
+        auto result = blclient.Download().Value;
+        size_t size = result.BlobSize;
+        char *buf = scratchBuffer(size);
+        result.BodyStream->ReadToCount(reinterpret_cast<uint8_t*>(buf), size);
 #ifdef PROCESS
-    for (auto &m: input->mapping) {
-        memcpy((char*)input->buf + m[1], buf + m[0], m[2]);
-    }
+        processResponse(*input, buf);
 #endif
-    delete[] buf;
+    } catch (const Azure::Core::RequestFailedException &e) {
+        Logger::error("AzureGet:", blob_name, e.what());
+        return ARRAYMORPH_FAIL;
+    }
     return ARRAYMORPH_SUCCESS;
 }
 
 herr_t Operators::AzureGetRange(const BlobContainerClient *client, const std::string& blob_name, uint64_t beg, uint64_t end, const std::shared_ptr<const AsyncCallerContext> context) {
-    Logger::log("------ AzureGetRange ", blob_name);
+    Logger::trace("------ AzureGetRange ", blob_name);
     BlockBlobClient blclient = client->GetBlockBlobClient(blob_name);
     
     std::shared_ptr<const AsyncReadInput> input = std::static_pointer_cast<const AsyncReadInput>(context);
@@ -291,13 +565,206 @@ herr_t Operators::AzureGetRange(const BlobContainerClient *client, const std::st
     size_t size = end - beg + 1;
     options.Range.Value().Length = size;
 
-    uint8_t *buf = new uint8_t[size];
-    blclient.DownloadTo(buf, size, options);
-#ifdef PROCESS
-    for (auto &m: input->mapping) {
-        memcpy((char*)input->buf + m[1], buf + m[0], m[2]);
+    // a segment that is one contiguous extent lands in the destination as is
+    bool direct = !input->reducer && input->mapping.size() == 1 &&
+                  input->mapping[0][0] == 0 && input->mapping[0][2] == size;
+    char *buf = direct ? (char*)input->buf + input->mapping[0][1] : scratchBuffer(size);
+    IOStats &stats = input->statsOrProcess();
+    auto started = std::chrono::steady_clock::now();
+    stats.queueWait(std::chrono::duration<double>(started - input->issued).count());
+    traceQueued(*input, started);
+    TraceSpan span("GET", "request");
+    if (span.active)
+        span.args.add("key", blob_name)
+            .add("range", std::to_string(beg) + "-" + std::to_string(end))
+            .add("bytes", static_cast<uint64_t>(size));
+    try {
+        blclient.DownloadTo(reinterpret_cast<uint8_t*>(buf), size, options);
+    } catch (const Azure::Core::RequestFailedException &e) {
+        if (e.StatusCode == Azure::Core::Http::HttpStatusCode::NotFound) {
+            releaseSlot(*input, ARRAYMORPH_FAIL, 0);
+            fillMissing(*input);
+            return ARRAYMORPH_SUCCESS;
+        }
+        releaseSlot(*input, ARRAYMORPH_FAIL, 0);
+        Logger::error("AzureGetRange:", blob_name, e.what());
+        stats.failure();
+        return ARRAYMORPH_FAIL;
     }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - started;
+    CostModel::getInstance().observe(size, elapsed.count());
+    releaseSlot(*input, ARRAYMORPH_SUCCESS, size);
+    stats.request(size, elapsed.count());
+#ifdef PROCESS
+    if (!direct)
+        processResponse(*input, buf);
 #endif
-    delete[] buf;
     return ARRAYMORPH_SUCCESS;
 }
+
+// Local file system
+
+// small extents are cheaper to read as one span and scatter in memory
+const hsize_t FILE_DIRECT_EXTENT = 4096;
+
+static herr_t preadFull(int fd, char *buf, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t n = pread(fd, buf, length, offset);
+        if (n <= 0)
+            return ARRAYMORPH_FAIL;
+        buf += n;
+        length -= n;
+        offset += n;
+    }
+    return ARRAYMORPH_SUCCESS;
+}
+
+static herr_t pwriteFull(int fd, const char *buf, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t n = pwrite(fd, buf, length, offset);
+        if (n <= 0)
+            return ARRAYMORPH_FAIL;
+        buf += n;
+        length -= n;
+        offset += n;
+    }
+    return ARRAYMORPH_SUCCESS;
+}
+
+static int openForWrite(const std::string &path, int flags) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    return open(path.c_str(), O_WRONLY | O_CREAT | flags, 0644);
+}
+
+Result Operators::FileGet(const FileClient *client, const std::string& bucket_name, const std::string& object_name)
+{
+    Result re;
+    Logger::trace("------ FileGet ", object_name);
+    std::string path = client->path(bucket_name, object_name);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        re.status = ARRAYMORPH_FAIL;
+        re.missing = errno == ENOENT;
+        if (!re.missing)
+            Logger::error("FileGet:", path, strerror(errno));
+        return re;
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    re.data.resize(size);
+    if (preadFull(fd, re.data.data(), size, 0) < 0) {
+        Logger::error("FileGet: short read", path);
+        re.data.clear();
+        re.status = ARRAYMORPH_FAIL;
+    }
+    close(fd);
+    return re;
+}
+
+herr_t Operators::FilePut(const FileClient *client, const std::string& bucket_name, const std::string& object_name, std::shared_ptr<char> buf, size_t length)
+{
+    Logger::trace("------ FilePut ", object_name);
+    std::string path = client->path(bucket_name, object_name);
+    int fd = openForWrite(path, O_TRUNC);
+    if (fd < 0) {
+        Logger::error("FilePut:", path, strerror(errno));
+        return ARRAYMORPH_FAIL;
+    }
+    herr_t status = pwriteFull(fd, buf.get(), length, 0);
+    close(fd);
+    return status;
+}
+
+herr_t Operators::FileDelete(const FileClient *client, const std::string& bucket_name, const std::string& object_name)
+{
+    Logger::trace("------ FileDelete ", object_name);
+    std::string path = client->path(bucket_name, object_name);
+    if (unlink(path.c_str()) < 0 && errno != ENOENT) {
+        Logger::error("FileDelete:", path, strerror(errno));
+        return ARRAYMORPH_FAIL;
+    }
+    return ARRAYMORPH_SUCCESS;
+}
+
+herr_t Operators::FileWriteExtents(const FileClient *client, const std::string& bucket_name, const std::string& object_name, size_t object_size, const void *buf, const std::list<std::vector<hsize_t>> &mapping)
+{
+    Logger::trace("------ FileWriteExtents ", object_name);
+    std::string path = client->path(bucket_name, object_name);
+    int fd = openForWrite(path, 0);
+    if (fd < 0) {
+        Logger::error("FileWriteExtents:", path, strerror(errno));
+        return ARRAYMORPH_FAIL;
+    }
+    herr_t status = ARRAYMORPH_SUCCESS;
+    if (lseek(fd, 0, SEEK_END) < (off_t)object_size && ftruncate(fd, object_size) < 0)
+        status = ARRAYMORPH_FAIL;
+    for (auto &m: mapping) {
+        if (status < 0)
+            break;
+        status = pwriteFull(fd, (const char*)buf + m[1], m[2], m[0]);
+    }
+    close(fd);
+    return status;
+}
+
+herr_t Operators::FileGetRange(const FileClient *client, const std::string& bucket_name, const std::string& object_name, uint64_t beg, uint64_t end, const std::shared_ptr<const AsyncCallerContext> context) {
+    Logger::trace("------ FileGetRange ", object_name);
+    std::shared_ptr<const AsyncReadInput> input = std::static_pointer_cast<const AsyncReadInput>(context);
+    IOStats &stats = input->statsOrProcess();
+    auto started = std::chrono::steady_clock::now();
+    stats.queueWait(std::chrono::duration<double>(started - input->issued).count());
+    traceQueued(*input, started);
+    TraceSpan span("GET", "request");
+    if (span.active)
+        span.args.add("key", object_name)
+            .add("range", std::to_string(beg) + "-" + std::to_string(end))
+            .add("bytes", static_cast<uint64_t>(end - beg + 1));
+    std::string path = client->path(bucket_name, object_name);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0 && errno == ENOENT) {
+        // never written, like a 404 on S3
+        Logger::trace("------ FileGetRange: no chunk", path);
+        releaseSlot(*input, ARRAYMORPH_FAIL, 0);
+        fillMissing(*input);
+        return ARRAYMORPH_SUCCESS;
+    }
+    if (fd < 0) {
+        releaseSlot(*input, ARRAYMORPH_FAIL, 0);
+        Logger::error("FileGetRange:", path, strerror(errno));
+        stats.failure();
+        return ARRAYMORPH_FAIL;
+    }
+    size_t size = end - beg + 1;
+    hsize_t required = 0;
+    for (auto &m: input->mapping)
+        required += m[2];
+    herr_t status = ARRAYMORPH_SUCCESS;
+    bool direct = !input->reducer && required >= FILE_DIRECT_EXTENT * input->mapping.size();
+    if (direct) {
+        // large extents go straight into the destination buffer
+        for (auto &m: input->mapping) {
+            status = preadFull(fd, (char*)input->buf + m[1], m[2], beg + m[0]);
+            if (status < 0)
+                break;
+        }
+    }
+    else {
+        char *buf = scratchBuffer(size);
+        status = preadFull(fd, buf, size, beg);
+        if (status >= 0)
+            processResponse(*input, buf);
+    }
+    close(fd);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - started;
+    CostModel::getInstance().observe(size, elapsed.count());
+    releaseSlot(*input, status, size);
+    if (status < 0) {
+        Logger::error("FileGetRange: short read", path);
+        stats.failure();
+    }
+    else
+        stats.request(direct ? required : size, elapsed.count());
+    return status;
+}
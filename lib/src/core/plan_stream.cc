@@ -0,0 +1,68 @@
+#include "arraymorph/core/plan_stream.h"
+#include <algorithm>
+#include <cstdlib>
+
+ThreadPool &PlanStream::pool() {
+  static ThreadPool instance([] {
+    size_t n = PLAN_THREAD_NUM;
+    if (const char *env = getenv("ARRAYMORPH_PLAN_THREADS"))
+      n = std::max(1L, std::strtol(env, nullptr, 10));
+    return n;
+  }());
+  return instance;
+}
+
+PlanStream::PlanStream(size_t count, std::function<bool(size_t)> job)
+    : count(count), job(std::move(job)) {
+  ready.reserve(count);
+  if (count <= PLAN_BATCH) {
+    plan(0, count);
+    return;
+  }
+  // in order, so the chunks at the start of the selection come out first
+  for (size_t beg = 0; beg < count; beg += PLAN_BATCH) {
+    size_t end = std::min(count, beg + PLAN_BATCH);
+    pool().submit([this, beg, end] {
+      plan(beg, end);
+      return ARRAYMORPH_SUCCESS;
+    });
+  }
+}
+
+PlanStream::~PlanStream() { wait(); }
+
+void PlanStream::plan(size_t beg, size_t end) {
+  std::vector<size_t> batch;
+  batch.reserve(end - beg);
+  for (size_t i = beg; i < end; i++)
+    if (job(i))
+      batch.push_back(i);
+  // notified under the lock: once the last batch is in, the stream may be
+  // destroyed as soon as the lock is released
+  std::lock_guard<std::mutex> lock(mtx);
+  ready.insert(ready.end(), batch.begin(), batch.end());
+  planned += end - beg;
+  if (planned == count)
+    finished = Clock::now();
+  cv.notify_all();
+}
+
+bool PlanStream::next(size_t &i) {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [this] { return handed < ready.size() || planned == count; });
+  if (handed == ready.size())
+    return false;
+  i = ready[handed++];
+  return true;
+}
+
+void PlanStream::rewind() {
+  wait();
+  std::lock_guard<std::mutex> lock(mtx);
+  handed = 0;
+}
+
+void PlanStream::wait() {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [this] { return planned == count; });
+}
@@ -0,0 +1,240 @@
+#include "arraymorph/core/planner.h"
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+const double EWMA_ALPHA = 0.1;
+const size_t MAX_RANGES_PER_CHUNK = 64;
+
+CostModel &CostModel::getInstance() {
+  static CostModel instance;
+  return instance;
+}
+
+CostModel::CostModel() {
+  // defaults per platform, measured against a same-region client
+  if (SP == SPlan::AZURE_BLOB) {
+    latency_s = 0.030;
+    bandwidth_bps = 60.0 * 1024 * 1024;
+  } else if (SP == SPlan::LOCAL_FILE) {
+    latency_s = 0.0001;
+    bandwidth_bps = 2048.0 * 1024 * 1024;
+  } else {
+    latency_s = 0.020;
+    bandwidth_bps = 80.0 * 1024 * 1024;
+  }
+  const char *latency_ms = getenv("ARRAYMORPH_LATENCY_MS");
+  if (latency_ms && atof(latency_ms) > 0)
+    latency_s = atof(latency_ms) / 1000.0;
+  const char *bandwidth_mbps = getenv("ARRAYMORPH_BANDWIDTH_MBPS");
+  if (bandwidth_mbps && atof(bandwidth_mbps) > 0)
+    bandwidth_bps = atof(bandwidth_mbps) * 1024 * 1024;
+  pushdown_overhead_s = latency_s;
+  const char *overhead_ms = getenv("ARRAYMORPH_PUSHDOWN_OVERHEAD_MS");
+  if (overhead_ms && atof(overhead_ms) >= 0)
+    pushdown_overhead_s = atof(overhead_ms) / 1000.0;
+  Logger::info("------ Cost model: latency(s)=", latency_s,
+              "bandwidth(B/s)=", bandwidth_bps);
+}
+
+void CostModel::observe(hsize_t bytes, double seconds) {
+  if (seconds <= 0)
+    return;
+  std::lock_guard<std::mutex> lock(mtx);
+  // latency-dominated responses refine the latency, the rest the bandwidth
+  if (bytes <= latency_s * bandwidth_bps) {
+    latency_s = (1 - EWMA_ALPHA) * latency_s + EWMA_ALPHA * seconds;
+  } else {
+    double transfer = std::max(seconds - latency_s, seconds * 0.1);
+    bandwidth_bps =
+        (1 - EWMA_ALPHA) * bandwidth_bps + EWMA_ALPHA * (bytes / transfer);
+  }
+}
+
+double CostModel::latency() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return latency_s;
+}
+
+double CostModel::bandwidth() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return bandwidth_bps;
+}
+
+double CostModel::cost(size_t requests, hsize_t bytes) const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return requests * latency_s + bytes / bandwidth_bps;
+}
+
+hsize_t CostModel::mergeGap() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return (hsize_t)(latency_s * bandwidth_bps);
+}
+
+void CostModel::enablePushdown() {
+  std::lock_guard<std::mutex> lock(mtx);
+  pushdown_enabled = true;
+}
+
+bool CostModel::pushdownEnabled() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return pushdown_enabled;
+}
+
+double CostModel::pushdownCost(hsize_t bytes) const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return latency_s + pushdown_overhead_s + bytes / bandwidth_bps;
+}
+
+PlannerStats &PlannerStats::getInstance() {
+  static PlannerStats instance;
+  return instance;
+}
+
+void PlannerStats::add(QPlan qp, size_t reqs, hsize_t planned,
+                       hsize_t required) {
+  if (qp == QPlan::GET)
+    get_plans.fetch_add(1, std::memory_order_relaxed);
+  else if (qp == QPlan::RANGE)
+    range_plans.fetch_add(1, std::memory_order_relaxed);
+  else if (qp == QPlan::MULTI_RANGE)
+    multi_range_plans.fetch_add(1, std::memory_order_relaxed);
+  else if (qp == QPlan::PUSHDOWN)
+    pushdown_plans.fetch_add(1, std::memory_order_relaxed);
+  requests.fetch_add(reqs, std::memory_order_relaxed);
+  planned_bytes.fetch_add(planned, std::memory_order_relaxed);
+  required_bytes.fetch_add(required, std::memory_order_relaxed);
+}
+
+void PlannerStats::reset() {
+  get_plans.store(0, std::memory_order_relaxed);
+  range_plans.store(0, std::memory_order_relaxed);
+  multi_range_plans.store(0, std::memory_order_relaxed);
+  pushdown_plans.store(0, std::memory_order_relaxed);
+  requests.store(0, std::memory_order_relaxed);
+  planned_bytes.store(0, std::memory_order_relaxed);
+  required_bytes.store(0, std::memory_order_relaxed);
+}
+
+std::string PlannerStats::to_string() const {
+  std::stringstream ss;
+  ss << "GET: " << get_plans.load() << " RANGE: " << range_plans.load()
+     << " MULTI_RANGE: " << multi_range_plans.load()
+     << " PUSHDOWN: " << pushdown_plans.load()
+     << " requests: " << requests.load()
+     << " planned bytes: " << planned_bytes.load()
+     << " required bytes: " << required_bytes.load();
+  return ss.str();
+}
+
+QPlan parseQueryPlan(const std::string &name) {
+  if (name == "GET")
+    return QPlan::GET;
+  if (name == "RANGE")
+    return QPlan::RANGE;
+  if (name == "MULTI_RANGE")
+    return QPlan::MULTI_RANGE;
+  if (name == "PUSHDOWN")
+    return QPlan::PUSHDOWN;
+  return QPlan::NONE;
+}
+
+const char *queryPlanName(QPlan qp) {
+  switch (qp) {
+  case QPlan::GET:
+    return "GET";
+  case QPlan::RANGE:
+    return "RANGE";
+  case QPlan::MULTI_RANGE:
+    return "MULTI_RANGE";
+  case QPlan::PUSHDOWN:
+    return "PUSHDOWN";
+  default:
+    return "NONE";
+  }
+}
+
+// split the mapping wherever the gap between two accessed extents costs more
+// to transfer than issuing a separate request
+static std::vector<std::unique_ptr<Segment>>
+splitRanges(std::list<std::vector<hsize_t>> &mapping, hsize_t merge_gap) {
+  std::vector<std::unique_ptr<Segment>> segments;
+  auto seg_start = mapping.begin();
+  hsize_t seg_end = (*seg_start)[0] + (*seg_start)[2];
+  hsize_t count = 1;
+  for (auto it = std::next(mapping.begin()); it != mapping.end(); ++it) {
+    hsize_t beg = (*it)[0];
+    if (beg > seg_end && beg - seg_end > merge_gap) {
+      segments.emplace_back(std::make_unique<Segment>(seg_start, it, count));
+      seg_start = it;
+      count = 0;
+    }
+    seg_end = std::max(seg_end, beg + (*it)[2]);
+    count++;
+  }
+  segments.emplace_back(
+      std::make_unique<Segment>(seg_start, mapping.end(), count));
+  return segments;
+}
+
+static hsize_t spanBytes(const std::vector<std::unique_ptr<Segment>> &segs) {
+  hsize_t bytes = 0;
+  for (auto &s : segs)
+    bytes += s->end_offset - s->start_offset + 1;
+  return bytes;
+}
+
+QPlan planChunk(std::list<std::vector<hsize_t>> &mapping, hsize_t chunk_size,
+                std::vector<std::unique_ptr<Segment>> &segments) {
+  segments.clear();
+  if (mapping.empty())
+    return QPlan::NONE;
+
+  const CostModel &model = CostModel::getInstance();
+  QPlan qp = SINGLE_PLAN;
+  if (qp == QPlan::PUSHDOWN && !model.pushdownEnabled())
+    qp = QPlan::NONE;
+  std::vector<std::unique_ptr<Segment>> multi;
+  if (qp == QPlan::NONE || qp == QPlan::MULTI_RANGE)
+    multi = splitRanges(mapping, model.mergeGap());
+
+  if (qp == QPlan::NONE) {
+    auto first = mapping.begin();
+    auto last = std::prev(mapping.end());
+    hsize_t span = (*last)[0] + (*last)[2] - (*first)[0];
+    double get_cost = model.cost(1, chunk_size);
+    double range_cost = model.cost(1, span);
+    double multi_cost = model.cost(multi.size(), spanBytes(multi));
+    // prefer fewer requests on ties: a whole object is easier to reuse
+    qp = QPlan::GET;
+    double best = get_cost;
+    if (range_cost < best) {
+      qp = QPlan::RANGE;
+      best = range_cost;
+    }
+    if (multi.size() > 1 && multi.size() <= MAX_RANGES_PER_CHUNK &&
+        multi_cost < best) {
+      qp = QPlan::MULTI_RANGE;
+      best = multi_cost;
+    }
+    if (model.pushdownEnabled()) {
+      hsize_t required = 0;
+      for (auto &m : mapping)
+        required += m[2];
+      if (model.pushdownCost(required) < best)
+        qp = QPlan::PUSHDOWN;
+    }
+  }
+
+  if (qp == QPlan::GET) {
+    segments.emplace_back(std::make_unique<Segment>(
+        0, chunk_size - 1, mapping.begin(), mapping.end(), mapping.size()));
+  } else if (qp == QPlan::RANGE || qp == QPlan::PUSHDOWN) {
+    segments.emplace_back(std::make_unique<Segment>(
+        mapping.begin(), mapping.end(), mapping.size()));
+  } else {
+    segments = std::move(multi);
+  }
+  return qp;
+}
@@ -0,0 +1,140 @@
+#include "arraymorph/core/reducer.h"
+#include <algorithm>
+#include <cstring>
+
+void ReduceResult::combine(const ReduceResult &other) {
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  count += other.count;
+}
+
+Reducer::Reducer(hid_t dtype) : data_size(H5Tget_size(dtype)) {
+  const std::pair<hid_t, ElementType> types[] = {
+      {H5T_NATIVE_SCHAR, INT8},   {H5T_NATIVE_SHORT, INT16},
+      {H5T_NATIVE_INT, INT32},    {H5T_NATIVE_LLONG, INT64},
+      {H5T_NATIVE_UCHAR, UINT8},  {H5T_NATIVE_USHORT, UINT16},
+      {H5T_NATIVE_UINT, UINT32},  {H5T_NATIVE_ULLONG, UINT64},
+      {H5T_NATIVE_FLOAT, FLOAT},  {H5T_NATIVE_DOUBLE, DOUBLE}};
+  type = UNSUPPORTED;
+  for (auto &t : types) {
+    if (H5Tequal(t.first, dtype) > 0) {
+      type = t.second;
+      break;
+    }
+  }
+  // CHAR/LONG alias one of the fixed-width types above
+  if (type == UNSUPPORTED && H5Tget_class(dtype) == H5T_INTEGER) {
+    bool is_signed = H5Tget_sign(dtype) == H5T_SGN_2;
+    switch (data_size) {
+    case 1:
+      type = is_signed ? INT8 : UINT8;
+      break;
+    case 2:
+      type = is_signed ? INT16 : UINT16;
+      break;
+    case 4:
+      type = is_signed ? INT32 : UINT32;
+      break;
+    case 8:
+      type = is_signed ? INT64 : UINT64;
+      break;
+    }
+  }
+}
+
+// four independent accumulators keep the loop free of a serial dependency so
+// the compiler can vectorize it
+template <typename T>
+static void reduceSpan(const T *p, size_t n, ReduceResult &r) {
+  double s[4] = {0, 0, 0, 0};
+  T lo[4], hi[4];
+  size_t i = 0;
+  if (n >= 4) {
+    for (int k = 0; k < 4; k++)
+      lo[k] = hi[k] = p[k];
+    for (; i + 4 <= n; i += 4) {
+      for (int k = 0; k < 4; k++) {
+        s[k] += (double)p[i + k];
+        lo[k] = std::min(lo[k], p[i + k]);
+        hi[k] = std::max(hi[k], p[i + k]);
+      }
+    }
+    for (int k = 0; k < 4; k++) {
+      r.min = std::min(r.min, (double)lo[k]);
+      r.max = std::max(r.max, (double)hi[k]);
+    }
+  }
+  for (; i < n; i++) {
+    s[0] += (double)p[i];
+    r.min = std::min(r.min, (double)p[i]);
+    r.max = std::max(r.max, (double)p[i]);
+  }
+  r.sum += s[0] + s[1] + s[2] + s[3];
+  r.count += n;
+}
+
+template <typename T>
+static void reduceBytes(const char *data, hsize_t length, ReduceResult &r) {
+  size_t n = length / sizeof(T);
+  if (reinterpret_cast<uintptr_t>(data) % alignof(T) == 0) {
+    reduceSpan(reinterpret_cast<const T *>(data), n, r);
+    return;
+  }
+  // unaligned extents are staged through a small aligned block
+  T block[1024];
+  for (size_t i = 0; i < n; i += 1024) {
+    size_t m = std::min<size_t>(1024, n - i);
+    memcpy(block, data + i * sizeof(T), m * sizeof(T));
+    reduceSpan(block, m, r);
+  }
+}
+
+void Reducer::consume(const char *data,
+                      const std::vector<std::vector<hsize_t>> &mapping) {
+  ReduceResult partial;
+  for (auto &m : mapping) {
+    const char *p = data + m[0];
+    switch (type) {
+    case INT8:
+      reduceBytes<int8_t>(p, m[2], partial);
+      break;
+    case INT16:
+      reduceBytes<int16_t>(p, m[2], partial);
+      break;
+    case INT32:
+      reduceBytes<int32_t>(p, m[2], partial);
+      break;
+    case INT64:
+      reduceBytes<int64_t>(p, m[2], partial);
+      break;
+    case UINT8:
+      reduceBytes<uint8_t>(p, m[2], partial);
+      break;
+    case UINT16:
+      reduceBytes<uint16_t>(p, m[2], partial);
+      break;
+    case UINT32:
+      reduceBytes<uint32_t>(p, m[2], partial);
+      break;
+    case UINT64:
+      reduceBytes<uint64_t>(p, m[2], partial);
+      break;
+    case FLOAT:
+      reduceBytes<float>(p, m[2], partial);
+      break;
+    case DOUBLE:
+      reduceBytes<double>(p, m[2], partial);
+      break;
+    default:
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  total.combine(partial);
+}
+
+ReduceResult Reducer::result() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return total;
+}
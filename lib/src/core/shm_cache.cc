@@ -0,0 +1,299 @@
+#include "arraymorph/core/shm_cache.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory needs address-free atomics");
+
+static const uint64_t SHM_MAGIC = 0x6d726f6879617261; // "arayhrom"
+static const uint32_t SHM_VERSION = 1;
+// a slot's state word: published, claimed by a writer, and the number of
+// readers holding it
+static const uint32_t VALID = 1u << 31;
+static const uint32_t BUSY = 1u << 30;
+static const uint32_t REFS = BUSY - 1;
+
+struct SharedChunkCache::Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t slot_num;
+  uint64_t slot_bytes;
+  uint64_t size;
+  // set by the creator once the geometry above is written
+  std::atomic<uint32_t> ready;
+};
+
+struct SharedChunkCache::Slot {
+  std::atomic<uint32_t> state;
+  // hash of the key, 0 for none; lets lookups skip other keys unclaimed
+  std::atomic<uint64_t> tag;
+  // last use, on the node's monotonic clock
+  std::atomic<int64_t> used_ns;
+  // written while BUSY, read while holding a reference
+  uint64_t length;
+  uint32_t key_length;
+  char key[SHM_CACHE_KEY_MAX];
+};
+
+static size_t align(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+static int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// FNV-1a: the same in every process, unlike std::hash
+static uint64_t hashKey(const std::string &key) {
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : key) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h | 1;
+}
+
+SharedChunkCache *SharedChunkCache::getInstance() {
+  static SharedChunkCache *instance = []() -> SharedChunkCache * {
+    size_t mb = SHM_CACHE_MB;
+    if (const char *env = getenv("ARRAYMORPH_SHM_CACHE_MB"))
+      mb = std::strtoull(env, nullptr, 10);
+    if (mb == 0)
+      return nullptr;
+    size_t slot_kb = SHM_CACHE_SLOT_KB;
+    if (const char *env = getenv("ARRAYMORPH_SHM_CACHE_SLOT_KB"))
+      slot_kb = std::max(1ULL, std::strtoull(env, nullptr, 10));
+    std::string name = "/arraymorph-" + std::to_string(getuid());
+    if (const char *env = getenv("ARRAYMORPH_SHM_CACHE_NAME"))
+      name = env[0] == '/' ? env : "/" + std::string(env);
+    return map(name, mb << 20, slot_kb << 10);
+  }();
+  return instance;
+}
+
+SharedChunkCache *SharedChunkCache::map(const std::string &name, size_t size,
+                                        size_t slot_bytes) {
+  size_t slot_num = size / slot_bytes;
+  if (slot_num < SHM_CACHE_WAYS) {
+    Logger::warn("------ Shared chunk cache smaller than", SHM_CACHE_WAYS,
+                 "slots, disabled");
+    return nullptr;
+  }
+  size_t data_offset =
+      align(align(sizeof(Header), 64) + slot_num * sizeof(Slot), 4096);
+  size_t total = data_offset + slot_num * slot_bytes;
+
+  // the first process creates and sizes the segment; the others wait until
+  // it is ready and take its geometry, whatever they were configured with
+  bool created = true;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    created = false;
+    fd = shm_open(name.c_str(), O_RDWR, 0600);
+  }
+  if (fd < 0) {
+    Logger::warn("------ Cannot open shared chunk cache", name,
+                 strerror(errno));
+    return nullptr;
+  }
+  if (created && ftruncate(fd, total) < 0) {
+    Logger::warn("------ Cannot size shared chunk cache", name,
+                 strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  struct stat st;
+  for (int i = 0; !created && i < 1000; i++) {
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header))
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (!created) {
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Header)) {
+      Logger::warn("------ Shared chunk cache not initialized", name);
+      close(fd);
+      return nullptr;
+    }
+    total = st.st_size;
+  }
+  void *base =
+      mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    Logger::warn("------ Cannot map shared chunk cache", name,
+                 strerror(errno));
+    return nullptr;
+  }
+  Header *header = (Header *)base;
+  if (created) {
+    // ftruncate zero-fills: every slot starts free
+    header->magic = SHM_MAGIC;
+    header->version = SHM_VERSION;
+    header->slot_num = slot_num;
+    header->slot_bytes = slot_bytes;
+    header->size = total;
+    header->ready.store(1, std::memory_order_release);
+  } else {
+    for (int i = 0; i < 1000 && !header->ready.load(std::memory_order_acquire);
+         i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (!header->ready.load(std::memory_order_acquire) ||
+        header->magic != SHM_MAGIC || header->version != SHM_VERSION ||
+        header->size != total) {
+      Logger::warn("------ Incompatible shared chunk cache", name);
+      munmap(base, total);
+      return nullptr;
+    }
+  }
+  Logger::info("------ Shared chunk cache", name, ":", header->slot_num,
+               "slots of", header->slot_bytes, "bytes");
+  static SharedChunkCache cache(base, total);
+  return &cache;
+}
+
+SharedChunkCache::SharedChunkCache(void *base, size_t size)
+    : base(base), size(size), header((Header *)base),
+      slots((Slot *)((char *)base + align(sizeof(Header), 64))) {
+  data = (char *)base +
+         align(align(sizeof(Header), 64) + header->slot_num * sizeof(Slot),
+               4096);
+}
+
+SharedChunkCache::~SharedChunkCache() { munmap(base, size); }
+
+size_t SharedChunkCache::slotBytes() const { return header->slot_bytes; }
+
+SharedChunkCache::Slot &SharedChunkCache::slot(uint64_t tag, int way) {
+  return slots[(tag + way) % header->slot_num];
+}
+
+char *SharedChunkCache::slotData(const Slot &s) {
+  return data + (&s - slots) * header->slot_bytes;
+}
+
+bool SharedChunkCache::acquire(Slot &s) {
+  uint32_t st = s.state.load(std::memory_order_acquire);
+  if (!(st & VALID) || (st & BUSY))
+    return false;
+  // marked used before the reference is taken: a writer that sees the
+  // reference also sees the slot in use, so it is not reclaimed as stale
+  s.used_ns.store(nowNs(), std::memory_order_relaxed);
+  while ((st & VALID) && !(st & BUSY))
+    if (s.state.compare_exchange_weak(st, st + 1, std::memory_order_acq_rel))
+      return true;
+  return false;
+}
+
+void SharedChunkCache::release(Slot &s) {
+  // a slot reclaimed from a reader presumed dead has no references left
+  uint32_t st = s.state.load(std::memory_order_relaxed);
+  while ((st & REFS) && !(st & BUSY))
+    if (s.state.compare_exchange_weak(st, st - 1, std::memory_order_release))
+      return;
+}
+
+bool SharedChunkCache::read(const std::string &key, size_t bytes,
+                            const std::function<void(const char *)> &use) {
+  uint64_t tag = hashKey(key);
+  for (int way = 0; way < SHM_CACHE_WAYS; way++) {
+    Slot &s = slot(tag, way);
+    if (s.tag.load(std::memory_order_relaxed) != tag || !acquire(s))
+      continue;
+    // the slot may have been reused between the tag check and the claim
+    bool match = s.tag.load(std::memory_order_relaxed) == tag &&
+                 s.length == bytes && s.key_length == key.size() &&
+                 memcmp(s.key, key.data(), key.size()) == 0;
+    if (match)
+      use(slotData(s));
+    release(s);
+    if (match)
+      return true;
+  }
+  return false;
+}
+
+bool SharedChunkCache::contains(const std::string &key) {
+  uint64_t tag = hashKey(key);
+  for (int way = 0; way < SHM_CACHE_WAYS; way++) {
+    Slot &s = slot(tag, way);
+    if (s.tag.load(std::memory_order_relaxed) == tag &&
+        (s.state.load(std::memory_order_acquire) & VALID))
+      return true;
+  }
+  return false;
+}
+
+bool SharedChunkCache::put(const std::string &key, const char *bytes,
+                           size_t length) {
+  if (length > header->slot_bytes || key.size() > SHM_CACHE_KEY_MAX)
+    return false;
+  uint64_t tag = hashKey(key);
+  int64_t now = nowNs();
+  int64_t stale_ns = (int64_t)SHM_CACHE_STALE_S * 1000000000;
+  // a free slot, else the least recently used published one nobody reads,
+  // else one claimed for longer than any live process would hold it
+  Slot *victim = nullptr;
+  uint32_t victim_state = 0;
+  int victim_rank = 3;
+  int64_t victim_used = 0;
+  for (int way = 0; way < SHM_CACHE_WAYS; way++) {
+    Slot &s = slot(tag, way);
+    uint32_t st = s.state.load(std::memory_order_acquire);
+    int64_t used = s.used_ns.load(std::memory_order_relaxed);
+    if ((st & VALID) && s.tag.load(std::memory_order_relaxed) == tag)
+      return false;
+    int rank;
+    if (st == 0)
+      rank = 0;
+    else if (st == VALID)
+      rank = 1;
+    else if (now - used > stale_ns)
+      rank = 2;
+    else
+      continue;
+    if (rank < victim_rank || (rank == victim_rank && used < victim_used)) {
+      victim = &s;
+      victim_state = st;
+      victim_rank = rank;
+      victim_used = used;
+    }
+  }
+  // lost to another writer or a new reader: leave the chunk unshared
+  if (!victim || !victim->state.compare_exchange_strong(
+                     victim_state, BUSY, std::memory_order_acq_rel))
+    return false;
+  victim->used_ns.store(now, std::memory_order_relaxed);
+  victim->tag.store(0, std::memory_order_relaxed);
+  victim->length = length;
+  victim->key_length = key.size();
+  memcpy(victim->key, key.data(), key.size());
+  memcpy(slotData(*victim), bytes, length);
+  victim->tag.store(tag, std::memory_order_relaxed);
+  victim->state.store(VALID, std::memory_order_release);
+  return true;
+}
+
+void SharedChunkCache::erase(const std::string &key) {
+  uint64_t tag = hashKey(key);
+  for (int way = 0; way < SHM_CACHE_WAYS; way++) {
+    Slot &s = slot(tag, way);
+    if (s.tag.load(std::memory_order_relaxed) != tag)
+      continue;
+    // unpublish; the slot becomes free when its last reader releases it
+    uint32_t st = s.state.load(std::memory_order_acquire);
+    while ((st & VALID) && !(st & BUSY))
+      if (s.state.compare_exchange_weak(st, st & ~VALID,
+                                        std::memory_order_acq_rel))
+        break;
+  }
+}
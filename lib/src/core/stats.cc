@@ -0,0 +1,231 @@
+#include "arraymorph/core/stats.h"
+#include "arraymorph/core/concurrency.h"
+#include "arraymorph/core/planner.h"
+#include <cmath>
+#include <sstream>
+
+void LatencyHistogram::record(double seconds) {
+  if (seconds < 0)
+    seconds = 0;
+  uint64_t us = (uint64_t)(seconds * 1e6);
+  int b = 0;
+  while (us && b < BUCKETS - 1) {
+    us >>= 1;
+    b++;
+  }
+  buckets[b].fetch_add(1, std::memory_order_relaxed);
+  total_ns.fetch_add((uint64_t)(seconds * 1e9), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+  for (auto &b : buckets)
+    b.store(0, std::memory_order_relaxed);
+  total_ns.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+  uint64_t n = 0;
+  for (auto &b : buckets)
+    n += b.load(std::memory_order_relaxed);
+  return n;
+}
+
+double LatencyHistogram::mean() const {
+  uint64_t n = count();
+  return n ? total_ns.load(std::memory_order_relaxed) / 1e9 / n : 0;
+}
+
+double LatencyHistogram::percentile(double p) const {
+  uint64_t n = count();
+  if (n == 0)
+    return 0;
+  uint64_t rank = (uint64_t)std::ceil(p * n);
+  uint64_t seen = 0;
+  for (int b = 0; b < BUCKETS; b++) {
+    seen += buckets[b].load(std::memory_order_relaxed);
+    if (seen >= rank)
+      return std::ldexp(1.0, b) / 1e6;
+  }
+  return std::ldexp(1.0, BUCKETS - 1) / 1e6;
+}
+
+std::string LatencyHistogram::toJson() const {
+  std::ostringstream ss;
+  ss << "{\"count\":" << count() << ",\"mean\":" << mean()
+     << ",\"p50\":" << percentile(0.5) << ",\"p90\":" << percentile(0.9)
+     << ",\"p99\":" << percentile(0.99) << ",\"buckets_us\":[";
+  for (int b = 0; b < BUCKETS; b++)
+    ss << (b ? "," : "") << buckets[b].load(std::memory_order_relaxed);
+  ss << "]}";
+  return ss.str();
+}
+
+// every update lands on this object and its parent chain (the process)
+
+void IOStats::read(uint64_t required_bytes, double seconds) {
+  for (IOStats *s = this; s; s = s->parent) {
+    s->reads.fetch_add(1, std::memory_order_relaxed);
+    s->bytes_required.fetch_add(required_bytes, std::memory_order_relaxed);
+    s->read_latency.record(seconds);
+  }
+}
+
+void IOStats::write(uint64_t bytes, double seconds) {
+  for (IOStats *s = this; s; s = s->parent) {
+    s->writes.fetch_add(1, std::memory_order_relaxed);
+    s->bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+    s->write_latency.record(seconds);
+  }
+}
+
+void IOStats::request(uint64_t bytes, double seconds) {
+  for (IOStats *s = this; s; s = s->parent) {
+    s->requests.fetch_add(1, std::memory_order_relaxed);
+    s->bytes_transferred.fetch_add(bytes, std::memory_order_relaxed);
+    s->request_latency.record(seconds);
+  }
+}
+
+void IOStats::retry() {
+  for (IOStats *s = this; s; s = s->parent)
+    s->retries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::failure() {
+  for (IOStats *s = this; s; s = s->parent)
+    s->failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::hedge() {
+  for (IOStats *s = this; s; s = s->parent)
+    s->hedges.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::hedgeWin() {
+  for (IOStats *s = this; s; s = s->parent)
+    s->hedge_wins.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::cacheHit(uint64_t bytes) {
+  for (IOStats *s = this; s; s = s->parent) {
+    s->cache_hits.fetch_add(1, std::memory_order_relaxed);
+    s->cache_hit_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+void IOStats::cacheMiss() {
+  for (IOStats *s = this; s; s = s->parent)
+    s->cache_misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::queueWait(double seconds) {
+  for (IOStats *s = this; s; s = s->parent)
+    s->queue_wait.record(seconds);
+}
+
+void IOStats::scatter(double seconds) {
+  for (IOStats *s = this; s; s = s->parent)
+    s->scatter_time.record(seconds);
+}
+
+void IOStats::plan(double seconds) {
+  for (IOStats *s = this; s; s = s->parent)
+    s->planner_time.record(seconds);
+}
+
+void IOStats::reset() {
+  for (auto *c : {&reads, &writes, &requests, &bytes_transferred,
+                  &bytes_required, &bytes_written, &retries, &failures,
+                  &hedges, &hedge_wins, &cache_hits, &cache_misses,
+                  &cache_hit_bytes})
+    c->store(0, std::memory_order_relaxed);
+  for (auto *h : {&read_latency, &write_latency, &request_latency, &queue_wait,
+                  &scatter_time, &planner_time})
+    h->reset();
+}
+
+std::string IOStats::toJson() const {
+  auto get = [](const std::atomic<uint64_t> &c) {
+    return c.load(std::memory_order_relaxed);
+  };
+  uint64_t required = get(bytes_required);
+  std::ostringstream ss;
+  ss << "{\"reads\":" << get(reads) << ",\"writes\":" << get(writes)
+     << ",\"requests\":" << get(requests)
+     << ",\"bytes_transferred\":" << get(bytes_transferred)
+     << ",\"bytes_required\":" << required
+     << ",\"bytes_written\":" << get(bytes_written)
+     << ",\"overfetch_ratio\":"
+     << (required ? (double)get(bytes_transferred) / required : 0)
+     << ",\"retries\":" << get(retries) << ",\"failures\":" << get(failures)
+     << ",\"hedges\":" << get(hedges) << ",\"hedge_wins\":" << get(hedge_wins)
+     << ",\"cache_hits\":" << get(cache_hits)
+     << ",\"cache_misses\":" << get(cache_misses)
+     << ",\"cache_hit_bytes\":" << get(cache_hit_bytes)
+     << ",\"read_latency\":" << read_latency.toJson()
+     << ",\"write_latency\":" << write_latency.toJson()
+     << ",\"request_latency\":" << request_latency.toJson()
+     << ",\"queue_wait\":" << queue_wait.toJson()
+     << ",\"scatter_time\":" << scatter_time.toJson()
+     << ",\"planner_time\":" << planner_time.toJson() << "}";
+  return ss.str();
+}
+
+StatsRegistry &StatsRegistry::getInstance() {
+  static StatsRegistry instance;
+  return instance;
+}
+
+IOStats *StatsRegistry::dataset(const std::string &uri) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto &entry = datasets[uri];
+  if (!entry)
+    entry = std::make_unique<IOStats>(&totals);
+  return entry.get();
+}
+
+void StatsRegistry::reset() {
+  std::lock_guard<std::mutex> lock(mtx);
+  totals.reset();
+  for (auto &[uri, s] : datasets)
+    s->reset();
+  PlannerStats::getInstance().reset();
+}
+
+static std::string quoted(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+std::string StatsRegistry::toJson() const {
+  const PlannerStats &ps = PlannerStats::getInstance();
+  std::ostringstream ss;
+  ss << "{\"process\":" << totals.toJson() << ",\"planner\":{\"get\":"
+     << ps.get_plans << ",\"range\":" << ps.range_plans
+     << ",\"multi_range\":" << ps.multi_range_plans
+     << ",\"pushdown\":" << ps.pushdown_plans
+     << ",\"requests\":" << ps.requests
+     << ",\"planned_bytes\":" << ps.planned_bytes
+     << ",\"required_bytes\":" << ps.required_bytes
+     << "},\"endpoints\":" << ConcurrencyController::toJson()
+     << ",\"datasets\":{";
+  std::lock_guard<std::mutex> lock(mtx);
+  bool first = true;
+  for (auto &[uri, s] : datasets) {
+    ss << (first ? "" : ",") << quoted(uri) << ":" << s->toJson();
+    first = false;
+  }
+  ss << "}}";
+  return ss.str();
+}
+
+std::string StatsRegistry::datasetJson(const std::string &uri) const {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = datasets.find(uri);
+  return it == datasets.end() ? IOStats().toJson() : it->second->toJson();
+}
@@ -0,0 +1,84 @@
+#include "arraymorph/core/thread_pool.h"
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <cstdlib>
+
+ThreadPool &ThreadPool::getInstance() {
+  static ThreadPool instance([] {
+    size_t n = IO_THREAD_NUM;
+    if (const char *env = getenv("ARRAYMORPH_IO_THREADS"))
+      n = std::max(1L, std::strtol(env, nullptr, 10));
+    return n;
+  }());
+  return instance;
+}
+
+ThreadPool::ThreadPool(size_t n)
+    : background_limit(std::max<size_t>(1, n / 2)) {
+  Logger::info("------ Pool threads: ", n);
+  workers.reserve(n);
+  for (size_t i = 0; i < n; i++)
+    workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  for (auto &w : workers)
+    w.join();
+}
+
+std::future<herr_t> ThreadPool::submit(std::function<herr_t()> job) {
+  std::packaged_task<herr_t()> task(std::move(job));
+  auto fut = task.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    jobs.push_back(std::move(task));
+  }
+  cv.notify_one();
+  return fut;
+}
+
+void ThreadPool::submitBackground(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    background.push_back(std::move(job));
+  }
+  cv.notify_one();
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::packaged_task<herr_t()> task;
+    std::function<void()> background_job;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this] {
+        return stopping || !jobs.empty() ||
+               (!background.empty() && background_running < background_limit);
+      });
+      if (!jobs.empty()) {
+        task = std::move(jobs.front());
+        jobs.pop_front();
+      } else if (!stopping && !background.empty()) {
+        background_job = std::move(background.front());
+        background.pop_front();
+        background_running++;
+      } else
+        return;
+    }
+    if (task.valid()) {
+      task();
+      continue;
+    }
+    background_job();
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      background_running--;
+    }
+    cv.notify_one();
+  }
+}
@@ -0,0 +1,185 @@
+#include "arraymorph/core/tracer.h"
+#include "arraymorph/core/logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+#ifdef ARRAYMORPH_ENABLE_MPI
+#include <mpi.h>
+#endif
+
+// JSON string escaping for keys and paths in args
+static void appendEscaped(std::string &out, const std::string &s) {
+  out += '"';
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char esc[8];
+        snprintf(esc, sizeof(esc), "\\u%04x", c);
+        out += esc;
+      } else
+        out += c;
+    }
+  }
+  out += '"';
+}
+
+void TraceArgs::key(const char *key) {
+  if (!body.empty())
+    body += ',';
+  body += '"';
+  body += key;
+  body += "\":";
+}
+
+TraceArgs &TraceArgs::add(const char *k, const std::string &value) {
+  key(k);
+  appendEscaped(body, value);
+  return *this;
+}
+
+TraceArgs &TraceArgs::add(const char *k, uint64_t value) {
+  key(k);
+  body += std::to_string(value);
+  return *this;
+}
+
+TraceArgs &TraceArgs::add(const char *k, double value) {
+  key(k);
+  char num[32];
+  snprintf(num, sizeof(num), "%.9g", value);
+  body += num;
+  return *this;
+}
+
+int Tracer::initState() {
+  const char *env = getenv("ARRAYMORPH_TRACE");
+  int on = env && *env ? 1 : 0;
+  // start the clock before the first span does
+  if (on)
+    getInstance();
+  int unset = -1;
+  state.compare_exchange_strong(unset, on, std::memory_order_relaxed);
+  return state.load(std::memory_order_relaxed);
+}
+
+Tracer &Tracer::getInstance() {
+  static Tracer instance;
+  return instance;
+}
+
+Tracer::Tracer() : epoch(TraceClock::now()) {
+  if (const char *env = getenv("ARRAYMORPH_TRACE"))
+    path = env;
+  Logger::info("------ Tracing to ", path);
+}
+
+Tracer::~Tracer() { flush(); }
+
+uint32_t Tracer::threadId() {
+  static std::atomic<uint32_t> next{1};
+  thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+int64_t Tracer::micros(TraceClock::time_point t) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(t - epoch)
+      .count();
+}
+
+void Tracer::record(Event &&e) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (events.size() >= TRACE_MAX_EVENTS) {
+    dropped++;
+    return;
+  }
+  events.push_back(std::move(e));
+}
+
+void Tracer::span(const char *name, const char *cat,
+                  TraceClock::time_point start, TraceClock::time_point end,
+                  const TraceArgs &args) {
+  record({name, cat, 'X', micros(start), micros(end) - micros(start),
+          threadId(), args.str()});
+}
+
+void Tracer::instant(const char *name, const char *cat,
+                     const TraceArgs &args) {
+  record({name, cat, 'i', micros(TraceClock::now()), 0, threadId(),
+          args.str()});
+}
+
+// the trace of this process: ARRAYMORPH_TRACE with the MPI rank, or the
+// pid outside MPI, before the extension, so processes sharing the variable
+// do not overwrite each other
+std::string Tracer::output() {
+#ifdef ARRAYMORPH_ENABLE_MPI
+  int initialized = 0, finalized = 0;
+  MPI_Initialized(&initialized);
+  MPI_Finalized(&finalized);
+  if (initialized && !finalized)
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+  std::string tag = rank >= 0 ? "rank" + std::to_string(rank)
+                              : "pid" + std::to_string(getpid());
+  size_t slash = path.rfind('/');
+  size_t dot = path.rfind('.');
+  if (dot == std::string::npos || dot == 0 ||
+      (slash != std::string::npos && dot <= slash + 1))
+    return path + "." + tag;
+  return path.substr(0, dot) + "." + tag + path.substr(dot);
+}
+
+void Tracer::flush() {
+  if (path.empty())
+    return;
+  std::lock_guard<std::mutex> lock(mtx);
+  std::string name = output();
+  // flushed under the pid before MPI started: the rank's file replaces it
+  if (!written.empty() && written != name)
+    remove(written.c_str());
+  written = name;
+  std::string pid = std::to_string(getpid());
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid +
+         ",\"tid\":0,\"args\":{\"name\":\"arraymorph\"}}";
+  for (auto &e : events) {
+    out += ",\n{\"name\":\"";
+    out += e.name;
+    out += "\",\"cat\":\"";
+    out += e.cat;
+    out += "\",\"ph\":\"";
+    out += e.ph;
+    out += "\",\"ts\":" + std::to_string(e.ts_us);
+    if (e.ph == 'X')
+      out += ",\"dur\":" + std::to_string(e.dur_us);
+    else
+      out += ",\"s\":\"t\"";
+    out += ",\"pid\":" + pid + ",\"tid\":" + std::to_string(e.tid);
+    out += ",\"args\":{" + e.args + "}}";
+  }
+  out += "\n],\"otherData\":{\"dropped_events\":" + std::to_string(dropped) +
+         "}}\n";
+  // write-then-rename so a viewer never sees a half-written file
+  std::string tmp = name + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    if (!f) {
+      Logger::error("------ Cannot write trace ", name);
+      return;
+    }
+    f.write(out.data(), out.size());
+  }
+  if (rename(tmp.c_str(), name.c_str()) != 0)
+    Logger::error("------ Cannot write trace ", name);
+}
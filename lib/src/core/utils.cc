@@ -124,10 +124,9 @@ generateSegments(std::list<std::vector<hsize_t>> &mapping, hsize_t chunk_size) {
     return segments;
   segments.emplace_back(std::make_unique<Segment>(
       0, chunk_size - 1, mapping.begin(), mapping.end(), mapping.size()));
-#ifdef LOG_ENABLE
-  for (auto const &s : segments)
-    Logger::log(s->to_string());
-#endif
+  if (Logger::enabled(LogLevel::TRACE))
+    for (auto const &s : segments)
+      Logger::trace(s->to_string());
   return segments;
 }
 
@@ -0,0 +1,222 @@
+#include "arraymorph/s3vl/attribute_callbacks.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include "arraymorph/s3vl/dataset_callbacks.h"
+#include "arraymorph/s3vl/dataset_obj.h"
+#include <algorithm>
+#include <cstring>
+
+// the dataset whose attributes `loc_params` refers to, null for files and
+// groups
+static S3VLDatasetObj *owner(void *obj, const H5VL_loc_params_t *loc_params) {
+  if (loc_params->obj_type != H5I_DATASET)
+    return nullptr;
+  if (loc_params->type == H5VL_OBJECT_BY_NAME &&
+      strcmp(loc_params->loc_data.loc_by_name.name, ".") != 0)
+    return nullptr;
+  return (S3VLDatasetObj *)obj;
+}
+
+// the attributes of a dataset by name or creation order
+static std::vector<std::shared_ptr<S3VLAttr>>
+ordered(const S3VLDatasetObj *dset_obj, H5_index_t idx_type,
+        H5_iter_order_t order) {
+  auto attrs = dset_obj->attrs;
+  if (idx_type == H5_INDEX_NAME)
+    std::stable_sort(attrs.begin(), attrs.end(),
+                     [](auto &a, auto &b) { return a->name < b->name; });
+  if (order == H5_ITER_DEC)
+    std::reverse(attrs.begin(), attrs.end());
+  return attrs;
+}
+
+// the attribute `loc_params` and `name` refer to on a dataset
+static std::shared_ptr<S3VLAttr> locate(const S3VLDatasetObj *dset_obj,
+                                        const H5VL_loc_params_t *loc_params,
+                                        const char *name) {
+  if (loc_params->type == H5VL_OBJECT_BY_IDX) {
+    auto &by_idx = loc_params->loc_data.loc_by_idx;
+    auto attrs = ordered(dset_obj, by_idx.idx_type, by_idx.order);
+    return by_idx.n < attrs.size() ? attrs[by_idx.n] : nullptr;
+  }
+  return name ? dset_obj->findAttr(name) : nullptr;
+}
+
+static void fillInfo(const S3VLDatasetObj *dset_obj,
+                     const std::shared_ptr<S3VLAttr> &attr,
+                     H5A_info_t *ainfo) {
+  auto &attrs = dset_obj->attrs;
+  ainfo->corder_valid = true;
+  ainfo->corder = std::find(attrs.begin(), attrs.end(), attr) - attrs.begin();
+  ainfo->cset = H5T_CSET_ASCII;
+  ainfo->data_size = attr->size;
+}
+
+static void *openHandle(S3VLDatasetObj *dset_obj,
+                        std::shared_ptr<S3VLAttr> attr) {
+  dset_obj->open_attrs++;
+  return new S3VLAttrObj{dset_obj, std::move(attr)};
+}
+
+void *S3VLAttrCallbacks::S3VL_attr_create(
+    void *obj, const H5VL_loc_params_t *loc_params, const char *attr_name,
+    hid_t type_id, hid_t space_id, hid_t acpl_id, hid_t aapl_id,
+    hid_t dxpl_id, void **req) {
+  Logger::log("------ Create attribute: ", attr_name);
+  S3VLDatasetObj *dset_obj = owner(obj, loc_params);
+  if (!dset_obj) {
+    Logger::error("------ Attributes are only stored on datasets");
+    return NULL;
+  }
+  auto attr = dset_obj->createAttr(attr_name, type_id, space_id);
+  if (!attr)
+    return NULL;
+  return openHandle(dset_obj, std::move(attr));
+}
+
+void *S3VLAttrCallbacks::S3VL_attr_open(void *obj,
+                                        const H5VL_loc_params_t *loc_params,
+                                        const char *attr_name, hid_t aapl_id,
+                                        hid_t dxpl_id, void **req) {
+  Logger::log("------ Open attribute: ", attr_name ? attr_name : "");
+  S3VLDatasetObj *dset_obj = owner(obj, loc_params);
+  auto attr = dset_obj ? locate(dset_obj, loc_params, attr_name) : nullptr;
+  if (!attr) {
+    Logger::error("------ No attribute", attr_name ? attr_name : "");
+    return NULL;
+  }
+  return openHandle(dset_obj, std::move(attr));
+}
+
+herr_t S3VLAttrCallbacks::S3VL_attr_read(void *attr, hid_t mem_type_id,
+                                         void *buf, hid_t dxpl_id,
+                                         void **req) {
+  S3VLAttrObj *attr_obj = (S3VLAttrObj *)attr;
+  Logger::log("------ Read attribute ", attr_obj->attr->name);
+  if (attr_obj->dset->loadAttr(*attr_obj->attr) < 0)
+    return ARRAYMORPH_FAIL;
+  return attr_obj->attr->read(mem_type_id, buf);
+}
+
+herr_t S3VLAttrCallbacks::S3VL_attr_write(void *attr, hid_t mem_type_id,
+                                          const void *buf, hid_t dxpl_id,
+                                          void **req) {
+  S3VLAttrObj *attr_obj = (S3VLAttrObj *)attr;
+  Logger::log("------ Write attribute ", attr_obj->attr->name);
+  if (attr_obj->attr->write(mem_type_id, buf) < 0)
+    return ARRAYMORPH_FAIL;
+  // uploaded with the metadata, when the dataset is flushed or closed
+  return attr_obj->dset->storeAttr(*attr_obj->attr);
+}
+
+herr_t S3VLAttrCallbacks::S3VL_attr_get(void *obj, H5VL_attr_get_args_t *args,
+                                        hid_t dxpl_id, void **req) {
+  Logger::log("------ Get attribute: ", args->op_type);
+  switch (args->op_type) {
+  case H5VL_attr_get_t::H5VL_ATTR_GET_SPACE:
+    args->args.get_space.space_id = ((S3VLAttrObj *)obj)->attr->space();
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_attr_get_t::H5VL_ATTR_GET_TYPE:
+    args->args.get_type.type_id = H5Tcopy(((S3VLAttrObj *)obj)->attr->type);
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_attr_get_t::H5VL_ATTR_GET_ACPL:
+    args->args.get_acpl.acpl_id = H5Pcreate(H5P_ATTRIBUTE_CREATE);
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_attr_get_t::H5VL_ATTR_GET_STORAGE_SIZE:
+    *args->args.get_storage_size.data_size = ((S3VLAttrObj *)obj)->attr->size;
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_attr_get_t::H5VL_ATTR_GET_NAME: {
+    auto &name_args = args->args.get_name;
+    std::shared_ptr<S3VLAttr> attr;
+    if (name_args.loc_params.type == H5VL_OBJECT_BY_SELF)
+      attr = ((S3VLAttrObj *)obj)->attr;
+    else if (S3VLDatasetObj *dset_obj = owner(obj, &name_args.loc_params))
+      attr = locate(dset_obj, &name_args.loc_params, nullptr);
+    if (!attr)
+      return ARRAYMORPH_FAIL;
+    const std::string &name = attr->name;
+    if (name_args.buf && name_args.buf_size > 0) {
+      size_t n = std::min(name.size(), name_args.buf_size - 1);
+      memcpy(name_args.buf, name.data(), n);
+      name_args.buf[n] = '\0';
+    }
+    if (name_args.attr_name_len)
+      *name_args.attr_name_len = name.size();
+    return ARRAYMORPH_SUCCESS;
+  }
+  case H5VL_attr_get_t::H5VL_ATTR_GET_INFO: {
+    auto &info_args = args->args.get_info;
+    if (info_args.loc_params.type == H5VL_OBJECT_BY_SELF) {
+      S3VLAttrObj *attr_obj = (S3VLAttrObj *)obj;
+      fillInfo(attr_obj->dset, attr_obj->attr, info_args.ainfo);
+      return ARRAYMORPH_SUCCESS;
+    }
+    S3VLDatasetObj *dset_obj = owner(obj, &info_args.loc_params);
+    auto attr = dset_obj ? locate(dset_obj, &info_args.loc_params,
+                                  info_args.attr_name)
+                         : nullptr;
+    if (!attr)
+      return ARRAYMORPH_FAIL;
+    fillInfo(dset_obj, attr, info_args.ainfo);
+    return ARRAYMORPH_SUCCESS;
+  }
+  default:
+    Logger::warn("------ Unsupported attribute get operation");
+    return ARRAYMORPH_FAIL;
+  }
+}
+
+// H5Aiterate: no identifier is registered for the dataset, so `op` gets
+// H5I_INVALID_HID as its location; h5py only uses the names
+static herr_t iterate(S3VLDatasetObj *dset_obj,
+                      const H5VL_attr_iterate_args_t &it) {
+  auto attrs = ordered(dset_obj, it.idx_type, it.order);
+  hsize_t i = it.idx ? *it.idx : 0;
+  herr_t ret = 0;
+  while (i < attrs.size() && ret == 0) {
+    H5A_info_t ainfo;
+    fillInfo(dset_obj, attrs[i], &ainfo);
+    ret = it.op(H5I_INVALID_HID, attrs[i]->name.c_str(), &ainfo, it.op_data);
+    i++;
+  }
+  if (it.idx)
+    *it.idx = i;
+  return ret;
+}
+
+herr_t S3VLAttrCallbacks::S3VL_attr_specific(
+    void *obj, const H5VL_loc_params_t *loc_params,
+    H5VL_attr_specific_args_t *args, hid_t dxpl_id, void **req) {
+  Logger::log("------ Specific attribute: ", args->op_type);
+  S3VLDatasetObj *dset_obj = owner(obj, loc_params);
+  switch (args->op_type) {
+  case H5VL_attr_specific_t::H5VL_ATTR_EXISTS:
+    *args->args.exists.exists =
+        dset_obj && dset_obj->findAttr(args->args.exists.name);
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_attr_specific_t::H5VL_ATTR_ITER:
+    // 0: every attribute visited, here none
+    return dset_obj ? iterate(dset_obj, args->args.iterate) : 0;
+  case H5VL_attr_specific_t::H5VL_ATTR_DELETE:
+    return dset_obj ? dset_obj->deleteAttr(args->args.del.name)
+                    : ARRAYMORPH_FAIL;
+  case H5VL_attr_specific_t::H5VL_ATTR_RENAME:
+    return dset_obj ? dset_obj->renameAttr(args->args.rename.old_name,
+                                           args->args.rename.new_name)
+                    : ARRAYMORPH_FAIL;
+  default:
+    Logger::warn("------ Unsupported attribute operation");
+    return ARRAYMORPH_FAIL;
+  }
+}
+
+herr_t S3VLAttrCallbacks::S3VL_attr_close(void *attr, hid_t dxpl_id,
+                                          void **req) {
+  S3VLAttrObj *attr_obj = (S3VLAttrObj *)attr;
+  Logger::log("------ Close attribute ", attr_obj->attr->name);
+  S3VLDatasetObj *dset_obj = attr_obj->dset;
+  delete attr_obj;
+  if (--dset_obj->open_attrs == 0 && dset_obj->closed)
+    return S3VLDatasetCallbacks::S3VL_dataset_close(dset_obj, dxpl_id, req);
+  return ARRAYMORPH_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#include "arraymorph/s3vl/attribute_obj.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include <algorithm>
+#include <cstring>
+
+static bool isVarString(hid_t type) {
+  return H5Tget_class(type) == H5T_STRING && H5Tis_variable_str(type) > 0;
+}
+
+// whether the elements of `type` hold pointers, which cannot be stored
+static bool hasPointers(hid_t type) {
+  H5T_class_t cls = H5Tget_class(type);
+  if (cls == H5T_VLEN || cls == H5T_REFERENCE)
+    return true;
+  if (cls == H5T_STRING)
+    return isVarString(type);
+  if (cls == H5T_ARRAY) {
+    hid_t base = H5Tget_super(type);
+    bool pointers = hasPointers(base);
+    H5Tclose(base);
+    return pointers;
+  }
+  if (cls == H5T_COMPOUND) {
+    int members = H5Tget_nmembers(type);
+    for (int i = 0; i < members; i++) {
+      hid_t member = H5Tget_member_type(type, i);
+      bool pointers = hasPointers(member);
+      H5Tclose(member);
+      if (pointers)
+        return true;
+    }
+  }
+  return false;
+}
+
+S3VLAttr::S3VLAttr(const std::string &name, uint32_t id, hid_t type, int rank,
+                   std::vector<hsize_t> dims)
+    : name(name), id(id), type(type), rank(rank), dims(std::move(dims)) {}
+
+S3VLAttr::~S3VLAttr() { H5Tclose(type); }
+
+std::shared_ptr<S3VLAttr> S3VLAttr::create(const std::string &name,
+                                           uint32_t id, hid_t type_id,
+                                           hid_t space_id) {
+  bool var_string = isVarString(type_id);
+  if (!var_string && hasPointers(type_id)) {
+    Logger::error("------ Unsupported type for attribute", name);
+    return nullptr;
+  }
+  int rank;
+  std::vector<hsize_t> dims;
+  switch (H5Sget_simple_extent_type(space_id)) {
+  case H5S_NULL:
+    rank = -1;
+    break;
+  case H5S_SCALAR:
+    rank = 0;
+    break;
+  case H5S_SIMPLE:
+    rank = H5Sget_simple_extent_ndims(space_id);
+    dims.resize(rank);
+    H5Sget_simple_extent_dims(space_id, dims.data(), NULL);
+    break;
+  default:
+    Logger::error("------ Unsupported dataspace for attribute", name);
+    return nullptr;
+  }
+  std::shared_ptr<S3VLAttr> attr(
+      new S3VLAttr(name, id, H5Tcopy(type_id), rank, std::move(dims)));
+  // until written: zeros, or empty strings
+  size_t element_size = var_string ? 4 : H5Tget_size(type_id);
+  attr->value.assign(attr->elements() * element_size, 0);
+  attr->size = attr->value.size();
+  return attr;
+}
+
+hsize_t S3VLAttr::elements() const {
+  if (rank < 0)
+    return 0;
+  hsize_t n = 1;
+  for (auto d : dims)
+    n *= d;
+  return n;
+}
+
+hid_t S3VLAttr::space() const {
+  if (rank < 0)
+    return H5Screate(H5S_NULL);
+  if (rank == 0)
+    return H5Screate(H5S_SCALAR);
+  return H5Screate_simple(rank, dims.data(), NULL);
+}
+
+herr_t S3VLAttr::write(hid_t mem_type_id, const void *buf) {
+  size_t n = elements();
+  if (isVarString(type)) {
+    if (!isVarString(mem_type_id)) {
+      Logger::error("------ Attribute", name, "holds variable-length strings");
+      return ARRAYMORPH_FAIL;
+    }
+    std::vector<char> out;
+    auto strs = static_cast<const char *const *>(buf);
+    for (size_t i = 0; i < n; i++) {
+      uint32_t length = strs[i] ? strlen(strs[i]) : 0;
+      size_t c = out.size();
+      out.resize(c + 4 + length);
+      memcpy(out.data() + c, &length, 4);
+      if (length)
+        memcpy(out.data() + c + 4, strs[i], length);
+    }
+    value = std::move(out);
+  } else {
+    size_t src_size = H5Tget_size(mem_type_id);
+    size_t dst_size = H5Tget_size(type);
+    std::vector<char> conv(n * std::max(src_size, dst_size));
+    memcpy(conv.data(), buf, n * src_size);
+    if (H5Tequal(mem_type_id, type) <= 0) {
+      std::vector<char> bkg(n * dst_size);
+      if (H5Tconvert(mem_type_id, type, n, conv.data(), bkg.data(),
+                     H5P_DEFAULT) < 0) {
+        Logger::error("------ Cannot convert to the type of attribute", name);
+        return ARRAYMORPH_FAIL;
+      }
+    }
+    conv.resize(n * dst_size);
+    value = std::move(conv);
+  }
+  size = value.size();
+  loaded = true;
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLAttr::read(hid_t mem_type_id, void *buf) const {
+  size_t n = elements();
+  if (isVarString(type)) {
+    if (!isVarString(mem_type_id)) {
+      Logger::error("------ Attribute", name, "holds variable-length strings");
+      return ARRAYMORPH_FAIL;
+    }
+    auto strs = static_cast<char **>(buf);
+    const char *p = value.data(), *end = p + value.size();
+    for (size_t i = 0; i < n; i++) {
+      uint32_t length;
+      if (end - p < 4)
+        return ARRAYMORPH_FAIL;
+      memcpy(&length, p, 4);
+      p += 4;
+      if (end - p < length)
+        return ARRAYMORPH_FAIL;
+      // released by the caller, e.g. with H5Treclaim()
+      strs[i] = static_cast<char *>(H5allocate_memory(length + 1, false));
+      memcpy(strs[i], p, length);
+      strs[i][length] = '\0';
+      p += length;
+    }
+    return ARRAYMORPH_SUCCESS;
+  }
+  size_t src_size = H5Tget_size(type);
+  size_t dst_size = H5Tget_size(mem_type_id);
+  if (H5Tequal(type, mem_type_id) > 0) {
+    memcpy(buf, value.data(), n * src_size);
+    return ARRAYMORPH_SUCCESS;
+  }
+  std::vector<char> conv(n * std::max(src_size, dst_size));
+  memcpy(conv.data(), value.data(), n * src_size);
+  // compound members the stored type lacks keep what buf holds
+  std::vector<char> bkg(static_cast<char *>(buf),
+                        static_cast<char *>(buf) + n * dst_size);
+  if (H5Tconvert(type, mem_type_id, n, conv.data(), bkg.data(),
+                 H5P_DEFAULT) < 0) {
+    Logger::error("------ Cannot convert attribute", name);
+    return ARRAYMORPH_FAIL;
+  }
+  memcpy(buf, conv.data(), n * dst_size);
+  return ARRAYMORPH_SUCCESS;
+}
+
+// name, id, encoded type, rank and dims, whether the value is spilled, its
+// size, and the value itself unless spilled
+void S3VLAttr::encode(std::vector<char> &out) const {
+  auto put = [&out](const void *data, size_t length) {
+    size_t c = out.size();
+    out.resize(c + length);
+    if (length)
+      memcpy(out.data() + c, data, length);
+  };
+  int name_length = name.size();
+  put(&name_length, 4);
+  put(name.data(), name_length);
+  put(&id, 4);
+  size_t type_length = 0;
+  H5Tencode(type, NULL, &type_length);
+  std::vector<char> type_buf(type_length);
+  H5Tencode(type, type_buf.data(), &type_length);
+  int encoded_length = type_length;
+  put(&encoded_length, 4);
+  put(type_buf.data(), type_length);
+  put(&rank, 4);
+  put(dims.data(), sizeof(hsize_t) * dims.size());
+  char is_spilled = spilled;
+  put(&is_spilled, 1);
+  put(&size, 8);
+  if (!spilled)
+    put(value.data(), value.size());
+}
+
+std::shared_ptr<S3VLAttr> S3VLAttr::decode(const char *&p, const char *end) {
+  auto take = [&p, end](void *data, size_t length) {
+    if (end - p < (ptrdiff_t)length)
+      return false;
+    memcpy(data, p, length);
+    p += length;
+    return true;
+  };
+  int name_length, type_length, rank;
+  uint32_t id;
+  if (!take(&name_length, 4) || name_length < 0 || end - p < name_length)
+    return nullptr;
+  std::string name(p, name_length);
+  p += name_length;
+  if (!take(&id, 4) || !take(&type_length, 4) || type_length <= 0 ||
+      end - p < type_length)
+    return nullptr;
+  hid_t type = H5Tdecode(p);
+  p += type_length;
+  if (type < 0)
+    return nullptr;
+  std::vector<hsize_t> dims;
+  char is_spilled;
+  uint64_t size;
+  if (!take(&rank, 4) || rank > H5S_MAX_RANK) {
+    H5Tclose(type);
+    return nullptr;
+  }
+  dims.resize(std::max(rank, 0));
+  if (!take(dims.data(), sizeof(hsize_t) * dims.size()) ||
+      !take(&is_spilled, 1) || !take(&size, 8) ||
+      (!is_spilled && end - p < (ptrdiff_t)size)) {
+    H5Tclose(type);
+    return nullptr;
+  }
+  std::shared_ptr<S3VLAttr> attr(
+      new S3VLAttr(name, id, type, rank, std::move(dims)));
+  attr->size = size;
+  attr->spilled = is_spilled;
+  attr->loaded = !is_spilled;
+  if (!is_spilled) {
+    attr->value.assign(p, p + size);
+    p += size;
+  }
+  return attr;
+}
@@ -0,0 +1,179 @@
+#include "arraymorph/s3vl/c_api.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include "arraymorph/core/stats.h"
+#include "arraymorph/s3vl/loader.h"
+#include "arraymorph/s3vl/vol_connector.h"
+#include "arraymorph/s3vl/vol_info.h"
+#include <cstring>
+
+// snprintf-style copy of `s` into buf
+static size_t copyOut(const std::string &s, char *buf, size_t size) {
+  if (buf && size > 0) {
+    size_t n = std::min(s.size(), size - 1);
+    memcpy(buf, s.data(), n);
+    buf[n] = '\0';
+  }
+  return s.size();
+}
+
+static herr_t dataset_optional(hid_t dset_id, const char *op_name,
+                               void *op_args) {
+  int op_type;
+  herr_t status;
+  H5E_BEGIN_TRY {
+    status = H5VLfind_opt_operation(H5VL_SUBCLS_DATASET, op_name, &op_type);
+  }
+  H5E_END_TRY;
+  if (status < 0) {
+    Logger::error("------ Optional operation not registered: ", op_name);
+    return ARRAYMORPH_FAIL;
+  }
+  H5VL_optional_args_t vol_args{op_type, op_args};
+  return H5VLdataset_optional_op(__FILE__, __func__, __LINE__, dset_id,
+                                 &vol_args, H5P_DATASET_XFER_DEFAULT,
+                                 H5ES_NONE);
+}
+
+herr_t arraymorph_dataset_reduce(hid_t dset_id, hid_t file_space_id,
+                                 arraymorph_reduce_result_t *result) {
+  arraymorph_reduce_args_t args{file_space_id, result};
+  return dataset_optional(dset_id, ARRAYMORPH_OPT_REDUCE_NAME, &args);
+}
+
+herr_t arraymorph_dataset_prefetch(hid_t dset_id, hid_t file_space_id,
+                                   size_t *queued) {
+  arraymorph_prefetch_args_t args{file_space_id, queued};
+  return dataset_optional(dset_id, ARRAYMORPH_OPT_PREFETCH_NAME, &args);
+}
+
+herr_t arraymorph_dataset_read_box(hid_t dset_id, const hsize_t *start,
+                                   const hsize_t *count, void *buf) {
+  arraymorph_box_args_t args{start, count, buf};
+  return dataset_optional(dset_id, ARRAYMORPH_OPT_READ_NAME, &args);
+}
+
+herr_t arraymorph_dataset_write_box(hid_t dset_id, const hsize_t *start,
+                                    const hsize_t *count, const void *buf) {
+  arraymorph_box_args_t args{start, count, const_cast<void *>(buf)};
+  return dataset_optional(dset_id, ARRAYMORPH_OPT_WRITE_NAME, &args);
+}
+
+arraymorph_loader_t *arraymorph_loader_open(hid_t dset_id) {
+  arraymorph_loader_t *loader = nullptr;
+  arraymorph_loader_args_t args{&loader};
+  if (dataset_optional(dset_id, ARRAYMORPH_OPT_LOADER_NAME, &args) < 0 ||
+      !loader)
+    return nullptr;
+  // the application may close its handle while batches are still queued
+  if (H5Iinc_ref(dset_id) < 0) {
+    delete reinterpret_cast<S3VLLoader *>(loader);
+    return nullptr;
+  }
+  reinterpret_cast<S3VLLoader *>(loader)->dset_id = dset_id;
+  return loader;
+}
+
+int64_t arraymorph_loader_submit(arraymorph_loader_t *loader,
+                                 hid_t mem_space_id, hid_t file_space_id,
+                                 void *buf) {
+  if (!loader)
+    return 0;
+  return reinterpret_cast<S3VLLoader *>(loader)->submit(mem_space_id,
+                                                        file_space_id, buf);
+}
+
+herr_t arraymorph_loader_wait(arraymorph_loader_t *loader, int64_t ticket) {
+  if (!loader)
+    return ARRAYMORPH_FAIL;
+  return reinterpret_cast<S3VLLoader *>(loader)->wait(ticket);
+}
+
+herr_t arraymorph_loader_close(arraymorph_loader_t *loader) {
+  if (!loader)
+    return ARRAYMORPH_SUCCESS;
+  S3VLLoader *l = reinterpret_cast<S3VLLoader *>(loader);
+  hid_t dset_id = l->dset_id;
+  delete l;
+  return H5Idec_ref(dset_id) < 0 ? ARRAYMORPH_FAIL : ARRAYMORPH_SUCCESS;
+}
+
+size_t arraymorph_stats_json(char *buf, size_t size) {
+  return copyOut(StatsRegistry::getInstance().toJson(), buf, size);
+}
+
+herr_t arraymorph_dataset_stats_json(hid_t dset_id, char *buf, size_t size,
+                                     size_t *length) {
+  arraymorph_stats_args_t args{buf, size, length};
+  return dataset_optional(dset_id, ARRAYMORPH_OPT_STATS_NAME, &args);
+}
+
+void arraymorph_reset_stats(void) { StatsRegistry::getInstance().reset(); }
+
+// a temporary property, which H5Pcopy carries along to the connector
+static herr_t setPlistValue(hid_t plist_id, const char *name, size_t value) {
+  htri_t exists = H5Pexist(plist_id, name);
+  if (exists < 0)
+    return ARRAYMORPH_FAIL;
+  herr_t status =
+      exists ? H5Pset(plist_id, name, &value)
+             : H5Pinsert2(plist_id, name, sizeof(size_t), &value, NULL, NULL,
+                          NULL, NULL, NULL, NULL);
+  return status < 0 ? ARRAYMORPH_FAIL : ARRAYMORPH_SUCCESS;
+}
+
+herr_t arraymorph_set_fapl_concurrency(hid_t fapl_id, size_t initial,
+                                       size_t min, size_t max, size_t fixed) {
+  if (setPlistValue(fapl_id, ARRAYMORPH_FAPL_INITIAL_CONCURRENCY, initial) <
+          0 ||
+      setPlistValue(fapl_id, ARRAYMORPH_FAPL_MIN_CONCURRENCY, min) < 0 ||
+      setPlistValue(fapl_id, ARRAYMORPH_FAPL_MAX_CONCURRENCY, max) < 0 ||
+      setPlistValue(fapl_id, ARRAYMORPH_FAPL_CONCURRENCY, fixed) < 0) {
+    Logger::error("------ Cannot set concurrency on fapl ", fapl_id);
+    return ARRAYMORPH_FAIL;
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t arraymorph_set_dcpl_key_stripes(hid_t dcpl_id, size_t stripes) {
+  if (setPlistValue(dcpl_id, ARRAYMORPH_DCPL_KEY_STRIPES, stripes) < 0) {
+    Logger::error("------ Cannot set key stripes on dcpl ", dcpl_id);
+    return ARRAYMORPH_FAIL;
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t arraymorph_set_dxpl_collective(hid_t dxpl_id, int comm_f) {
+#ifdef ARRAYMORPH_ENABLE_MPI
+  // 0 is independent I/O
+  size_t handle = comm_f < 0 ? 0 : static_cast<size_t>(comm_f) + 1;
+  if (setPlistValue(dxpl_id, ARRAYMORPH_DXPL_COLLECTIVE, handle) < 0) {
+    Logger::error("------ Cannot set collective I/O on dxpl ", dxpl_id);
+    return ARRAYMORPH_FAIL;
+  }
+  return ARRAYMORPH_SUCCESS;
+#else
+  Logger::error("------ Built without MPI (ARRAYMORPH_ENABLE_MPI)");
+  return ARRAYMORPH_FAIL;
+#endif
+}
+
+herr_t arraymorph_set_fapl_endpoints(hid_t fapl_id, const char *config) {
+  void *info = nullptr;
+  if (S3VLInfoCallbacks::from_str(config, &info) < 0)
+    return ARRAYMORPH_FAIL;
+  // registers the connector if the application has not loaded it yet
+  hid_t connector_id =
+      H5VLregister_connector_by_name(S3_VOL_CONNECTOR_NAME, H5P_DEFAULT);
+  herr_t status = connector_id < 0
+                      ? ARRAYMORPH_FAIL
+                      : H5Pset_vol(fapl_id, connector_id, info);
+  S3VLInfoCallbacks::free(info);
+  if (connector_id >= 0)
+    H5VLclose(connector_id);
+  if (status < 0) {
+    Logger::error("------ Cannot set endpoints on fapl ", fapl_id);
+    return ARRAYMORPH_FAIL;
+  }
+  return ARRAYMORPH_SUCCESS;
+}
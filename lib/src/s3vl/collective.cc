@@ -0,0 +1,474 @@
+#include "arraymorph/s3vl/collective.h"
+#include "arraymorph/core/logger.h"
+#include "arraymorph/core/shm_cache.h"
+#include "arraymorph/core/thread_pool.h"
+#include "arraymorph/core/tracer.h"
+#include "arraymorph/s3vl/c_api.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <future>
+#include <map>
+
+typedef std::vector<std::vector<hsize_t>> Ranges;
+// per chunk, the ranks whose selections touch it, in rank order
+typedef std::map<int, std::vector<int>> Needers;
+
+bool S3VLCollective::requested(hid_t dxpl_id, MPI_Comm &comm) {
+  size_t handle = 0;
+  if (H5Pexist(dxpl_id, ARRAYMORPH_DXPL_COLLECTIVE) > 0)
+    H5Pget(dxpl_id, ARRAYMORPH_DXPL_COLLECTIVE, &handle);
+  if (handle)
+    comm = MPI_Comm_f2c(static_cast<MPI_Fint>(handle - 1));
+#ifdef H5_HAVE_PARALLEL
+  H5FD_mpio_xfer_t mode;
+  if (!handle && H5Pget_dxpl_mpio(dxpl_id, &mode) >= 0 &&
+      mode == H5FD_MPIO_COLLECTIVE) {
+    comm = MPI_COMM_WORLD;
+    handle = 1;
+  }
+#endif
+  if (!handle)
+    return false;
+  int initialized = 0, finalized = 0;
+  MPI_Initialized(&initialized);
+  MPI_Finalized(&finalized);
+  if (!initialized || finalized) {
+    Logger::warn("------ MPI is not running, collective I/O is independent");
+    return false;
+  }
+  return true;
+}
+
+// every rank's selection box; empty for ranks with nothing selected
+static std::vector<Ranges> exchangeSelections(int ndims, const Ranges &mine,
+                                              MPI_Comm comm) {
+  int size;
+  MPI_Comm_size(comm, &size);
+  int width = 1 + 2 * ndims;
+  std::vector<uint64_t> send(width, 0), recv((size_t)width * size);
+  if (!mine.empty()) {
+    send[0] = 1;
+    for (int d = 0; d < ndims; d++) {
+      send[1 + 2 * d] = mine[d][0];
+      send[2 + 2 * d] = mine[d][1];
+    }
+  }
+  MPI_Allgather(send.data(), width, MPI_UINT64_T, recv.data(), width,
+                MPI_UINT64_T, comm);
+  std::vector<Ranges> boxes(size);
+  for (int r = 0; r < size; r++) {
+    const uint64_t *box = recv.data() + (size_t)width * r;
+    if (!box[0])
+      continue;
+    for (int d = 0; d < ndims; d++)
+      boxes[r].push_back({box[1 + 2 * d], box[2 + 2 * d]});
+  }
+  return boxes;
+}
+
+static Needers assign(const S3VLDatasetObj &dset,
+                      const std::vector<Ranges> &boxes) {
+  Needers needers;
+  for (int r = 0; r < (int)boxes.size(); r++)
+    if (!boxes[r].empty())
+      for (int c : dset.accessedChunks(boxes[r]))
+        needers[c].push_back(r);
+  return needers;
+}
+
+// the one rank that moves a chunk, spread over the ranks touching it
+static int aggregator(const Needers::value_type &entry) {
+  const std::vector<int> &ranks = entry.second;
+  return ranks[entry.first % ranks.size()];
+}
+
+// a failure on any rank fails every rank
+static herr_t agree(herr_t status, MPI_Comm comm) {
+  int ok = status >= 0, all = 0;
+  MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, comm);
+  return all ? ARRAYMORPH_SUCCESS : ARRAYMORPH_FAIL;
+}
+
+static double since(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// a whole chunk from the readahead buffer or the stores; zeros for a chunk
+// never written, null when it cannot be read or is not a whole chunk
+static std::shared_ptr<const std::vector<char>>
+wholeChunk(S3VLDatasetObj &dset, int chunk_idx, size_t bytes) {
+  std::string key = dset.chunkKey(chunk_idx);
+  // runs on the I/O pool, which may hold the fetch of a reserved entry
+  // behind this task: waiting for it could stall the pool, so an entry in
+  // flight is fetched again
+  if (dset.cache) {
+    if (auto data = dset.cache->peek(key)) {
+      dset.stats->cacheHit(bytes);
+      return data;
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  Result re = fetchObject(*dset.endpoints, key);
+  if (re.missing) {
+    Logger::log("------ Chunk not stored, reading zeros", key);
+    return std::make_shared<const std::vector<char>>(bytes, 0);
+  }
+  if (re.status < 0) {
+    Logger::error("------ Cannot read chunk", key);
+    dset.stats->failure();
+    return nullptr;
+  }
+  if (re.data.size() != bytes) {
+    Logger::error("------ Stored chunk has the wrong size", key);
+    dset.stats->failure();
+    return nullptr;
+  }
+  dset.stats->request(bytes, since(start));
+  return std::make_shared<const std::vector<char>>(std::move(re.data));
+}
+
+herr_t S3VLCollective::read(S3VLDatasetObj &dset, MPI_Comm comm,
+                            hid_t mem_space_id, hid_t file_space_id,
+                            void *buf) {
+  TraceSpan span("H5Dread collective", "dataset");
+  auto read_start = std::chrono::steady_clock::now();
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  Ranges ranges;
+  herr_t status = dset.fileRanges(file_space_id, ranges);
+  std::vector<hsize_t> out_offsets;
+  hsize_t out_row_size = 0;
+  if (status >= 0 && !ranges.empty()) {
+    out_row_size = dset.bufferLayout(mem_space_id, ranges, out_offsets);
+    if (!out_row_size)
+      status = ARRAYMORPH_FAIL;
+  }
+  if (status < 0)
+    ranges.clear();
+  Needers needers = assign(dset, exchangeSelections(dset.ndims, ranges, comm));
+  size_t bytes = dset.element_per_chunk * dset.data_size;
+
+  // GET the chunks this rank aggregates
+  std::map<int, std::shared_ptr<const std::vector<char>>> fetched;
+  for (auto &entry : needers)
+    if (aggregator(entry) == rank)
+      fetched[entry.first];
+  std::vector<std::future<herr_t>> futures;
+  for (auto &entry : fetched) {
+    int c = entry.first;
+    auto *slot = &entry.second;
+    futures.push_back(
+        ThreadPool::getInstance().submit([&dset, c, slot, bytes] {
+          *slot = wholeChunk(dset, c, bytes);
+          if (*slot)
+            return ARRAYMORPH_SUCCESS;
+          // still sent, so the exchange lines up
+          *slot = std::make_shared<const std::vector<char>>(bytes, 0);
+          return ARRAYMORPH_FAIL;
+        }));
+  }
+  for (auto &fut : futures)
+    if (fut.get() < 0)
+      status = ARRAYMORPH_FAIL;
+
+  // send each to the other ranks touching it, in chunk order
+  std::vector<int> send_counts(size, 0), recv_counts(size, 0);
+  for (auto &entry : needers) {
+    int from = aggregator(entry);
+    for (int r : entry.second) {
+      if (r == from)
+        continue;
+      if (from == rank)
+        send_counts[r]++;
+      if (r == rank)
+        recv_counts[from]++;
+    }
+  }
+  std::vector<int> send_displs(size, 0), recv_displs(size, 0);
+  for (int r = 1; r < size; r++) {
+    send_displs[r] = send_displs[r - 1] + send_counts[r - 1];
+    recv_displs[r] = recv_displs[r - 1] + recv_counts[r - 1];
+  }
+  std::vector<char> send_buf(
+      (send_displs[size - 1] + send_counts[size - 1]) * bytes);
+  std::vector<char> recv_buf(
+      (recv_displs[size - 1] + recv_counts[size - 1]) * bytes);
+  std::vector<int> sent(size, 0), received(size, 0);
+  std::map<int, const char *> chunk_data;
+  for (auto &entry : needers) {
+    int from = aggregator(entry);
+    if (from == rank) {
+      const char *data = fetched[entry.first]->data();
+      chunk_data[entry.first] = data;
+      for (int r : entry.second)
+        if (r != rank)
+          memcpy(send_buf.data() + (send_displs[r] + sent[r]++) * bytes, data,
+                 bytes);
+    } else if (std::binary_search(entry.second.begin(), entry.second.end(),
+                                  rank)) {
+      chunk_data[entry.first] =
+          recv_buf.data() + (recv_displs[from] + received[from]++) * bytes;
+    }
+  }
+  MPI_Datatype chunk_type;
+  MPI_Type_contiguous(static_cast<int>(bytes), MPI_BYTE, &chunk_type);
+  MPI_Type_commit(&chunk_type);
+  MPI_Alltoallv(send_buf.data(), send_counts.data(), send_displs.data(),
+                chunk_type, recv_buf.data(), recv_counts.data(),
+                recv_displs.data(), chunk_type, comm);
+  MPI_Type_free(&chunk_type);
+
+  if (!ranges.empty()) {
+    uint64_t required = 0;
+    for (int c : dset.accessedChunks(ranges)) {
+      const char *data = chunk_data[c];
+      for (auto &m : dset.chunkMapping(c, ranges, out_offsets, out_row_size)) {
+        memcpy((char *)buf + m[1], data + m[0], m[2]);
+        required += m[2];
+      }
+    }
+    dset.stats->read(required, since(read_start));
+  }
+  if (span.active)
+    span.args.add("uri", dset.uri)
+        .add("aggregated", static_cast<uint64_t>(fetched.size()));
+  return agree(status, comm);
+}
+
+// a rank's part of one chunk, as sent to its aggregator: the chunk index and
+// run count, {offset in the chunk, length} per run, then the runs' bytes
+static void packPiece(std::vector<char> &out, int chunk_idx,
+                      const std::list<std::vector<hsize_t>> &mapping,
+                      const char *buf) {
+  auto put = [&out](const void *data, size_t length) {
+    size_t c = out.size();
+    out.resize(c + length);
+    memcpy(out.data() + c, data, length);
+  };
+  uint64_t head[2] = {static_cast<uint64_t>(chunk_idx), mapping.size()};
+  put(head, sizeof(head));
+  for (auto &m : mapping) {
+    uint64_t run[2] = {m[0], m[2]};
+    put(run, sizeof(run));
+  }
+  for (auto &m : mapping)
+    put(buf + m[1], m[2]);
+}
+
+// a received piece: where its runs and bytes are, and where the next starts
+struct Piece {
+  uint64_t runs;
+  const char *table;
+  const char *data;
+};
+
+static const char *parsePiece(const char *p, int &chunk_idx, Piece &piece) {
+  uint64_t head[2];
+  memcpy(head, p, sizeof(head));
+  chunk_idx = static_cast<int>(head[0]);
+  piece.runs = head[1];
+  piece.table = p + sizeof(head);
+  piece.data = piece.table + piece.runs * 2 * sizeof(uint64_t);
+  const char *next = piece.data;
+  for (uint64_t i = 0; i < piece.runs; i++) {
+    uint64_t run[2];
+    memcpy(run, piece.table + i * sizeof(run), sizeof(run));
+    next += run[1];
+  }
+  return next;
+}
+
+// the merged chunk from every rank's pieces, over the stored chunk when the
+// pieces leave part of it unwritten that may already hold data
+static herr_t buildChunk(S3VLDatasetObj &dset, int chunk_idx,
+                         const std::vector<Piece> &pieces,
+                         std::vector<char> &chunk) {
+  size_t data_size = dset.data_size;
+  std::vector<bool> covered(dset.element_per_chunk, false);
+  size_t covered_num = 0;
+  for (auto &piece : pieces) {
+    for (uint64_t i = 0; i < piece.runs; i++) {
+      uint64_t run[2];
+      memcpy(run, piece.table + i * sizeof(run), sizeof(run));
+      for (uint64_t e = run[0] / data_size; e < (run[0] + run[1]) / data_size;
+           e++) {
+        if (!covered[e])
+          covered_num++;
+        covered[e] = true;
+      }
+    }
+  }
+  // elements of the chunk inside the extent, and whether any may be stored
+  std::vector<hsize_t> offsets = dset.getChunkOffsets(chunk_idx);
+  size_t in_extent = 1;
+  bool stored = true;
+  for (int d = 0; d < dset.ndims; d++) {
+    in_extent *= std::min(dset.chunk_shape[d], dset.shape[d] - offsets[d]);
+    stored = stored && offsets[d] < dset.stored_shape[d];
+  }
+  chunk.assign(dset.element_per_chunk * data_size, 0);
+  if (covered_num < in_extent && stored) {
+    std::string key = dset.chunkKey(chunk_idx);
+    auto start = std::chrono::steady_clock::now();
+    Result re = getObject(dset.endpoints->primary(), key);
+    if (re.status < 0 && !re.missing) {
+      // zeros would overwrite what is stored
+      Logger::error("------ Cannot merge into chunk", key);
+      dset.stats->failure();
+      return ARRAYMORPH_FAIL;
+    }
+    if (re.data.size() == chunk.size()) {
+      dset.stats->request(chunk.size(), since(start));
+      chunk = std::move(re.data);
+    } else if (!re.missing) {
+      Logger::error("------ Stored chunk has the wrong size", key);
+      dset.stats->failure();
+      return ARRAYMORPH_FAIL;
+    }
+  }
+  for (auto &piece : pieces) {
+    const char *data = piece.data;
+    for (uint64_t i = 0; i < piece.runs; i++) {
+      uint64_t run[2];
+      memcpy(run, piece.table + i * sizeof(run), sizeof(run));
+      memcpy(chunk.data() + run[0], data, run[1]);
+      data += run[1];
+    }
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLCollective::write(S3VLDatasetObj &dset, MPI_Comm comm,
+                             hid_t mem_space_id, hid_t file_space_id,
+                             const void *buf) {
+  TraceSpan span("H5Dwrite collective", "dataset");
+  auto write_start = std::chrono::steady_clock::now();
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  Ranges ranges;
+  herr_t status = dset.fileRanges(file_space_id, ranges);
+  std::vector<hsize_t> source_offsets;
+  hsize_t source_row_size = 0;
+  if (status >= 0 && !ranges.empty()) {
+    source_row_size = dset.bufferLayout(mem_space_id, ranges, source_offsets);
+    if (!source_row_size)
+      status = ARRAYMORPH_FAIL;
+  }
+  if (status < 0)
+    ranges.clear();
+  std::vector<Ranges> boxes = exchangeSelections(dset.ndims, ranges, comm);
+  Needers needers = assign(dset, boxes);
+
+  // this rank's pieces, grouped by aggregator
+  std::vector<std::vector<char>> out(size);
+  uint64_t written = 0;
+  if (!ranges.empty()) {
+    for (int c : dset.accessedChunks(ranges)) {
+      auto mapping =
+          dset.chunkMapping(c, ranges, source_offsets, source_row_size);
+      packPiece(out[aggregator(*needers.find(c))], c, mapping,
+                (const char *)buf);
+      for (auto &m : mapping)
+        written += m[2];
+    }
+  }
+  std::vector<int> send_counts(size), recv_counts(size);
+  std::vector<int> send_displs(size, 0), recv_displs(size, 0);
+  size_t send_total = 0;
+  for (int r = 0; r < size; r++) {
+    send_total += out[r].size();
+    if (send_total > INT_MAX) {
+      Logger::error("------ Collective write over 2 GiB per rank");
+      status = ARRAYMORPH_FAIL;
+      out.assign(size, {});
+      send_total = 0;
+      break;
+    }
+  }
+  for (int r = 0; r < size; r++) {
+    send_counts[r] = out[r].size();
+    if (r > 0)
+      send_displs[r] = send_displs[r - 1] + send_counts[r - 1];
+  }
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT,
+               comm);
+  size_t recv_total = 0;
+  for (int r = 0; r < size; r++) {
+    recv_total += recv_counts[r];
+    if (r > 0)
+      recv_displs[r] = recv_displs[r - 1] + recv_counts[r - 1];
+  }
+  if (recv_total > INT_MAX) {
+    Logger::error("------ Collective write over 2 GiB per aggregator");
+    status = ARRAYMORPH_FAIL;
+  }
+  std::vector<char> send_buf;
+  send_buf.reserve(send_total);
+  for (auto &piece : out)
+    send_buf.insert(send_buf.end(), piece.begin(), piece.end());
+  out.clear();
+  std::vector<char> recv_buf(recv_total);
+  if (recv_total <= INT_MAX)
+    MPI_Alltoallv(send_buf.data(), send_counts.data(), send_displs.data(),
+                  MPI_BYTE, recv_buf.data(), recv_counts.data(),
+                  recv_displs.data(), MPI_BYTE, comm);
+  // nothing is stored unless every rank's pieces arrived
+  if (agree(status, comm) < 0)
+    return ARRAYMORPH_FAIL;
+
+  // received in rank order, so later ranks win where pieces overlap
+  std::map<int, std::vector<Piece>> pieces;
+  for (const char *p = recv_buf.data(), *end = p + recv_total; p < end;) {
+    int c;
+    Piece piece;
+    p = parsePiece(p, c, piece);
+    pieces[c].push_back(piece);
+  }
+  std::vector<std::future<herr_t>> futures;
+  for (auto &entry : pieces) {
+    int c = entry.first;
+    auto *chunk_pieces = &entry.second;
+    futures.push_back(
+        ThreadPool::getInstance().submit([&dset, c, chunk_pieces] {
+          std::vector<char> chunk;
+          if (buildChunk(dset, c, *chunk_pieces, chunk) < 0)
+            return ARRAYMORPH_FAIL;
+          std::string key = dset.chunkKey(c);
+          auto start = std::chrono::steady_clock::now();
+          herr_t put = putObject(dset.endpoints->primary(), key, chunk);
+          if (put < 0)
+            dset.stats->failure();
+          else
+            dset.stats->request(chunk.size(), since(start));
+          return put;
+        }));
+  }
+  for (auto &fut : futures)
+    if (fut.get() < 0)
+      status = ARRAYMORPH_FAIL;
+
+  // every rank keeps the same view of what is stored
+  SharedChunkCache *shared = SharedChunkCache::getInstance();
+  for (auto &entry : needers) {
+    std::string key = dset.chunkKey(entry.first);
+    if (dset.cache)
+      dset.cache->erase(key);
+    if (shared)
+      shared->erase(dset.sharedKey(key));
+  }
+  for (auto &box : boxes)
+    for (int d = 0; d < (int)box.size(); d++)
+      dset.stored_shape[d] = std::max(dset.stored_shape[d], box[d][1] + 1);
+  if (!ranges.empty())
+    dset.stats->write(written, since(write_start));
+  if (span.active)
+    span.args.add("uri", dset.uri)
+        .add("aggregated", static_cast<uint64_t>(pieces.size()));
+  return agree(status, comm);
+}
@@ -2,6 +2,12 @@
 #include "arraymorph/core/operators.h"
 #include "arraymorph/s3vl/dataset_callbacks.h"
 #include "arraymorph/core/constants.h"
+#include "arraymorph/s3vl/c_api.h"
+#include "arraymorph/s3vl/group_callbacks.h"
+#include "arraymorph/s3vl/loader.h"
+#ifdef ARRAYMORPH_ENABLE_MPI
+#include "arraymorph/s3vl/collective.h"
+#endif
 #include <algorithm>
 #include <assert.h>
 #include <aws/core/utils/threading/Executor.h>
@@ -25,6 +31,17 @@ const hid_t get_native_type(hid_t tid) {
   return ARRAYMORPH_FAIL;
 }
 
+// set with arraymorph_set_dcpl_key_stripes(), else ARRAYMORPH_KEY_STRIPES
+static int keyStripes(hid_t dcpl_id) {
+  size_t stripes = KEY_STRIPES;
+  if (const char *env = getenv("ARRAYMORPH_KEY_STRIPES"))
+    stripes = std::strtoull(env, nullptr, 10);
+  if (dcpl_id != H5P_DEFAULT &&
+      H5Pexist(dcpl_id, ARRAYMORPH_DCPL_KEY_STRIPES) > 0)
+    H5Pget(dcpl_id, ARRAYMORPH_DCPL_KEY_STRIPES, &stripes);
+  return std::min<size_t>(stripes, KEY_STRIPES_MAX);
+}
+
 void *S3VLDatasetCallbacks::S3VL_dataset_create(
     void *obj, const H5VL_loc_params_t *loc_params, const char *name,
     hid_t lcpl_id, hid_t type_id, hid_t space_id, hid_t dcpl_id, hid_t dapl_id,
@@ -32,11 +49,15 @@ void *S3VLDatasetCallbacks::S3VL_dataset_create(
   Logger::log("------ Create Dataset: ", name);
   hid_t new_tid = get_native_type(type_id);
   if (new_tid < 0) {
-    Logger::log("------ Unsupported data type");
+    Logger::error("------ Unsupported data type");
+    return NULL;
+  }
+  S3VLGroupObj loc;
+  if (!S3VLGroupCallbacks::locate(obj, loc_params->obj_type, loc)) {
+    Logger::error("------ Datasets are only created in groups");
     return NULL;
   }
-  S3VLFileObj *file_obj = (S3VLFileObj *)obj;
-  std::string uri = file_obj->name + "/" + name;
+  std::string path = joinPath(loc.path, name);
 
   int ndims = H5Sget_simple_extent_ndims(space_id);
 
@@ -47,22 +68,38 @@ void *S3VLDatasetCallbacks::S3VL_dataset_create(
   H5Sget_simple_extent_dims(space_id, dims, max_dims);
 
   H5D_layout_t layout = H5Pget_layout(dcpl_id);
+  bool resizable = !std::equal(dims, dims + ndims, max_dims);
 
   if (layout == H5D_CHUNKED) {
     H5Pget_chunk(dcpl_id, ndims, chunk_dims);
+  } else if (resizable) {
+    Logger::error("------ Resizable datasets must be chunked");
+    return NULL;
   } else {
-    memcpy(chunk_dims, dims, sizeof(hsize_t) * ndims);
+    for (int i = 0; i < ndims; i++)
+      chunk_dims[i] = std::max<hsize_t>(dims[i], 1);
   }
   int nchunks = 1;
   for (int i = 0; i < ndims; i++)
-    nchunks *= (dims[i] - 1) / chunk_dims[i] + 1;
+    nchunks *= (dims[i] + chunk_dims[i] - 1) / chunk_dims[i];
   std::vector<hsize_t> shape(dims, dims + ndims);
   std::vector<hsize_t> chunk_shape(chunk_dims, chunk_dims + ndims);
+  std::vector<hsize_t> max_shape;
+  if (resizable)
+    max_shape.assign(max_dims, max_dims + ndims);
+  auto parent =
+      loc.tree->parent(path, S3VLGroupCallbacks::intermediate(lcpl_id));
+  if (!parent)
+    return NULL;
 
-  S3VLDatasetObj *ret_obj =
-      new S3VLDatasetObj(name, uri, new_tid, ndims, shape, chunk_shape, nchunks,
-                         BUCKET_NAME, global_cloud_client);
+  S3VLDatasetObj *ret_obj = new S3VLDatasetObj(
+      path, loc.tree->uri(path), new_tid, ndims, shape, chunk_shape, nchunks,
+      loc.tree->endpoints, keyStripes(dcpl_id), max_shape);
   ret_obj->is_modified = true;
+  parent->add(splitPath(path).second, H5O_TYPE_DATASET);
+  ret_obj->parent = parent;
+  // a new dataset has nothing stored to merge writes into
+  ret_obj->stored_shape.assign(ndims, 0);
   Logger::log("------ Create Metadata:");
   Logger::log(ret_obj->to_string());
   return (void *)ret_obj;
@@ -78,11 +115,17 @@ void *S3VLDatasetCallbacks::S3VL_dataset_open(
   // 	dset_name = "test";
   // 	// return NULL;
   // }
-  S3VLFileObj *file_obj = (S3VLFileObj *)obj;
-  std::string dset_uri = file_obj->name + "/" + name + "/meta";
+  S3VLGroupObj loc;
+  if (!S3VLGroupCallbacks::locate(obj, loc_params->obj_type, loc))
+    return NULL;
+  std::string dset_uri = loc.tree->uri(joinPath(loc.path, name)) + "/meta";
 
   S3VLDatasetObj *dset_obj =
-      S3VLDatasetObj::getDatasetObj(global_cloud_client, BUCKET_NAME, dset_uri);
+      S3VLDatasetObj::getDatasetObj(loc.tree->endpoints, dset_uri);
+  if (dset_obj == nullptr) {
+    Logger::error("------ No metadata for dataset", name);
+    return NULL;
+  }
   Logger::log("------ Get Metadata:");
   Logger::log(dset_obj->to_string());
   // hid_t type_id = dset_obj->dtype;
@@ -97,17 +140,20 @@ herr_t S3VLDatasetCallbacks::S3VL_dataset_read(
   // string lower_range = getenv("LOWER_RANGE");
   // string upper_range = getenv("UPPER_RANGE");
   // cout << lower_range << " " << upper_range << endl;
-  auto read_start = std::chrono::high_resolution_clock::now();
-  std::cout << "read :" << dset_obj->uri << std::endl;
-  if (dset_obj->read(*mem_space_id, *file_space_id, buf[0])) {
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> duration = end - read_start;
-    std::cout << "VOL read time: " << duration.count() << " seconds"
-              << std::endl;
+  herr_t status;
+#ifdef ARRAYMORPH_ENABLE_MPI
+  MPI_Comm comm;
+  if (S3VLCollective::requested(plist_id, comm))
+    status = S3VLCollective::read(*dset_obj, comm, *mem_space_id,
+                                  *file_space_id, buf[0]);
+  else
+#endif
+    status = dset_obj->read(*mem_space_id, *file_space_id, buf[0]);
+  if (status >= 0) {
     Logger::log("read successfully");
     return ARRAYMORPH_SUCCESS;
   }
-  Logger::log("read failed");
+  Logger::error("read failed");
   return ARRAYMORPH_FAIL;
 }
 herr_t S3VLDatasetCallbacks::S3VL_dataset_write(
@@ -119,11 +165,20 @@ herr_t S3VLDatasetCallbacks::S3VL_dataset_write(
   // vector<int> mem_space = get_range_from_dataspace(mem_space_id);
   // vector<int> file_space = get_range_from_dataspace(file_space_id);
 
-  if (dset_obj->write(*mem_space_id, *file_space_id, buf[0])) {
+  herr_t status;
+#ifdef ARRAYMORPH_ENABLE_MPI
+  MPI_Comm comm;
+  if (S3VLCollective::requested(plist_id, comm))
+    status = S3VLCollective::write(*dset_obj, comm, *mem_space_id,
+                                   *file_space_id, buf[0]);
+  else
+#endif
+    status = dset_obj->write(*mem_space_id, *file_space_id, buf[0]);
+  if (status >= 0) {
     Logger::log("write successfully");
     return ARRAYMORPH_SUCCESS;
   }
-  Logger::log("write failed");
+  Logger::error("write failed");
   return ARRAYMORPH_FAIL;
 }
 
@@ -133,12 +188,15 @@ herr_t S3VLDatasetCallbacks::S3VL_dataset_get(void *dset,
   S3VLDatasetObj *dset_obj = (S3VLDatasetObj *)dset;
   Logger::log("------ Get Space dataset: ", args->op_type);
   if (args->op_type == H5VL_dataset_get_t::H5VL_DATASET_GET_DCPL) {
+    // chunked, so that h5py allows resizing
     hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
-    args->args.get_dcpl.dcpl_id = H5Pcopy(dcpl_id);
+    H5Pset_chunk(dcpl_id, dset_obj->ndims, dset_obj->chunk_shape.data());
+    args->args.get_dcpl.dcpl_id = dcpl_id;
   } else if (args->op_type == H5VL_dataset_get_t::H5VL_DATASET_GET_SPACE) {
     std::vector<hsize_t> shape = dset_obj->shape;
     // swap(shape[0], shape[1]);
-    hid_t space_id = H5Screate_simple(dset_obj->ndims, shape.data(), NULL);
+    hid_t space_id = H5Screate_simple(dset_obj->ndims, shape.data(),
+                                      dset_obj->max_shape.data());
     args->args.get_space.space_id = space_id;
   } else if (args->op_type == H5VL_dataset_get_t::H5VL_DATASET_GET_TYPE) {
     hid_t type_id = H5Tcopy(dset_obj->dtype);
@@ -148,14 +206,22 @@ herr_t S3VLDatasetCallbacks::S3VL_dataset_get(void *dset,
 }
 herr_t S3VLDatasetCallbacks::S3VL_dataset_close(void *dset, hid_t dxpl_id,
                                                 void **req) {
-  // TODO: update metadata
   Logger::log("------ Close dataset");
   S3VLDatasetObj *dset_obj = (S3VLDatasetObj *)dset;
-  if (dset_obj->is_modified)
-    dset_obj->upload();
+  // open attributes hold on to the dataset; the last of them closes it
+  if (dset_obj->open_attrs > 0) {
+    dset_obj->closed = true;
+    return ARRAYMORPH_SUCCESS;
+  }
+  herr_t status = ARRAYMORPH_SUCCESS;
+  // a dataset whose metadata is not stored is not published either
+  if (dset_obj->is_modified && dset_obj->upload() < 0)
+    status = ARRAYMORPH_FAIL;
+  else if (dset_obj->parent && dset_obj->parent->publish() < 0)
+    status = ARRAYMORPH_FAIL;
 
   delete dset_obj;
-  return ARRAYMORPH_SUCCESS;
+  return status;
 }
 
 void *S3VLDatasetCallbacks::S3VL_obj_open(void *obj,
@@ -163,34 +229,105 @@ void *S3VLDatasetCallbacks::S3VL_obj_open(void *obj,
                                           H5I_type_t *opened_type,
                                           hid_t dxpl_id, void **req) {
   Logger::log("------ Open object");
-  std::string access_name = loc_params->loc_data.loc_by_name.name;
-  // cout << "open by name: " << access_name << endl;
-  // cout << "open type: " << *opened_type << endl;
-  // if (access_name == "/") {
-  // 	*opened_type = H5I_type_t::H5I_GROUP;
-  // 	vector<string> test = {"1", "2", "3"};
-  // 	return new S3VLObj(test, 0);
-  // }
-  // else {
+  S3VLGroupObj loc;
+  if (loc_params->type != H5VL_OBJECT_BY_NAME ||
+      !S3VLGroupCallbacks::resolve(obj, loc_params, loc)) {
+    Logger::error("------ Objects are only opened by name from groups");
+    return NULL;
+  }
+  if (loc.tree->type(loc.path) == H5O_TYPE_GROUP) {
+    *opened_type = H5I_type_t::H5I_GROUP;
+    return new S3VLGroupObj(loc);
+  }
+  // also datasets of files stored before groups had indexes, which are
+  // not linked in any
   *opened_type = H5I_type_t::H5I_DATASET;
   return S3VLDatasetCallbacks::S3VL_dataset_open(
       obj, loc_params, loc_params->loc_data.loc_by_name.name, dxpl_id, dxpl_id,
       req);
-  // }
+}
+
+// the type of the object `loc_params` refers to, from the index of its
+// group unless it is `obj` itself
+static H5O_type_t objectType(void *obj, const H5VL_loc_params_t *loc_params,
+                             std::string &path) {
+  bool self = loc_params->type == H5VL_OBJECT_BY_SELF ||
+              (loc_params->type == H5VL_OBJECT_BY_NAME &&
+               strcmp(loc_params->loc_data.loc_by_name.name, ".") == 0);
+  if (self && loc_params->obj_type == H5I_DATASET) {
+    path = joinPath("", ((S3VLDatasetObj *)obj)->name);
+    return H5O_TYPE_DATASET;
+  }
+  S3VLGroupObj loc;
+  if (!S3VLGroupCallbacks::resolve(obj, loc_params, loc))
+    return H5O_TYPE_UNKNOWN;
+  path = loc.path;
+  return loc.tree->type(loc.path);
 }
 
 herr_t S3VLDatasetCallbacks::S3VL_obj_get(void *obj,
                                           const H5VL_loc_params_t *loc_params,
                                           H5VL_object_get_args_t *args,
                                           hid_t dxpl_id, void **req) {
-  Logger::log("------ Object get");
-  // cout << args->op_type << endl;
-  // cout << loc_params->obj_type << " " << loc_params->type << " " <<
-  // loc_params->loc_data.loc_by_name.name << endl;;
-  if (args->op_type == H5VL_object_get_t::H5VL_OBJECT_GET_INFO)
-    args->args.get_info.oinfo->type = H5O_type_t::H5O_TYPE_GROUP;
-  return ARRAYMORPH_SUCCESS;
+  Logger::log("------ Object get", args->op_type);
+  std::string path;
+  H5O_type_t type;
+  switch (args->op_type) {
+  case H5VL_object_get_t::H5VL_OBJECT_GET_TYPE:
+    type = objectType(obj, loc_params, path);
+    *args->args.get_type.obj_type = type;
+    return type == H5O_TYPE_UNKNOWN ? ARRAYMORPH_FAIL : ARRAYMORPH_SUCCESS;
+  case H5VL_object_get_t::H5VL_OBJECT_GET_INFO: {
+    type = objectType(obj, loc_params, path);
+    if (type == H5O_TYPE_UNKNOWN)
+      return ARRAYMORPH_FAIL;
+    H5O_info_t *oinfo = args->args.get_info.oinfo;
+    memset(oinfo, 0, sizeof(*oinfo));
+    oinfo->type = type;
+    oinfo->rc = 1;
+    // a dataset's attributes came with its metadata
+    if (loc_params->obj_type == H5I_DATASET &&
+        loc_params->type == H5VL_OBJECT_BY_SELF)
+      oinfo->num_attrs = ((S3VLDatasetObj *)obj)->attrs.size();
+    return ARRAYMORPH_SUCCESS;
+  }
+  case H5VL_object_get_t::H5VL_OBJECT_GET_NAME: {
+    // H5Iget_name: the path from the root
+    if (loc_params->type != H5VL_OBJECT_BY_SELF ||
+        objectType(obj, loc_params, path) == H5O_TYPE_UNKNOWN)
+      return ARRAYMORPH_FAIL;
+    std::string name = "/" + path;
+    auto &name_args = args->args.get_name;
+    if (name_args.buf && name_args.buf_size > 0) {
+      size_t n = std::min(name.size(), name_args.buf_size - 1);
+      memcpy(name_args.buf, name.data(), n);
+      name_args.buf[n] = '\0';
+    }
+    if (name_args.name_len)
+      *name_args.name_len = name.size();
+    return ARRAYMORPH_SUCCESS;
+  }
+  default:
+    return ARRAYMORPH_SUCCESS;
+  }
 }
+
+herr_t S3VLDatasetCallbacks::S3VL_obj_specific(
+    void *obj, const H5VL_loc_params_t *loc_params,
+    H5VL_object_specific_args_t *args, hid_t dxpl_id, void **req) {
+  Logger::log("------ Object specific", args->op_type);
+  std::string path;
+  switch (args->op_type) {
+  case H5VL_object_specific_t::H5VL_OBJECT_EXISTS:
+    *args->args.exists.exists =
+        objectType(obj, loc_params, path) != H5O_TYPE_UNKNOWN;
+    return ARRAYMORPH_SUCCESS;
+  default:
+    Logger::warn("------ Unsupported object operation");
+    return ARRAYMORPH_FAIL;
+  }
+}
+
 void *S3VLDatasetCallbacks::S3VL_wrap_object(void *obj, H5I_type_t obj_type,
                                              void *wrap_ctx) {
   Logger::log("------ Wrap object");
@@ -204,6 +341,121 @@ void *S3VLDatasetCallbacks::S3VL_get_object(const void *obj) {
 
 herr_t S3VLDatasetCallbacks::S3VL_dataset_specific(
     void *obj, H5VL_dataset_specific_args_t *args, hid_t dxpl_id, void **req) {
+  S3VLDatasetObj *dset_obj = (S3VLDatasetObj *)obj;
   Logger::log("------ Specific dataset: ", args->op_type);
+  switch (args->op_type) {
+  case H5VL_dataset_specific_t::H5VL_DATASET_SET_EXTENT:
+    return dset_obj->setExtent(args->args.set_extent.size);
+  case H5VL_dataset_specific_t::H5VL_DATASET_FLUSH:
+    // chunks are stored as they are written; only the extent and the
+    // attributes may be pending
+    if (dset_obj->is_modified && dset_obj->upload() < 0)
+      return ARRAYMORPH_FAIL;
+    if (dset_obj->parent) {
+      // kept, so that closing publishes it again
+      if (dset_obj->parent->publish() < 0)
+        return ARRAYMORPH_FAIL;
+      dset_obj->parent = nullptr;
+    }
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_dataset_specific_t::H5VL_DATASET_REFRESH:
+    return dset_obj->refresh();
+  default:
+    return ARRAYMORPH_SUCCESS;
+  }
+}
+
+int S3VLDatasetCallbacks::reduce_op = -1;
+int S3VLDatasetCallbacks::stats_op = -1;
+int S3VLDatasetCallbacks::prefetch_op = -1;
+int S3VLDatasetCallbacks::loader_op = -1;
+int S3VLDatasetCallbacks::read_op = -1;
+int S3VLDatasetCallbacks::write_op = -1;
+
+// name and assigned op type of every connector-specific dataset operation
+static const std::pair<const char *, int *> optional_ops[] = {
+    {ARRAYMORPH_OPT_REDUCE_NAME, &S3VLDatasetCallbacks::reduce_op},
+    {ARRAYMORPH_OPT_STATS_NAME, &S3VLDatasetCallbacks::stats_op},
+    {ARRAYMORPH_OPT_PREFETCH_NAME, &S3VLDatasetCallbacks::prefetch_op},
+    {ARRAYMORPH_OPT_LOADER_NAME, &S3VLDatasetCallbacks::loader_op},
+    {ARRAYMORPH_OPT_READ_NAME, &S3VLDatasetCallbacks::read_op},
+    {ARRAYMORPH_OPT_WRITE_NAME, &S3VLDatasetCallbacks::write_op},
+};
+
+herr_t S3VLDatasetCallbacks::registerOptionalOps() {
+  for (auto &[name, op] : optional_ops) {
+    if (H5VLregister_opt_operation(H5VL_SUBCLS_DATASET, name, op) < 0) {
+      Logger::error("------ Failed to register ", name);
+      return ARRAYMORPH_FAIL;
+    }
+  }
   return ARRAYMORPH_SUCCESS;
 }
+
+herr_t S3VLDatasetCallbacks::unregisterOptionalOps() {
+  for (auto &[name, op] : optional_ops) {
+    if (*op >= 0)
+      H5VLunregister_opt_operation(H5VL_SUBCLS_DATASET, name);
+    *op = -1;
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+bool S3VLDatasetCallbacks::isOptionalOp(int op_type) {
+  for (auto &[name, op] : optional_ops)
+    if (op_type >= 0 && op_type == *op)
+      return true;
+  return false;
+}
+
+herr_t S3VLDatasetCallbacks::S3VL_dataset_optional(void *obj,
+                                                   H5VL_optional_args_t *args,
+                                                   hid_t dxpl_id, void **req) {
+  S3VLDatasetObj *dset_obj = (S3VLDatasetObj *)obj;
+  Logger::log("------ Optional dataset: ", args->op_type);
+  if (args->op_type == reduce_op) {
+    auto reduce_args = (arraymorph_reduce_args_t *)args->args;
+    ReduceResult result;
+    if (dset_obj->reduce(reduce_args->file_space_id, result) < 0)
+      return ARRAYMORPH_FAIL;
+    *reduce_args->result = {result.sum, result.min, result.max, result.mean(),
+                            result.count};
+    return ARRAYMORPH_SUCCESS;
+  }
+  if (args->op_type == prefetch_op) {
+    auto prefetch_args = (arraymorph_prefetch_args_t *)args->args;
+    size_t queued = dset_obj->prefetch(prefetch_args->file_space_id);
+    if (prefetch_args->queued)
+      *prefetch_args->queued = queued;
+    return ARRAYMORPH_SUCCESS;
+  }
+  if (args->op_type == read_op) {
+    auto box_args = (arraymorph_box_args_t *)args->args;
+    return dset_obj->readBox(box_args->start, box_args->count, box_args->buf);
+  }
+  if (args->op_type == write_op) {
+    auto box_args = (arraymorph_box_args_t *)args->args;
+    return dset_obj->writeBox(box_args->start, box_args->count,
+                              box_args->buf);
+  }
+  if (args->op_type == loader_op) {
+    auto loader_args = (arraymorph_loader_args_t *)args->args;
+    *loader_args->loader =
+        reinterpret_cast<arraymorph_loader_t *>(new S3VLLoader(dset_obj));
+    return ARRAYMORPH_SUCCESS;
+  }
+  if (args->op_type == stats_op) {
+    auto stats_args = (arraymorph_stats_args_t *)args->args;
+    std::string json = StatsRegistry::getInstance().datasetJson(dset_obj->uri);
+    if (stats_args->buf && stats_args->size > 0) {
+      size_t n = std::min(json.size(), stats_args->size - 1);
+      memcpy(stats_args->buf, json.data(), n);
+      stats_args->buf[n] = '\0';
+    }
+    if (stats_args->length)
+      *stats_args->length = json.size();
+    return ARRAYMORPH_SUCCESS;
+  }
+  Logger::warn("------ Unsupported optional operation");
+  return ARRAYMORPH_FAIL;
+}
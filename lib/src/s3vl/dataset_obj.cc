@@ -1,45 +1,68 @@
 #include "arraymorph/s3vl/dataset_obj.h"
 #include "arraymorph/core/logger.h"
+#include "arraymorph/core/plan_stream.h"
+#include "arraymorph/core/planner.h"
+#include "arraymorph/core/shm_cache.h"
+#include "arraymorph/core/thread_pool.h"
+#include "arraymorph/core/tracer.h"
 #include "arraymorph/core/utils.h"
 #include <algorithm>
 #include <assert.h>
 #include <chrono>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <sstream>
-#include <sys/time.h>
 #include <thread>
-
-uint64_t transfer_size;
-int lambda_num, range_num, total_num;
+#include <unordered_set>
 
 S3VLDatasetObj::S3VLDatasetObj(const std::string &name, const std::string &uri,
                                hid_t dtype, int ndims,
                                std::vector<hsize_t> &shape,
                                std::vector<hsize_t> &chunk_shape, int chunk_num,
-                               const std::string &bucket_name,
-                               const CloudClient &client)
+                               std::shared_ptr<EndpointPool> endpoints,
+                               int key_stripes, std::vector<hsize_t> max_shape)
     : name(name), uri(uri), dtype(dtype), ndims(ndims), shape(shape),
-      chunk_shape(chunk_shape), chunk_num(chunk_num), bucket_name(bucket_name),
-      client(client) {
+      max_shape(max_shape.empty() ? shape : max_shape),
+      chunk_shape(chunk_shape), chunk_num(chunk_num),
+      key_stripes(std::clamp(key_stripes, 0, KEY_STRIPES_MAX)),
+      extensible(!max_shape.empty()), stored_shape(shape),
+      endpoints(std::move(endpoints)) {
   this->data_size = H5Tget_size(this->dtype);
+  this->stats = StatsRegistry::getInstance().dataset(uri);
+  size_t readahead_mb = READAHEAD_MB;
+  if (const char *env = getenv("ARRAYMORPH_READAHEAD_MB"))
+    readahead_mb = std::strtoull(env, nullptr, 10);
+  if (readahead_mb > 0)
+    cache = std::make_shared<ChunkCache>(readahead_mb << 20);
   Logger::log("Datasize: ", this->data_size);
   // data_size = 4;
+  layoutGrid();
+  assert(this->chunk_num == chunk_num);
+
+  element_per_chunk = 1;
+  for (auto &s : chunk_shape)
+    element_per_chunk *= s;
+}
+
+void S3VLDatasetObj::layoutGrid() {
   num_per_dim.resize(ndims);
   reduc_per_dim.resize(ndims);
   reduc_per_dim[ndims - 1] = 1;
+  // an extent of 0 (an empty dataset to append to) has no chunks
   for (int i = 0; i < ndims; i++)
-    num_per_dim[i] = (shape[i] - 1) / chunk_shape[i] + 1;
+    num_per_dim[i] = (shape[i] + chunk_shape[i] - 1) / chunk_shape[i];
   for (int i = ndims - 2; i >= 0; i--)
     reduc_per_dim[i] = reduc_per_dim[i + 1] * num_per_dim[i + 1];
-  assert(reduc_per_dim[0] * num_per_dim[0] == chunk_num);
+  chunk_num = reduc_per_dim[0] * num_per_dim[0];
+}
 
-  element_per_chunk = 1;
-  for (auto &s : chunk_shape)
-    element_per_chunk *= s;
+std::string S3VLDatasetObj::sharedKey(const std::string &chunk_key) const {
+  const StorageEndpoint &primary = endpoints->primary();
+  return primary.name + "|" + primary.bucket + "|" + chunk_key;
 }
 
-std::vector<hsize_t> S3VLDatasetObj::getChunkOffsets(int chunk_idx) {
+std::vector<hsize_t> S3VLDatasetObj::getChunkOffsets(int chunk_idx) const {
   std::vector<hsize_t> idx_per_dim(ndims);
   int tmp = chunk_idx;
 
@@ -56,7 +79,7 @@ std::vector<hsize_t> S3VLDatasetObj::getChunkOffsets(int chunk_idx) {
 }
 
 std::vector<std::vector<hsize_t>>
-S3VLDatasetObj::getChunkRanges(int chunk_idx) {
+S3VLDatasetObj::getChunkRanges(int chunk_idx) const {
   std::vector<hsize_t> offsets_per_dim = getChunkOffsets(chunk_idx);
   std::vector<std::vector<hsize_t>> re(ndims);
   for (int i = 0; i < ndims; i++)
@@ -66,242 +89,881 @@ S3VLDatasetObj::getChunkRanges(int chunk_idx) {
 
 std::vector<std::vector<hsize_t>>
 S3VLDatasetObj::selectionFromSpace(hid_t space_id) {
-  hsize_t start[ndims];
-  hsize_t end[ndims];
-  std::vector<std::vector<hsize_t>> ranges(ndims);
+  // a memory space may have another rank than the dataset
+  int rank = H5Sget_simple_extent_ndims(space_id);
+  if (rank <= 0)
+    return {};
+  hsize_t start[rank];
+  hsize_t end[rank];
+  std::vector<std::vector<hsize_t>> ranges(rank);
   H5Sget_select_bounds(space_id, start, end);
-  for (int i = 0; i < ndims; i++)
+  for (int i = 0; i < rank; i++)
     ranges[i] = {start[i], end[i]};
   // if (ndims >= 2)
   // 	swap(ranges[0], ranges[1]);
   return ranges;
 }
 
-void processAzure(std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
-                  const std::vector<CPlan> &azure_plans, void *buf,
-                  BlobContainerClient *client, const std::string &bucket_name) {
+herr_t
+S3VLDatasetObj::fileRanges(hid_t file_space_id,
+                           std::vector<std::vector<hsize_t>> &ranges) {
+  ranges.clear();
+  if (file_space_id != H5S_ALL) {
+    if (H5Sget_select_npoints(file_space_id) <= 0)
+      return ARRAYMORPH_SUCCESS;
+    ranges = selectionFromSpace(file_space_id);
+  } else {
+    for (int i = 0; i < ndims; i++) {
+      if (shape[i] == 0) {
+        ranges.clear();
+        return ARRAYMORPH_SUCCESS;
+      }
+      ranges.push_back({0, shape[i] - 1});
+    }
+  }
+  for (int i = 0; i < ndims; i++) {
+    if (ranges[i][1] >= shape[i]) {
+      Logger::error("------ Selection beyond the extent of", uri,
+                    "- call H5Dset_extent first");
+      ranges.clear();
+      return ARRAYMORPH_FAIL;
+    }
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+// the rows of a block held densely in C order
+static hsize_t denseLayout(const std::vector<std::vector<hsize_t>> &ranges,
+                           std::vector<hsize_t> &offsets) {
+  std::vector<std::vector<hsize_t>> local;
+  std::vector<hsize_t> box_shape;
+  for (auto &r : ranges) {
+    local.push_back({0, r[1] - r[0]});
+    box_shape.push_back(r[1] - r[0] + 1);
+  }
+  offsets = calSerialOffsets(local, box_shape);
+  return box_shape.back();
+}
+
+hsize_t
+S3VLDatasetObj::bufferLayout(hid_t mem_space_id,
+                             const std::vector<std::vector<hsize_t>> &ranges,
+                             std::vector<hsize_t> &offsets) {
+  if (mem_space_id == H5S_ALL) {
+    // memspace == dataspace
+    offsets = calSerialOffsets(ranges, shape);
+    return ranges[ndims - 1][1] - ranges[ndims - 1][0] + 1;
+  }
+  std::vector<std::vector<hsize_t>> buf_ranges =
+      selectionFromSpace(mem_space_id);
+  int rank = buf_ranges.size();
+  std::vector<hsize_t> buf_shape(rank);
+  H5Sget_simple_extent_dims(mem_space_id, buf_shape.data(), NULL);
+  if (rank == ndims) {
+    offsets = calSerialOffsets(buf_ranges, buf_shape);
+    return buf_ranges[ndims - 1][1] - buf_ranges[ndims - 1][0] + 1;
+  }
+  // another rank, e.g. h5py reading dset[i] into a 1-D array: only a run
+  // of consecutive elements as long as the selection maps element by
+  // element
+  hsize_t selected = 1, run = 1, start = 0;
+  bool dense = true;
+  for (auto &r : ranges)
+    selected *= r[1] - r[0] + 1;
+  for (int i = 0; i < rank; i++) {
+    hsize_t length = buf_ranges[i][1] - buf_ranges[i][0] + 1;
+    // once a dimension spans more than one element, the later ones are whole
+    if (run > 1 && length != buf_shape[i])
+      dense = false;
+    run *= length;
+    start = start * buf_shape[i] + buf_ranges[i][0];
+  }
+  if (!dense || run != selected ||
+      H5Sget_select_npoints(mem_space_id) != (hssize_t)selected) {
+    Logger::error("------ Memory selection of", uri,
+                  "with another rank than the dataset is not contiguous");
+    return 0;
+  }
+  hsize_t row_size = denseLayout(ranges, offsets);
+  for (auto &o : offsets)
+    o += start;
+  return row_size;
+}
+
+herr_t S3VLDatasetObj::boxRanges(const hsize_t *start, const hsize_t *count,
+                                 std::vector<std::vector<hsize_t>> &ranges) {
+  ranges.clear();
+  for (int i = 0; i < ndims; i++) {
+    if (count[i] == 0) {
+      ranges.clear();
+      return ARRAYMORPH_SUCCESS;
+    }
+    if (start[i] + count[i] > shape[i]) {
+      Logger::error("------ Selection beyond the extent of", uri,
+                    "- call H5Dset_extent first");
+      ranges.clear();
+      return ARRAYMORPH_FAIL;
+    }
+    ranges.push_back({start[i], start[i] + count[i] - 1});
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLDatasetObj::readBox(const hsize_t *start, const hsize_t *count,
+                               void *buf) {
+  std::vector<std::vector<hsize_t>> ranges;
+  if (boxRanges(start, count, ranges) < 0)
+    return ARRAYMORPH_FAIL;
+  if (ranges.empty())
+    return ARRAYMORPH_SUCCESS;
+  std::vector<hsize_t> offsets;
+  hsize_t row_size = denseLayout(ranges, offsets);
+  return read(ranges, offsets, row_size, buf, true);
+}
+
+herr_t S3VLDatasetObj::writeBox(const hsize_t *start, const hsize_t *count,
+                                const void *buf) {
+  std::vector<std::vector<hsize_t>> ranges;
+  if (boxRanges(start, count, ranges) < 0)
+    return ARRAYMORPH_FAIL;
+  if (ranges.empty())
+    return ARRAYMORPH_SUCCESS;
+  std::vector<hsize_t> offsets;
+  hsize_t row_size = denseLayout(ranges, offsets);
+  return write(ranges, offsets, row_size, buf);
+}
+
+std::list<std::vector<hsize_t>> S3VLDatasetObj::chunkMapping(
+    int chunk_idx, const std::vector<std::vector<hsize_t>> &ranges,
+    std::vector<hsize_t> &buf_offsets, hsize_t buf_row_size) const {
+  auto chunk = generateChunk(chunk_idx, ranges);
+  hsize_t chunk_row_size =
+      chunk->ranges[ndims - 1][1] - chunk->ranges[ndims - 1][0] + 1;
+  hsize_t element_size = data_size;
+  return mapHyperslab(chunk->local_offsets, chunk->global_offsets, buf_offsets,
+                      chunk_row_size, buf_row_size, element_size);
+}
+
+bool S3VLDatasetObj::needsMerge(
+    int chunk_idx,
+    const std::vector<std::vector<hsize_t>> &local_ranges) const {
+  std::vector<hsize_t> offsets = getChunkOffsets(chunk_idx);
+  bool partial = false;
+  for (int i = 0; i < ndims; i++) {
+    if (offsets[i] >= stored_shape[i])
+      return false; // nothing of it was ever written
+    // the part of the chunk inside the extent
+    hsize_t inside = std::min(chunk_shape[i], shape[i] - offsets[i]);
+    partial |= local_ranges[i][0] > 0 || local_ranges[i][1] + 1 < inside;
+  }
+  return partial;
+}
+
+herr_t S3VLDatasetObj::setExtent(const hsize_t *size) {
+  for (int i = 0; i < ndims; i++) {
+    if (size[i] < shape[i]) {
+      // the chunks past the new extent would stay in the store and show
+      // up again when it grows back
+      Logger::error("------ Cannot shrink", uri, "dimension", i, "from",
+                    shape[i], "to", size[i]);
+      return ARRAYMORPH_FAIL;
+    }
+    if (max_shape[i] != H5S_UNLIMITED && size[i] > max_shape[i]) {
+      Logger::error("------ Extent of", uri, "dimension", i, "exceeds",
+                    max_shape[i]);
+      return ARRAYMORPH_FAIL;
+    }
+  }
+  if (std::equal(shape.begin(), shape.end(), size))
+    return ARRAYMORPH_SUCCESS;
+  shape.assign(size, size + ndims);
+  layoutGrid();
+  is_modified = true;
+  Logger::log("------ Set extent:", to_string());
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLDatasetObj::refresh() {
+  if (is_modified) {
+    Logger::error("------ Cannot refresh", uri, "before flushing its extent");
+    return ARRAYMORPH_FAIL;
+  }
+  std::unique_ptr<S3VLDatasetObj> stored(
+      getDatasetObj(endpoints, uri + "/meta"));
+  if (!stored)
+    return ARRAYMORPH_FAIL;
+  if (stored->ndims != ndims || stored->chunk_shape != chunk_shape) {
+    Logger::error("------ Stored layout of", uri, "changed");
+    return ARRAYMORPH_FAIL;
+  }
+  // open attributes keep the entries they were opened with
+  attrs = std::move(stored->attrs);
+  next_attr_id = std::max(next_attr_id, stored->next_attr_id);
+  if (stored->shape == shape)
+    return ARRAYMORPH_SUCCESS;
+  shape = stored->shape;
+  layoutGrid();
+  for (int i = 0; i < ndims; i++)
+    stored_shape[i] = std::max(stored_shape[i], shape[i]);
+  // the chunks at the old edge may have been filled in since
+  if (cache)
+    cache = std::make_shared<ChunkCache>(cache->capacity);
+  Logger::log("------ Refreshed extent:", to_string());
+  return ARRAYMORPH_SUCCESS;
+}
+
+// blocking transports run on the shared I/O pool: every segment is queued
+// as soon as its chunk is planned and a slot of the endpoint's window is
+// free, and the pool bounds how many run at once. The process* functions
+// issue the chunks `stream` hands out, whose plans are in `plans` at the
+// same index, and return how many requests failed.
+static void takeSlot(ConcurrencyController *limiter) {
+  if (limiter)
+    while (!limiter->waitAcquire(std::chrono::microseconds(WAIT_SLICE_US)))
+      ;
+}
+
+size_t processAzure(std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
+                    const std::vector<CPlan> &azure_plans, PlanStream &stream,
+                    void *buf, BlobContainerClient *client,
+                    const std::string &bucket_name,
+                    ConcurrencyController *limiter, IOStats *stats,
+                    std::shared_ptr<Reducer> reducer = nullptr) {
+  ThreadPool &pool = ThreadPool::getInstance();
   std::vector<std::future<herr_t>> futures;
-  size_t azure_thread_num = THREAD_NUM;
-  futures.reserve(azure_thread_num);
-  size_t cur_batch_size = 0;
 
-  for (int i = 0; i < azure_plans.size(); i++) {
+  size_t i;
+  while (stream.next(i)) {
     const CPlan &p = azure_plans[i];
-    if (cur_batch_size != 0 &&
-        (cur_batch_size + p.num_requests > azure_thread_num)) {
-      while (OperationTracker::getInstance().get() < cur_batch_size)
-        ;
-      cur_batch_size = 0;
-      for (auto &fut : futures)
-        fut.wait();
-      futures.clear();
-    }
     for (auto &s : p.segments) {
       std::vector<std::vector<hsize_t>> mapping;
       for (auto it = s->mapping_start; it != s->mapping_end; ++it)
-        mapping.push_back({(*it)[0], (*it)[1], (*it)[2]});
-      for (auto &m : mapping)
-        m[0] -= s->start_offset;
+        mapping.push_back({(*it)[0] - s->start_offset, (*it)[1], (*it)[2]});
+      // before the context stamps its issue time, as for S3
+      takeSlot(limiter);
       auto context = std::make_shared<AsyncReadInput>(buf, mapping);
-      futures.push_back(std::async(std::launch::async, Operators::AzureGetRange,
-                                   client, chunk_objs[i]->uri, s->start_offset,
-                                   s->end_offset, context));
-      cur_batch_size++;
-      transfer_size += s->end_offset - s->start_offset + 1;
+      context->reducer = reducer;
+      context->stats = stats;
+      context->limiter = limiter;
+      const std::string &uri = chunk_objs[i]->uri;
+      uint64_t beg = s->start_offset, end = s->end_offset;
+      futures.push_back(pool.submit([client, &uri, beg, end, context] {
+        return Operators::AzureGetRange(client, uri, beg, end, context);
+      }));
     }
   }
+  size_t failed = 0;
   for (auto &fut : futures)
-    fut.wait();
-  futures.clear();
+    failed += fut.get() < 0;
+  return failed;
+}
+
+// a GET or range GET of the current batch that may still be hedged
+struct PendingGet {
+  std::shared_ptr<AsyncReadInput> context;
+  const std::string *key;
+  uint64_t beg, end;
+  bool whole;
+};
+
+static void issueGet(Aws::S3::S3Client *s3_client,
+                     const std::string &bucket_name, const PendingGet &g,
+                     std::shared_ptr<AsyncReadInput> context) {
+  if (g.whole)
+    Operators::S3GetAsync(s3_client, bucket_name, *g.key, context);
+  else
+    Operators::S3GetByteRangeAsync(s3_client, bucket_name, *g.key, g.beg,
+                                   g.end, context);
 }
 
-void processS3(std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
-               const std::vector<CPlan> &s3_plans, void *buf,
-               Aws::S3::S3Client *s3_client, const std::string &bucket_name) {
-  size_t s3_thread_num = THREAD_NUM;
-  size_t cur_batch_size = 0;
-  OperationTracker::getInstance().reset();
-  for (int i = 0; i < s3_plans.size(); i++) {
+// send one duplicate of every read outstanding for longer than the hedge
+// threshold, budget permitting; finished reads are dropped from `pending`
+static void hedgeSlow(std::vector<PendingGet> &pending,
+                      Aws::S3::S3Client *s3_client,
+                      const std::string &bucket_name,
+                      std::chrono::steady_clock::time_point now) {
+  HedgePolicy &policy = HedgePolicy::getInstance();
+  pending.erase(std::remove_if(pending.begin(), pending.end(),
+                               [](const PendingGet &g) {
+                                 return g.context->state->done.load();
+                               }),
+                pending.end());
+  CostModel &model = CostModel::getInstance();
+  for (auto &g : pending) {
+    RequestState &state = *g.context->state;
+    if (state.hedged.load())
+      continue;
+    double limit = policy.threshold(model.cost(1, g.end - g.beg + 1));
+    if (std::chrono::duration<double>(now - g.context->issued).count() < limit)
+      continue;
+    if (!policy.tryHedge())
+      break;
+    state.hedged = true;
+    state.outstanding.fetch_add(1);
+    auto hedge =
+        std::make_shared<AsyncReadInput>(g.context->buf, g.context->mapping);
+    hedge->reducer = g.context->reducer;
+    hedge->stats = g.context->stats;
+    hedge->state = g.context->state;
+    hedge->batch = g.context->batch;
+    hedge->hedge = true;
+    // duplicates are admitted past the window, paid from the hedge budget,
+    // but count as in flight while they run so the window sees their load
+    hedge->limiter = g.context->limiter;
+    if (hedge->limiter)
+      hedge->limiter->acquire();
+    hedge->statsOrProcess().hedge();
+    if (Tracer::enabled())
+      Tracer::getInstance().instant("hedge", "request",
+                                    TraceArgs().add("key", *g.key));
+    issueGet(s3_client, bucket_name, g, hedge);
+  }
+}
+
+// sleep until `ready(timeout)`, which blocks up to `timeout`, holds; the
+// slow reads of `pending` are hedged every HEDGE_SCAN_US meanwhile
+template <typename Ready>
+static void waitFor(Ready ready, std::vector<PendingGet> &pending,
+                    Aws::S3::S3Client *s3_client,
+                    const std::string &bucket_name) {
+  HedgePolicy &policy = HedgePolicy::getInstance();
+  auto scan = std::chrono::microseconds(HEDGE_SCAN_US);
+  auto slice = std::chrono::microseconds(WAIT_SLICE_US);
+  while (true) {
+    bool hedging = policy.enabled() && !pending.empty();
+    if (ready(hedging ? scan : slice))
+      return;
+    if (hedging)
+      hedgeSlow(pending, s3_client, bucket_name,
+                std::chrono::steady_clock::now());
+  }
+}
+
+// requests are sent as soon as the endpoint's window has room, so the
+// number in flight follows the ConcurrencyController instead of a fixed
+// batch size
+size_t processS3(std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
+                 const std::vector<CPlan> &s3_plans, PlanStream &stream,
+                 void *buf, Aws::S3::S3Client *s3_client,
+                 const std::string &bucket_name,
+                 ConcurrencyController *limiter, IOStats *stats,
+                 std::shared_ptr<Reducer> reducer = nullptr) {
+  auto batch = std::make_shared<ReadBatch>();
+  size_t issued = 0;
+  std::vector<PendingGet> pending;
+  auto slot = [&](ConcurrencyController *limiter) {
+    if (limiter)
+      waitFor([limiter](std::chrono::microseconds timeout) {
+        return limiter->waitAcquire(timeout);
+      }, pending, s3_client, bucket_name);
+  };
+  size_t i;
+  while (stream.next(i)) {
     const CPlan &p = s3_plans[i];
-    if (cur_batch_size != 0 &&
-        (cur_batch_size + p.num_requests > s3_thread_num)) {
-      while (OperationTracker::getInstance().get() < cur_batch_size)
-        ;
-      cur_batch_size = 0;
-      OperationTracker::getInstance().reset();
-    }
     for (auto &s : p.segments) {
       std::vector<std::vector<hsize_t>> mapping;
       for (auto it = s->mapping_start; it != s->mapping_end; ++it)
         mapping.push_back({(*it)[0], (*it)[1], (*it)[2]});
+      if (p.qp == QPlan::PUSHDOWN) {
+        // the executor returns the selected bytes back to back
+        std::vector<std::vector<hsize_t>> packed = mapping;
+        hsize_t packed_offset = 0;
+        for (auto &m : packed) {
+          m[0] = packed_offset;
+          packed_offset += m[2];
+        }
+        // wait before the context stamps its issue time, so time spent
+        // queued for the window is not taken for request latency
+        slot(pushdown_concurrency);
+        auto context = std::make_shared<AsyncReadInput>(
+            buf, packed, 1, bucket_name, chunk_objs[i]->uri, mapping);
+        context->reducer = reducer;
+        context->stats = stats;
+        context->state = std::make_shared<RequestState>();
+        context->batch = batch;
+        context->limiter = pushdown_concurrency;
+        context->fallback_client = s3_client;
+        context->fallback_limiter = limiter;
+        Operators::S3PushdownAsync(pushdown_client.get(), bucket_name,
+                                   chunk_objs[i]->uri, p.lambda_query,
+                                   context);
+        issued++;
+        continue;
+      }
       for (auto &m : mapping)
         m[0] -= s->start_offset;
+      slot(limiter);
       auto context = std::make_shared<AsyncReadInput>(buf, mapping);
-      Operators::S3GetByteRangeAsync(s3_client, bucket_name, chunk_objs[i]->uri,
-                                     s->start_offset, s->end_offset, context);
-      cur_batch_size++;
-      transfer_size += s->end_offset - s->start_offset + 1;
+      context->reducer = reducer;
+      context->stats = stats;
+      context->state = std::make_shared<RequestState>();
+      context->batch = batch;
+      context->limiter = limiter;
+      PendingGet g{context, &chunk_objs[i]->uri, s->start_offset,
+                   s->end_offset, p.qp == QPlan::GET};
+      issueGet(s3_client, bucket_name, g, context);
+      HedgePolicy::getInstance().issued();
+      pending.push_back(std::move(g));
+      issued++;
     }
   }
-  while (OperationTracker::getInstance().get() < cur_batch_size)
-    ;
+  waitFor([&](std::chrono::microseconds timeout) {
+    return batch->wait(issued, timeout);
+  }, pending, s3_client, bucket_name);
+  return batch->failed.load(std::memory_order_relaxed);
+}
+
+size_t processFile(std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
+                   const std::vector<CPlan> &file_plans, PlanStream &stream,
+                   void *buf, FileClient *client,
+                   const std::string &bucket_name,
+                   ConcurrencyController *limiter, IOStats *stats,
+                   std::shared_ptr<Reducer> reducer = nullptr) {
+  ThreadPool &pool = ThreadPool::getInstance();
+  std::vector<std::future<herr_t>> futures;
+
+  size_t i;
+  while (stream.next(i)) {
+    const CPlan &p = file_plans[i];
+    for (auto &s : p.segments) {
+      std::vector<std::vector<hsize_t>> mapping;
+      for (auto it = s->mapping_start; it != s->mapping_end; ++it)
+        mapping.push_back({(*it)[0] - s->start_offset, (*it)[1], (*it)[2]});
+      // before the context stamps its issue time, as for S3
+      takeSlot(limiter);
+      auto context = std::make_shared<AsyncReadInput>(buf, mapping);
+      context->reducer = reducer;
+      context->stats = stats;
+      context->limiter = limiter;
+      const std::string &uri = chunk_objs[i]->uri;
+      uint64_t beg = s->start_offset, end = s->end_offset;
+      futures.push_back(
+          pool.submit([client, &bucket_name, &uri, beg, end, context] {
+            return Operators::FileGetRange(client, bucket_name, uri, beg, end,
+                                           context);
+          }));
+    }
+  }
+  size_t failed = 0;
+  for (auto &fut : futures)
+    failed += fut.get() < 0;
+  return failed;
+}
+
+// issue the plans on the configured storage platform as they are handed
+// out; returns how many requests failed
+size_t processPlans(StorageEndpoint &endpoint,
+                    std::vector<std::shared_ptr<S3VLChunkObj>> &chunk_objs,
+                    const std::vector<CPlan> &plans, PlanStream &stream,
+                    void *buf, IOStats *stats,
+                    std::shared_ptr<Reducer> reducer = nullptr) {
+  const CloudClient &client = endpoint.client;
+  if (SP == SPlan::AZURE_BLOB) {
+    auto azure_client =
+        std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
+    return processAzure(chunk_objs, plans, stream, buf, azure_client->get(),
+                        endpoint.bucket, endpoint.concurrency, stats, reducer);
+  } else if (SP == SPlan::LOCAL_FILE) {
+    auto file_client = std::get_if<std::unique_ptr<FileClient>>(&client);
+    return processFile(chunk_objs, plans, stream, buf, file_client->get(),
+                       endpoint.bucket, endpoint.concurrency, stats, reducer);
+  } else {
+    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+    return processS3(chunk_objs, plans, stream, buf, s3_client->get(),
+                     endpoint.bucket, endpoint.concurrency, stats, reducer);
+  }
+}
+
+static uint64_t planRequests(const std::vector<CPlan> &plans) {
+  uint64_t n = 0;
+  for (auto &p : plans)
+    n += p.num_requests;
+  return n;
+}
+
+// charge a finished chunk upload to `stats` and to the endpoint's window
+static void recordPut(IOStats *stats, const std::string &key, size_t bytes,
+                      std::chrono::steady_clock::time_point start,
+                      herr_t status, ConcurrencyController *limiter) {
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  if (status < 0)
+    stats->failure();
+  else
+    stats->request(bytes, elapsed.count());
+  if (limiter) {
+    if (status < 0)
+      limiter->release();
+    else
+      limiter->release(bytes, elapsed.count());
+  }
+  if (Tracer::enabled())
+    Tracer::getInstance().span(
+        status < 0 ? "PUT failed" : "PUT", "request", start, end,
+        TraceArgs().add("key", key).add("bytes", static_cast<uint64_t>(bytes)));
+}
+
+// run one chunk upload and charge it to `stats`
+static herr_t timedPut(IOStats *stats, const std::string &key, size_t bytes,
+                       const std::function<herr_t()> &put,
+                       ConcurrencyController *limiter = nullptr) {
+  if (limiter)
+    limiter->acquire();
+  auto start = std::chrono::steady_clock::now();
+  herr_t status = put();
+  recordPut(stats, key, bytes, start, status, limiter);
+  return status;
 }
 
 herr_t S3VLDatasetObj::read(hid_t mem_space_id, hid_t file_space_id,
                             void *buf) {
-
   // string lambda_merge_path = getenv("AWS_LAMBDA_MERGE_ACCESS_POINT");
   std::vector<std::vector<hsize_t>> ranges;
-  if (file_space_id != H5S_ALL) {
-    ranges = selectionFromSpace(file_space_id);
-  } else {
-    for (int i = 0; i < ndims; i++)
-      ranges.push_back({0, shape[i] - 1});
+  if (fileRanges(file_space_id, ranges) < 0)
+    return ARRAYMORPH_FAIL;
+  if (ranges.empty())
+    return ARRAYMORPH_SUCCESS;
+  std::vector<hsize_t> out_offsets;
+  hsize_t out_row_size = bufferLayout(mem_space_id, ranges, out_offsets);
+  if (!out_row_size)
+    return ARRAYMORPH_FAIL;
+  return read(ranges, out_offsets, out_row_size, buf, true);
+}
+
+herr_t S3VLDatasetObj::read(const std::vector<std::vector<hsize_t>> &ranges,
+                            std::vector<hsize_t> &out_offsets,
+                            hsize_t out_row_size, void *buf,
+                            bool detect_readahead) {
+  TraceSpan span("H5Dread", "dataset");
+  auto read_start = std::chrono::steady_clock::now();
+  std::vector<int> chunks = accessedChunks(ranges);
+  size_t num = chunks.size();
+
+  // everything else is per chunk and runs on the planner pool: the chunk's
+  // layout, its mapping into buf, the readahead buffer lookup and the plan.
+  // Requests for the first chunks go out while later ones are planned.
+  // with the node-wide cache, chunks no process has yet are fetched whole,
+  // so that the others can use them; waiting for those is not a sign that
+  // readahead lags. Chunks larger than a slot could not be shared, so their
+  // demand reads fetch only what is selected.
+  SharedChunkCache *shared = SharedChunkCache::getInstance();
+  std::unordered_set<int> fetched_whole;
+  if (shared && cache && element_per_chunk * data_size <= shared->slotBytes()) {
+    std::vector<int> missing;
+    for (int c : chunks)
+      if (!shared->contains(sharedKey(chunkKey(c))))
+        missing.push_back(c);
+    fetchAhead(missing);
+    fetched_whole.insert(missing.begin(), missing.end());
   }
 
-  auto chunk_objs = generateChunks(ranges);
-  int num = chunk_objs.size();
-  std::vector<std::vector<std::unique_ptr<Segment>>> segments(num);
-  std::vector<hsize_t> out_offsets;
-  hsize_t out_row_size;
+  std::vector<std::shared_ptr<S3VLChunkObj>> chunk_objs(num);
   std::vector<std::list<std::vector<hsize_t>>> global_mapping(num);
-  if (mem_space_id == H5S_ALL) {
-    // memspace == dataspace
-    out_offsets = calSerialOffsets(ranges, shape);
-    // out_row_size = ranges[0][1] - ranges[0][0] + 1;
-    out_row_size = ranges[ndims - 1][1] - ranges[ndims - 1][0] + 1;
-  } else {
-    std::vector<std::vector<hsize_t>> out_ranges =
-        selectionFromSpace(mem_space_id);
-    hsize_t dims_out[ndims];
-    H5Sget_simple_extent_dims(mem_space_id, dims_out, NULL);
-    std::vector<hsize_t> out_shape(dims_out, dims_out + ndims);
-    // if (ndims >= 2)
-    // 	swap(out_shape[0], out_shape[1]);
-    out_offsets = calSerialOffsets(out_ranges, out_shape);
-    // out_row_size = out_ranges[0][1] - out_ranges[0][0] + 1;
-    out_row_size = out_ranges[ndims - 1][1] - out_ranges[ndims - 1][0] + 1;
-  }
-  for (int i = 0; i < num; i++) {
-    // hsize_t input_row_size = chunk_objs[i]->ranges[0][1] -
-    // chunk_objs[i]->ranges[0][0] + 1;
-    hsize_t input_row_size = chunk_objs[i]->ranges[ndims - 1][1] -
-                             chunk_objs[i]->ranges[ndims - 1][0] + 1;
-    global_mapping[i] = mapHyperslab(chunk_objs[i]->local_offsets,
-                                     chunk_objs[i]->global_offsets, out_offsets,
-                                     input_row_size, out_row_size, data_size);
-    segments[i] = generateSegments(global_mapping[i], chunk_objs[i]->size);
-  }
-
-  transfer_size = 0;
-  lambda_num = 0;
-  range_num = 0;
-
-  // cout << "start plan" << endl;
-  struct timeval start_opt, end_opt;
-  gettimeofday(&start_opt, NULL);
-  std::vector<CPlan> plans;
-  plans.reserve(chunk_objs.size());
-
-  for (int i = 0; i < chunk_objs.size(); i++) {
-    plans.emplace_back(i, GET, segments[i].size(), std::move(segments[i]));
-  }
-  gettimeofday(&end_opt, NULL);
-  double opt_t = (1000000 * (end_opt.tv_sec - start_opt.tv_sec) +
-                  end_opt.tv_usec - start_opt.tv_usec) /
-                 1000000.0;
-  assert(plans.size() == num);
+  std::vector<CPlan> plans(num);
+  std::atomic<bool> waited{false};
+  PlanStream stream(num, [&](size_t i) {
+    auto &chunk = chunk_objs[i];
+    chunk = generateChunk(chunks[i], ranges);
+    hsize_t input_row_size =
+        chunk->ranges[ndims - 1][1] - chunk->ranges[ndims - 1][0] + 1;
+    global_mapping[i] =
+        mapHyperslab(chunk->local_offsets, chunk->global_offsets, out_offsets,
+                     input_row_size, out_row_size, data_size);
+
+    // chunks fetched ahead are copied out here; the rest are planned
+    bool chunk_waited = false;
+    ChunkCache::Data data =
+        cache ? cache->get(chunk->uri, &chunk_waited) : nullptr;
+    if (data) {
+      if (chunk_waited && !fetched_whole.count(chunks[i]))
+        waited = true;
+      for (auto &m : global_mapping[i])
+        memcpy((char *)buf + m[1], data->data() + m[0], m[2]);
+      stats->cacheHit(chunk->required_size);
+      return false;
+    }
+    if (shared &&
+        shared->read(sharedKey(chunk->uri), element_per_chunk * data_size,
+                     [&](const char *bytes) {
+                       for (auto &m : global_mapping[i])
+                         memcpy((char *)buf + m[1], bytes + m[0], m[2]);
+                     })) {
+      stats->cacheHit(chunk->required_size);
+      return false;
+    }
+    if (cache || shared)
+      stats->cacheMiss();
+
+    std::vector<std::unique_ptr<Segment>> segments;
+    QPlan qp = planChunk(global_mapping[i], chunk->size, segments);
+    hsize_t planned_bytes = 0;
+    for (auto &s : segments)
+      planned_bytes += s->end_offset - s->start_offset + 1;
+    if (qp == QPlan::PUSHDOWN)
+      planned_bytes = chunk->required_size;
+    PlannerStats::getInstance().add(qp, segments.size(), planned_bytes,
+                                    chunk->required_size);
+    plans[i] = CPlan(i, qp, segments.size(), std::move(segments));
+    if (qp == QPlan::PUSHDOWN)
+      plans[i].lambda_query =
+          createQuery(data_size, ndims, chunk->shape, chunk->ranges);
+    return true;
+  });
+
+  // a store that fails requests hands the read to the next replica; the
+  // plans are only re-issued, the answered parts are simply fetched again
+  std::vector<const StorageEndpoint *> tried;
+  bool served = false;
+  while (StorageEndpoint *endpoint = endpoints->pick(tried)) {
+    size_t failed =
+        processPlans(*endpoint, chunk_objs, plans, stream, buf, stats);
+    if (!failed) {
+      endpoints->succeeded(*endpoint);
+      served = true;
+      break;
+    }
+    endpoints->failed(*endpoint);
+    tried.push_back(endpoint);
+    Logger::warn("------ Read", uri, ":", failed, "requests failed on",
+                 endpoint->name);
+    stream.rewind();
+  }
+  stream.wait();
+  if (!served) {
+    Logger::error("------ Read", uri, ": every store failed");
+    return ARRAYMORPH_FAIL;
+  }
+
+  // chunk enumeration, mapping and plan choice, overlapped with the I/O
+  std::chrono::duration<double> plan_t = stream.finished - read_start;
+  stats->plan(plan_t.count());
+  if (span.active)
+    Tracer::getInstance().span("plan", "dataset", read_start, stream.finished,
+                               TraceArgs()
+                                   .add("chunks", static_cast<uint64_t>(num))
+                                   .add("requests", planRequests(plans)));
+  if (Logger::enabled(LogLevel::TRACE)) {
+    Logger::trace("------ Plans:");
+    for (auto &p : plans) {
+      if (p.chunk_id < 0)
+        continue;
+      Logger::trace("chunk: ", chunk_objs[p.chunk_id]->uri);
+      Logger::trace("plan: ", queryPlanName(p.qp), "requests: ",
+                    p.num_requests);
+    }
+  }
+  if (cache && detect_readahead)
+    readahead(ranges, waited.load());
+  hsize_t required = 0;
+  for (auto &c : chunk_objs)
+    required += c->required_size;
+  std::chrono::duration<double> read_t =
+      std::chrono::steady_clock::now() - read_start;
+  stats->read(required, read_t.count());
+  if (span.active)
+    span.args.add("uri", uri)
+        .add("chunks", static_cast<uint64_t>(num))
+        .add("bytes", static_cast<uint64_t>(required));
 #ifdef PROFILE_ENABLE
-  std::cout << "query processer time: " << opt_t << std::endl;
-  std::cout << "chunk num:" << num << std::endl;
+  std::cout << "read " << uri << ": " << stats->toJson() << std::endl;
 #endif
-  // cout << "get plans" << endl;
-#ifdef LOG_ENABLE
-  Logger::log("------ Plans:");
-  for (int i = 0; i < num; i++) {
-    Logger::log("chunk: ", chunk_objs[i]->uri);
-    Logger::log("plan: ", plans[i].qp);
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLDatasetObj::reduce(hid_t file_space_id, ReduceResult &result) {
+  TraceSpan span("reduce", "dataset");
+  auto reduce_start = std::chrono::steady_clock::now();
+  auto reducer = std::make_shared<Reducer>(dtype);
+  if (!reducer->supported()) {
+    Logger::error("------ Cannot reduce", uri, ": unsupported data type");
+    return ARRAYMORPH_FAIL;
   }
-#endif
-  assert(num == plans.size());
+  std::vector<std::vector<hsize_t>> ranges;
+  if (fileRanges(file_space_id, ranges) < 0)
+    return ARRAYMORPH_FAIL;
+  if (ranges.empty())
+    return ARRAYMORPH_SUCCESS;
 
-  // std::sort(plans.begin(), plans.end(), [](const CPlan &a, const CPlan &b) {
-  // 	return a.qp < b.qp;
-  // });
+  // only chunk offsets matter: responses are folded, never scattered
+  std::vector<int> chunks = accessedChunks(ranges);
+  size_t num = chunks.size();
+  std::vector<std::shared_ptr<S3VLChunkObj>> chunk_objs(num);
+  std::vector<std::list<std::vector<hsize_t>>> mappings(num);
+  std::vector<CPlan> plans(num);
+  PlanStream stream(num, [&](size_t i) {
+    auto &chunk = chunk_objs[i];
+    chunk = generateChunk(chunks[i], ranges);
+    hsize_t row_size =
+        (chunk->ranges[ndims - 1][1] - chunk->ranges[ndims - 1][0] + 1) *
+        data_size;
+    for (auto &o : chunk->local_offsets)
+      mappings[i].push_back({o * data_size, 0, row_size});
+    std::vector<std::unique_ptr<Segment>> segments;
+    QPlan qp = planChunk(mappings[i], chunk->size, segments);
+    plans[i] = CPlan(i, qp, segments.size(), std::move(segments));
+    if (qp == QPlan::PUSHDOWN)
+      plans[i].lambda_query =
+          createQuery(data_size, ndims, chunk->shape, chunk->ranges);
+    return true;
+  });
 
-#ifdef PROFILE_ENABLE
-  std::cout << "Plans: " << std::endl;
-  std::cout << "total num: " << plans.size() << std::endl;
-#endif
-  if (SP == AZURE_BLOB) {
-    auto azure_client =
-        std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
-    processAzure(chunk_objs, plans, buf, azure_client->get(), bucket_name);
-  } else {
-    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
-    processS3(chunk_objs, plans, buf, s3_client->get(), bucket_name);
+  // partial sums cannot be taken back, so a reduction is not retried on
+  // another replica
+  StorageEndpoint &endpoint = *endpoints->pick();
+  size_t failed = processPlans(endpoint, chunk_objs, plans, stream, nullptr,
+                               stats, reducer);
+  if (failed)
+    endpoints->failed(endpoint);
+  else
+    endpoints->succeeded(endpoint);
+  stream.wait();
+  if (failed) {
+    Logger::error("------ Reduce", uri, ":", failed, "requests failed on",
+                  endpoint.name);
+    return ARRAYMORPH_FAIL;
   }
-#ifdef PROFILE_ENABLE
-  std::cout << "transfer_size: " << transfer_size << std::endl;
-#endif
+
+  std::chrono::duration<double> plan_t = stream.finished - reduce_start;
+  stats->plan(plan_t.count());
+  if (span.active)
+    Tracer::getInstance().span(
+        "plan", "dataset", reduce_start, stream.finished,
+        TraceArgs()
+            .add("chunks", static_cast<uint64_t>(num))
+            .add("requests", planRequests(plans)));
+  result = reducer->result();
+  hsize_t required = 0;
+  for (auto &c : chunk_objs)
+    required += c->required_size;
+  std::chrono::duration<double> reduce_t =
+      std::chrono::steady_clock::now() - reduce_start;
+  stats->read(required, reduce_t.count());
+  if (span.active)
+    span.args.add("uri", uri).add("bytes", static_cast<uint64_t>(required));
+  Logger::log("------ Reduce: count", result.count, "sum", result.sum);
   return ARRAYMORPH_SUCCESS;
 }
 
 herr_t S3VLDatasetObj::write(hid_t mem_space_id, hid_t file_space_id,
                              const void *buf) {
   std::vector<std::vector<hsize_t>> ranges;
-  if (file_space_id != H5S_ALL) {
-    ranges = selectionFromSpace(file_space_id);
-  } else {
-    for (int i = 0; i < ndims; i++)
-      ranges.push_back({0, shape[i] - 1});
-  }
+  if (fileRanges(file_space_id, ranges) < 0)
+    return ARRAYMORPH_FAIL;
+  if (ranges.empty())
+    return ARRAYMORPH_SUCCESS;
+  std::vector<hsize_t> source_offsets;
+  hsize_t source_row_size =
+      bufferLayout(mem_space_id, ranges, source_offsets);
+  if (!source_row_size)
+    return ARRAYMORPH_FAIL;
+  return write(ranges, source_offsets, source_row_size, buf);
+}
+
+herr_t S3VLDatasetObj::write(const std::vector<std::vector<hsize_t>> &ranges,
+                             std::vector<hsize_t> &source_offsets,
+                             hsize_t source_row_size, const void *buf) {
+  TraceSpan span("H5Dwrite", "dataset");
+  auto write_start = std::chrono::steady_clock::now();
+  std::vector<int> chunks = accessedChunks(ranges);
+  size_t num = chunks.size();
 
-  auto chunk_objs = generateChunks(ranges);
-  int num = chunk_objs.size();
+  // replicas are kept in sync by the stores: writes go to the primary
+  StorageEndpoint &primary = endpoints->primary();
+  const CloudClient &client = primary.client;
+  const std::string &bucket_name = primary.bucket;
+  ConcurrencyController *limiter = primary.concurrency;
+
+  // each chunk's layout and its mapping from buf are computed on the
+  // planner pool; uploads start with the first chunks planned. An object
+  // store replaces whole chunks, so a chunk written only in part, e.g. the
+  // tail of an append, starts from its stored copy, fetched on the I/O
+  // pool. The file store writes the extents in place.
+  std::vector<std::shared_ptr<S3VLChunkObj>> chunk_objs(num);
   std::vector<std::list<std::vector<hsize_t>>> mappings(num);
-  std::vector<hsize_t> source_offsets;
-  hsize_t source_row_size;
-  if (mem_space_id == H5S_ALL) {
-    // memspace == dataspace
-    source_offsets = calSerialOffsets(ranges, shape);
-    // source_row_size = ranges[0][1] - ranges[0][0] + 1;
-    source_row_size = ranges[ndims - 1][1] - ranges[ndims - 1][0] + 1;
-  } else {
-    std::vector<std::vector<hsize_t>> source_ranges =
-        selectionFromSpace(mem_space_id);
-    hsize_t dims_source[ndims];
-    H5Sget_simple_extent_dims(mem_space_id, dims_source, NULL);
-    std::vector<hsize_t> source_shape(dims_source, dims_source + ndims);
-    // if (ndims >= 2)
-    // 	swap(source_shape[0], source_shape[1]);
-    source_offsets = calSerialOffsets(source_ranges, source_shape);
-    // source_row_size = source_ranges[0][1] - source_ranges[0][0] + 1;
-    source_row_size =
-        source_ranges[ndims - 1][1] - source_ranges[ndims - 1][0] + 1;
-  }
-
-  for (int i = 0; i < num; i++) {
-    // hsize_t dest_row_size = chunk_objs[i]->ranges[0][1] -
-    // chunk_objs[i]->ranges[0][0] + 1;
-    hsize_t dest_row_size = chunk_objs[i]->ranges[ndims - 1][1] -
-                            chunk_objs[i]->ranges[ndims - 1][0] + 1;
-    mappings[i] = mapHyperslab(chunk_objs[i]->local_offsets,
-                               chunk_objs[i]->global_offsets, source_offsets,
-                               dest_row_size, source_row_size, data_size);
-  }
+  std::vector<Result> stored(num);
+  std::vector<std::future<herr_t>> merges(num);
+  PlanStream stream(num, [&](size_t i) {
+    auto &chunk = chunk_objs[i];
+    chunk = generateChunk(chunks[i], ranges);
+    // chunks fetched ahead would be stale after this write
+    if (cache)
+      cache->erase(chunk->uri);
+    if (SharedChunkCache *shared = SharedChunkCache::getInstance())
+      shared->erase(sharedKey(chunk->uri));
+    hsize_t dest_row_size =
+        chunk->ranges[ndims - 1][1] - chunk->ranges[ndims - 1][0] + 1;
+    mappings[i] =
+        mapHyperslab(chunk->local_offsets, chunk->global_offsets,
+                     source_offsets, dest_row_size, source_row_size, data_size);
+    if (SP == SPlan::LOCAL_FILE || !needsMerge(chunks[i], chunk->ranges))
+      return true;
+    merges[i] = ThreadPool::getInstance().submit(
+        [this, &primary, &key = chunk->uri, &re = stored[i],
+         length = chunk->size] {
+          auto start = std::chrono::steady_clock::now();
+          try {
+            re = getObject(primary, key);
+          } catch (const std::exception &e) {
+            Logger::error("------ GET", key, e.what());
+            re = Result();
+            re.status = ARRAYMORPH_FAIL;
+          }
+          if (re.missing) {
+            // not stored yet
+            re.data.clear();
+            return ARRAYMORPH_SUCCESS;
+          }
+          if (re.status < 0 || re.data.size() != length) {
+            // merging into zeros would overwrite what is stored
+            Logger::error("------ Cannot merge the write into", key);
+            re.data.clear();
+            return ARRAYMORPH_FAIL;
+          }
+          std::chrono::duration<double> elapsed =
+              std::chrono::steady_clock::now() - start;
+          stats->request(length, elapsed.count());
+          return ARRAYMORPH_SUCCESS;
+        });
+    return true;
+  });
 
   std::vector<std::future<herr_t>> futures;
-  futures.reserve(THREAD_NUM);
-  int cur_batch = 0;
-
-  while (cur_batch < num) {
-    for (int idx = cur_batch; idx < std::min(num, cur_batch + THREAD_NUM);
-         idx++) {
+  // the chunk of each future, and which chunks were stored
+  std::vector<size_t> put_chunks;
+  std::vector<bool> put_ok(num, false);
+  size_t idx;
+  bool more = true;
+  while (more) {
+    // one window of uploads at a time, sized again for every batch
+    int batch = limiter ? limiter->window() : 1;
+    for (int k = 0; k < batch && (more = stream.next(idx)); k++) {
       size_t length = chunk_objs[idx]->size;
+      if (merges[idx].valid() && merges[idx].get() < 0)
+        continue; // the chunk is not stored, and counts as failed
+      put_chunks.push_back(idx);
+      if (SP == SPlan::LOCAL_FILE) {
+        // no staging copy: extents are written in place, in parallel
+        auto file_client = std::get_if<std::unique_ptr<FileClient>>(&client);
+        FileClient *fc = file_client->get();
+        const std::string &uri = chunk_objs[idx]->uri;
+        auto &mapping = mappings[idx];
+        futures.push_back(ThreadPool::getInstance().submit(
+            [this, fc, &bucket_name, &uri, length, buf, &mapping, limiter] {
+              return timedPut(stats, uri, length, [&] {
+                return Operators::FileWriteExtents(fc, bucket_name, uri,
+                                                   length, buf, mapping);
+              }, limiter);
+            }));
+        continue;
+      }
       auto upload_buf = std::shared_ptr<char>(new char[length],
                                               std::default_delete<char[]>());
       auto raw_buf = upload_buf.get();
+      if (!stored[idx].data.empty())
+        memcpy(raw_buf, stored[idx].data.data(), length);
+      else if (chunk_objs[idx]->required_size < length)
+        memset(raw_buf, 0, length); // the fill value around the selection
+      stored[idx].data = std::vector<char>();
 #ifdef DUMMY_WRITE
       memset(raw_buf, 0, length);
 #else
@@ -312,30 +974,241 @@ herr_t S3VLDatasetObj::write(hid_t mem_space_id, hid_t file_space_id,
       if (SP == SPlan::AZURE_BLOB) {
         auto azure_client =
             std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
-        futures.push_back(std::async(std::launch::async, Operators::AzurePut,
-                                     azure_client->get(), chunk_objs[idx]->uri,
-                                     upload_buf, length));
+        BlobContainerClient *ac = azure_client->get();
+        const std::string &uri = chunk_objs[idx]->uri;
+        futures.push_back(ThreadPool::getInstance().submit(
+            [this, ac, &uri, upload_buf, length, limiter] {
+              return timedPut(stats, uri, length, [&] {
+                return Operators::AzurePut(ac, uri, upload_buf, length);
+              }, limiter);
+            }));
       } else {
         auto s3_client =
             std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
-        futures.push_back(std::async(std::launch::async, Operators::S3PutBuf,
-                                     s3_client->get(), bucket_name,
-                                     chunk_objs[idx]->uri, upload_buf, length));
+        S3Client *sc = s3_client->get();
+        const std::string &uri = chunk_objs[idx]->uri;
+        // no thread per upload: the transport calls back when it is done
+        auto done = std::make_shared<std::promise<herr_t>>();
+        futures.push_back(done->get_future());
+        if (limiter)
+          limiter->acquire();
+        auto start = std::chrono::steady_clock::now();
+        Operators::S3PutBufAsync(
+            sc, bucket_name, uri, upload_buf, length, limiter,
+            [stats = stats, uri, length, start, limiter, done](herr_t status) {
+              recordPut(stats, uri, length, start, status, limiter);
+              done->set_value(status);
+            });
+      }
+    }
+    for (size_t k = 0; k < futures.size(); k++) {
+      try {
+        put_ok[put_chunks[k]] = futures[k].get() >= 0;
+      } catch (const std::exception &e) {
+        Logger::error("------ PUT", chunk_objs[put_chunks[k]]->uri, e.what());
       }
     }
-    cur_batch = std::min(num, cur_batch + THREAD_NUM);
-    for (auto &fut : futures)
-      fut.wait();
     futures.clear();
+    put_chunks.clear();
+  }
+  // only what was stored counts toward the stored extent. Stored chunks are
+  // dropped from the caches again: a reader may have fetched the old object
+  // between the erase at planning and the PUT.
+  SharedChunkCache *shared = SharedChunkCache::getInstance();
+  size_t failed = 0;
+  hsize_t written = 0;
+  for (size_t i = 0; i < num; i++) {
+    if (!put_ok[i]) {
+      failed++;
+      continue;
+    }
+    if (cache)
+      cache->erase(chunk_objs[i]->uri);
+    if (shared)
+      shared->erase(sharedKey(chunk_objs[i]->uri));
+    std::vector<hsize_t> offsets = getChunkOffsets(chunks[i]);
+    for (int d = 0; d < ndims; d++)
+      stored_shape[d] = std::max(stored_shape[d],
+                                 offsets[d] + chunk_objs[i]->ranges[d][1] + 1);
+    written += chunk_objs[i]->required_size;
+  }
+  std::chrono::duration<double> write_t =
+      std::chrono::steady_clock::now() - write_start;
+  stats->write(written, write_t.count());
+  if (span.active)
+    span.args.add("uri", uri)
+        .add("chunks", static_cast<uint64_t>(num))
+        .add("bytes", static_cast<uint64_t>(written));
+  if (failed) {
+    Logger::error("------ Write", uri, ":", failed, "of", num,
+                  "chunks not stored");
+    return ARRAYMORPH_FAIL;
   }
   return ARRAYMORPH_SUCCESS;
 }
 
-std::vector<std::shared_ptr<S3VLChunkObj>>
-S3VLDatasetObj::generateChunks(std::vector<std::vector<hsize_t>> ranges) {
-  assert(ranges.size() == ndims);
+// background whole-chunk GET into the readahead/prefetch buffer
+static void fetchChunk(const std::shared_ptr<ChunkCache> &cache,
+                       uint64_t ticket, const StorageEndpoint &endpoint,
+                       const std::string &key, const std::string &shared_key,
+                       size_t bytes, IOStats *stats) {
+  TraceSpan span("fetch ahead", "request");
+  const CloudClient &client = endpoint.client;
+  const std::string &bucket_name = endpoint.bucket;
+  // counted in the endpoint's window like demand requests
+  takeSlot(endpoint.concurrency);
+  auto start = std::chrono::steady_clock::now();
+  Result re;
+  try {
+    if (auto s3 = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+        s3 && *s3)
+      re = Operators::S3Get(s3->get(), bucket_name, key);
+    else if (auto az =
+                 std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
+             az && *az)
+      re = Operators::AzureGet(az->get(), key);
+    else if (auto fc = std::get_if<std::unique_ptr<FileClient>>(&client);
+             fc && *fc)
+      re = Operators::FileGet(fc->get(), bucket_name, key);
+  } catch (const std::exception &e) {
+    Logger::warn("------ Fetch ahead failed: ", key, e.what());
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (re.data.size() != bytes) {
+    if (endpoint.concurrency)
+      endpoint.concurrency->release();
+    // demand reads fetch it themselves
+    cache->fill(key, ticket, nullptr);
+    stats->failure();
+    return;
+  }
+  if (endpoint.concurrency)
+    endpoint.concurrency->release(bytes, elapsed.count());
+  stats->request(bytes, elapsed.count());
+  if (span.active)
+    span.args.add("key", key).add("bytes", static_cast<uint64_t>(bytes));
+  if (SharedChunkCache *shared = SharedChunkCache::getInstance())
+    shared->put(shared_key, re.data.data(), bytes);
+  cache->fill(key, ticket,
+              std::make_shared<const std::vector<char>>(std::move(re.data)));
+}
+
+size_t S3VLDatasetObj::fetchAhead(const std::vector<int> &chunks) {
+  if (!cache)
+    return 0;
+  size_t bytes = element_per_chunk * data_size;
+  size_t queued = 0;
+  // a failed fetch is left to the demand read, which may fail over
+  StorageEndpoint *endpoint = endpoints->pick();
+  SharedChunkCache *shared = SharedChunkCache::getInstance();
+  for (int c : chunks) {
+    std::string key = chunkKey(c);
+    uint64_t ticket = cache->reserve(key, bytes);
+    if (ticket == 0)
+      continue;
+    queued++;
+    // another process on the node fetched it already
+    std::string shared_key = sharedKey(key);
+    std::shared_ptr<std::vector<char>> copy;
+    if (shared && shared->read(shared_key, bytes, [&](const char *data) {
+          copy = std::make_shared<std::vector<char>>(data, data + bytes);
+        })) {
+      cache->fill(key, ticket, std::move(copy));
+      continue;
+    }
+    ThreadPool::getInstance().submitBackground(
+        [cache = cache, ticket, endpoints = endpoints, endpoint, key,
+         shared_key, bytes, stats = stats] {
+          fetchChunk(cache, ticket, *endpoint, key, shared_key, bytes, stats);
+        });
+  }
+  return queued;
+}
+
+size_t S3VLDatasetObj::prefetch(hid_t file_space_id) {
+  if (!cache) {
+    Logger::warn("------ Prefetch ignored: ARRAYMORPH_READAHEAD_MB is 0");
+    return 0;
+  }
+  std::vector<std::vector<hsize_t>> ranges;
+  if (fileRanges(file_space_id, ranges) < 0 || ranges.empty())
+    return 0;
+  size_t queued = fetchAhead(accessedChunks(ranges));
+  Logger::log("------ Prefetch: ", queued, "chunks queued");
+  return queued;
+}
+
+void S3VLDatasetObj::readahead(const std::vector<std::vector<hsize_t>> &ranges,
+                               bool waited) {
+  auto &seq = sequential;
+  // a streaming read moves one dimension by a fixed step, keeping its extent
+  int dim = -1;
+  long long step = 0;
+  if (!seq.last.empty()) {
+    for (int i = 0; i < ndims; i++) {
+      if (ranges[i] == seq.last[i])
+        continue;
+      if (dim >= 0 || ranges[i][1] - ranges[i][0] !=
+                          seq.last[i][1] - seq.last[i][0]) {
+        dim = -1;
+        break;
+      }
+      dim = i;
+      step = (long long)ranges[i][0] - (long long)seq.last[i][0];
+    }
+  }
+  seq.last = ranges;
+  if (dim < 0) {
+    seq.dim = -1;
+    seq.run = 0;
+    seq.depth = READAHEAD_MIN_DEPTH;
+    return;
+  }
+  if (dim == seq.dim && step == seq.step)
+    seq.run++;
+  else {
+    seq.dim = dim;
+    seq.step = step;
+    seq.run = 1;
+    seq.depth = READAHEAD_MIN_DEPTH;
+  }
+  if (seq.run < READAHEAD_TRIGGER)
+    return;
+
+  // the reader caught up with the fetches: look further ahead, as far as
+  // half the buffer allows
+  size_t selection_bytes =
+      accessedChunks(ranges).size() * element_per_chunk * data_size;
+  int max_depth = std::clamp<long long>(
+      cache->capacity / 2 / std::max<size_t>(selection_bytes, 1), 1,
+      READAHEAD_MAX_DEPTH);
+  if (waited)
+    seq.depth = std::min(seq.depth * 2, max_depth);
+  seq.depth = std::min(seq.depth, max_depth);
+
+  std::vector<int> ahead;
+  std::unordered_set<int> seen;
+  std::vector<std::vector<hsize_t>> next = ranges;
+  for (int k = 1; k <= seq.depth; k++) {
+    long long lo = (long long)ranges[dim][0] + step * k;
+    long long hi = (long long)ranges[dim][1] + step * k;
+    if (hi < 0 || lo >= (long long)shape[dim])
+      break;
+    next[dim] = {(hsize_t)std::max(lo, 0LL),
+                 (hsize_t)std::min(hi, (long long)shape[dim] - 1)};
+    for (int c : accessedChunks(next))
+      if (seen.insert(c).second)
+        ahead.push_back(c);
+  }
+  size_t queued = fetchAhead(ahead);
+  if (queued)
+    Logger::log("------ Readahead: ", queued, "chunks, depth", seq.depth);
+}
+
+std::vector<int> S3VLDatasetObj::accessedChunks(
+    const std::vector<std::vector<hsize_t>> &ranges) const {
   std::vector<int> accessed_chunks;
-  // get accessed chunks
   std::vector<std::vector<hsize_t>> chunk_ranges(ndims);
   for (int i = 0; i < ndims; i++)
     chunk_ranges[i] = {ranges[i][0] / chunk_shape[i],
@@ -347,106 +1220,216 @@ S3VLDatasetObj::generateChunks(std::vector<std::vector<hsize_t>> ranges) {
        i++)
     for (auto &n : chunk_offsets)
       accessed_chunks.push_back(i + n);
+  return accessed_chunks;
+}
+
+std::string S3VLDatasetObj::chunkKey(int chunk_idx) const {
+  std::string key = uri + "/";
+  if (extensible) {
+    // the linear index would move with the extent; grid coordinates do not
+    std::vector<hsize_t> offsets = getChunkOffsets(chunk_idx);
+    for (int i = 0; i < ndims; i++)
+      key += (i ? "." : "") + std::to_string(offsets[i] / chunk_shape[i]);
+  } else
+    key += std::to_string(chunk_idx);
+  if (key_stripes <= 1)
+    return key;
+  // S3 scales request rates per leading key prefix, so the stripe comes
+  // first. FNV-1a rather than std::hash: every reader must derive the same
+  // key.
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char ch : key) {
+    h ^= ch;
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 32;
+  int width = 1;
+  while ((key_stripes - 1) >> (4 * width))
+    width++;
+  char prefix[16];
+  snprintf(prefix, sizeof(prefix), "%0*llx/", width,
+           (unsigned long long)(h % key_stripes));
+  return prefix + key;
+}
+
+std::vector<std::shared_ptr<S3VLChunkObj>>
+S3VLDatasetObj::generateChunks(std::vector<std::vector<hsize_t>> ranges) {
+  assert(ranges.size() == ndims);
+  std::vector<int> accessed_chunks = accessedChunks(ranges);
 
   // iterate accessed chunks and generate queries
   std::vector<std::shared_ptr<S3VLChunkObj>> chunk_objs;
   chunk_objs.reserve(accessed_chunks.size());
   Logger::log("------ # of chunks ", accessed_chunks.size());
-  for (auto &c : accessed_chunks) {
-    std::vector<hsize_t> offsets = getChunkOffsets(c);
-    std::vector<std::vector<hsize_t>> local_ranges(ndims);
-    for (int i = 0; i < ndims; i++) {
-      hsize_t left = std::max(offsets[i], ranges[i][0]) - offsets[i];
-      hsize_t right =
-          std::min(offsets[i] + chunk_shape[i] - 1, ranges[i][1]) - offsets[i];
-      local_ranges[i] = {left, right};
-    }
-    std::string chunk_uri = uri + "/" + std::to_string(c);
-    // get output serial offsets for each row
-    std::vector<std::vector<hsize_t>> global_ranges(ndims);
-    std::vector<hsize_t> result_shape(ndims);
-    for (int i = 0; i < ndims; i++) {
-      global_ranges[i] = {local_ranges[i][0] + offsets[i] - ranges[i][0],
-                          local_ranges[i][1] + offsets[i] - ranges[i][0]};
-      result_shape[i] = ranges[i][1] - ranges[i][0] + 1;
-    }
-    std::vector<hsize_t> result_serial_offsets =
-        calSerialOffsets(global_ranges, result_shape);
-
-    // S3VLChunkObj *chunk = new S3VLChunkObj(chunk_uri, dtype, local_ranges,
-    // chunk_shape, result_serial_offsets);
-    auto chunk = std::make_shared<S3VLChunkObj>(
-        chunk_uri, dtype, local_ranges, chunk_shape, result_serial_offsets);
-    // Logger::log("------ Generate Chunk");
-    // Logger::log(chunk->to_string());
-    // std::cout << chunk->to_string() << std::endl;
-    chunk_objs.push_back(chunk);
-  }
+  for (auto &c : accessed_chunks)
+    chunk_objs.push_back(generateChunk(c, ranges));
   return chunk_objs;
 }
 
+std::shared_ptr<S3VLChunkObj> S3VLDatasetObj::generateChunk(
+    int chunk_idx, const std::vector<std::vector<hsize_t>> &ranges) const {
+  std::vector<hsize_t> offsets = getChunkOffsets(chunk_idx);
+  std::vector<std::vector<hsize_t>> local_ranges(ndims);
+  for (int i = 0; i < ndims; i++) {
+    hsize_t left = std::max(offsets[i], ranges[i][0]) - offsets[i];
+    hsize_t right =
+        std::min(offsets[i] + chunk_shape[i] - 1, ranges[i][1]) - offsets[i];
+    local_ranges[i] = {left, right};
+  }
+  std::string chunk_uri = chunkKey(chunk_idx);
+  // get output serial offsets for each row
+  std::vector<std::vector<hsize_t>> global_ranges(ndims);
+  std::vector<hsize_t> result_shape(ndims);
+  for (int i = 0; i < ndims; i++) {
+    global_ranges[i] = {local_ranges[i][0] + offsets[i] - ranges[i][0],
+                        local_ranges[i][1] + offsets[i] - ranges[i][0]};
+    result_shape[i] = ranges[i][1] - ranges[i][0] + 1;
+  }
+  std::vector<hsize_t> result_serial_offsets =
+      calSerialOffsets(global_ranges, result_shape);
+
+  // S3VLChunkObj *chunk = new S3VLChunkObj(chunk_uri, dtype, local_ranges,
+  // chunk_shape, result_serial_offsets);
+  return std::make_shared<S3VLChunkObj>(chunk_uri, dtype, local_ranges,
+                                        chunk_shape, result_serial_offsets);
+}
+
 // read/write
 
-void S3VLDatasetObj::upload() {
+herr_t S3VLDatasetObj::upload() {
   Logger::log("------ Upload metadata " + uri);
   int length;
   char *buffer = toBuffer(&length);
-  std::shared_ptr<char> upload_buf(buffer, std::default_delete<char[]>());
-  std::string meta_name = uri + "/meta";
-  Result re{std::vector<char>(buffer, buffer + length)};
+  std::vector<char> meta(buffer, buffer + length);
+  delete[] buffer;
+  if (putObject(endpoints->primary(), uri + "/meta", meta) < 0) {
+    Logger::error("------ Failed to upload the metadata of", uri);
+    return ARRAYMORPH_FAIL;
+  }
+  is_modified = false;
+  for (uint32_t id : dropped_attrs) {
+    std::string key = uri + "/attr/" + std::to_string(id);
+    if (deleteObject(endpoints->primary(), key) < 0)
+      Logger::warn("------ Left the value of a deleted attribute at", key);
+  }
+  dropped_attrs.clear();
+  return ARRAYMORPH_SUCCESS;
+}
 
-  if (SP == SPlan::S3) {
-    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+std::shared_ptr<S3VLAttr>
+S3VLDatasetObj::findAttr(const std::string &name) const {
+  for (auto &attr : attrs)
+    if (attr->name == name)
+      return attr;
+  return nullptr;
+}
 
-    if (!s3_client || !s3_client->get()) {
-      std::cerr << "S3 client not initialized correctly!" << std::endl;
-      return;
-    }
-    Operators::S3Put(s3_client->get(), bucket_name, meta_name, re);
-  } else {
-    auto azure_client =
-        std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
-    if (!azure_client || !azure_client->get()) {
-      std::cerr << "Azure client not initialized correctly!" << std::endl;
-      return;
-    }
-    Operators::AzurePut(azure_client->get(), meta_name, upload_buf, length);
+std::shared_ptr<S3VLAttr> S3VLDatasetObj::createAttr(const std::string &name,
+                                                     hid_t type_id,
+                                                     hid_t space_id) {
+  if (findAttr(name)) {
+    Logger::error("------ Attribute", name, "of", uri, "exists");
+    return nullptr;
   }
+  auto attr = S3VLAttr::create(name, next_attr_id, type_id, space_id);
+  if (!attr)
+    return nullptr;
+  next_attr_id++;
+  attrs.push_back(attr);
+  is_modified = true;
+  return attr;
 }
 
-S3VLDatasetObj *S3VLDatasetObj::getDatasetObj(const CloudClient &client,
-                                              const std::string &bucket_name,
-                                              const std::string &uri) {
-  Result re;
-  if (SP == SPlan::S3) {
-    auto s3_client = std::get_if<std::unique_ptr<Aws::S3::S3Client>>(&client);
+herr_t S3VLDatasetObj::deleteAttr(const std::string &name) {
+  auto it = std::find_if(attrs.begin(), attrs.end(),
+                         [&name](auto &attr) { return attr->name == name; });
+  if (it == attrs.end()) {
+    Logger::error("------ No attribute", name, "on", uri);
+    return ARRAYMORPH_FAIL;
+  }
+  if ((*it)->spilled)
+    dropped_attrs.push_back((*it)->id);
+  attrs.erase(it);
+  is_modified = true;
+  return ARRAYMORPH_SUCCESS;
+}
 
-    if (!s3_client || !s3_client->get()) {
-      std::cerr << "S3 client not initialized correctly!" << std::endl;
-      return nullptr;
-    }
-    re = Operators::S3Get(s3_client->get(), bucket_name, uri);
+herr_t S3VLDatasetObj::renameAttr(const std::string &old_name,
+                                  const std::string &new_name) {
+  auto attr = findAttr(old_name);
+  if (!attr || findAttr(new_name)) {
+    Logger::error("------ Cannot rename attribute", old_name, "of", uri, "to",
+                  new_name);
+    return ARRAYMORPH_FAIL;
+  }
+  attr->name = new_name;
+  is_modified = true;
+  return ARRAYMORPH_SUCCESS;
+}
 
-  } else {
-    auto azure_client =
-        std::get_if<std::unique_ptr<BlobContainerClient>>(&client);
-    if (!azure_client || !azure_client->get()) {
-      std::cerr << "Azure client not initialized correctly!" << std::endl;
-      return nullptr;
-    }
-    re = Operators::AzureGet(azure_client->get(), uri);
+herr_t S3VLDatasetObj::storeAttr(S3VLAttr &attr) {
+  is_modified = true;
+  bool was_spilled = attr.spilled;
+  attr.spilled = attr.value.size() > ATTR_INLINE_MAX;
+  if (!attr.spilled) {
+    if (was_spilled)
+      dropped_attrs.push_back(attr.id);
+    return ARRAYMORPH_SUCCESS;
+  }
+  std::string key = uri + "/attr/" + std::to_string(attr.id);
+  if (putObject(endpoints->primary(), key, attr.value) < 0) {
+    Logger::error("------ Failed to store attribute", attr.name, "as", key);
+    return ARRAYMORPH_FAIL;
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLDatasetObj::loadAttr(S3VLAttr &attr) {
+  if (attr.loaded)
+    return ARRAYMORPH_SUCCESS;
+  std::string key = uri + "/attr/" + std::to_string(attr.id);
+  Result re = fetchObject(*endpoints, key);
+  if (re.data.size() != attr.size) {
+    Logger::error("------ Missing value of attribute", attr.name, "at", key);
+    return ARRAYMORPH_FAIL;
   }
+  attr.value = std::move(re.data);
+  attr.loaded = true;
+  return ARRAYMORPH_SUCCESS;
+}
 
+S3VLDatasetObj *
+S3VLDatasetObj::getDatasetObj(const std::shared_ptr<EndpointPool> &endpoints,
+                              const std::string &uri) {
+  Result re = fetchObject(*endpoints, uri);
   if (re.data.empty()) {
-    std::cerr << "Didn't get metadata!" << std::endl;
+    Logger::error("------ No metadata at", uri);
     return nullptr;
   }
-  return S3VLDatasetObj::getDatasetObj(client, bucket_name, re.data);
+  return S3VLDatasetObj::getDatasetObj(endpoints, re.data);
 }
 
 char *S3VLDatasetObj::toBuffer(int *length) {
   int size = 8 + name.size() + uri.size() + sizeof(hid_t) + 4 +
-             2 * ndims * sizeof(hsize_t) + 4;
+             2 * ndims * sizeof(hsize_t) + 4 + 4;
+  // attributes follow max_shape, which fixed datasets with attributes leave
+  // zero; fixed datasets that never had any keep the layout readers before
+  // resizing know. The next attribute id closes the list.
+  std::vector<char> attr_buf;
+  bool with_attrs = !attrs.empty() || next_attr_id > 0;
+  if (with_attrs) {
+    int count = attrs.size();
+    attr_buf.resize(4);
+    memcpy(attr_buf.data(), &count, 4);
+    for (auto &attr : attrs)
+      attr->encode(attr_buf);
+    size_t end = attr_buf.size();
+    attr_buf.resize(end + 4);
+    memcpy(attr_buf.data() + end, &next_attr_id, 4);
+  }
+  if (extensible || with_attrs)
+    size += ndims * sizeof(hsize_t);
+  size += attr_buf.size();
   *length = size;
   char *buffer = new char[size];
   int c = 0;
@@ -470,12 +1453,23 @@ char *S3VLDatasetObj::toBuffer(int *length) {
   c += sizeof(hsize_t) * ndims;
   memcpy(buffer + c, &chunk_num, 4);
   c += 4;
+  memcpy(buffer + c, &key_stripes, 4);
+  c += 4;
+  if (extensible) {
+    memcpy(buffer + c, max_shape.data(), sizeof(hsize_t) * ndims);
+    c += sizeof(hsize_t) * ndims;
+  } else if (with_attrs) {
+    memset(buffer + c, 0, sizeof(hsize_t) * ndims);
+    c += sizeof(hsize_t) * ndims;
+  }
+  if (!attr_buf.empty())
+    memcpy(buffer + c, attr_buf.data(), attr_buf.size());
   return buffer;
 }
 
-S3VLDatasetObj *S3VLDatasetObj::getDatasetObj(const CloudClient &client,
-                                              const std::string &bucket_name,
-                                              std::vector<char> &buffer) {
+S3VLDatasetObj *
+S3VLDatasetObj::getDatasetObj(const std::shared_ptr<EndpointPool> &endpoints,
+                              std::vector<char> &buffer) {
   std::string name, uri;
   int ndims, chunk_num;
   hid_t dtype;
@@ -511,15 +1505,60 @@ S3VLDatasetObj *S3VLDatasetObj::getDatasetObj(const CloudClient &client,
   c += sizeof(hsize_t) * ndims;
 
   memcpy(&chunk_num, buffer.data() + c, sizeof(int)); // chunk num
-  return new S3VLDatasetObj(name, uri, dtype, ndims, shape, chunk_shape,
-                            chunk_num, bucket_name, client);
+  c += sizeof(int);
+
+  // key stripes; absent from metadata written before striping existed
+  int key_stripes = 0;
+  if (buffer.size() >= c + sizeof(int))
+    memcpy(&key_stripes, buffer.data() + c, sizeof(int));
+  c += sizeof(int);
+
+  // max shape; only stored for extensible datasets, zero when a fixed one
+  // has attributes
+  std::vector<hsize_t> max_shape;
+  if (buffer.size() >= c + sizeof(hsize_t) * ndims) {
+    max_shape.resize(ndims);
+    memcpy(max_shape.data(), buffer.data() + c, sizeof(hsize_t) * ndims);
+    c += sizeof(hsize_t) * ndims;
+    if (std::all_of(max_shape.begin(), max_shape.end(),
+                    [](hsize_t d) { return d == 0; }))
+      max_shape.clear();
+  }
+  auto dset = new S3VLDatasetObj(name, uri, dtype, ndims, shape, chunk_shape,
+                                 chunk_num, endpoints, key_stripes, max_shape);
+
+  // attributes
+  if (buffer.size() >= c + sizeof(int)) {
+    int count;
+    memcpy(&count, buffer.data() + c, sizeof(int));
+    c += sizeof(int);
+    const char *p = buffer.data() + c, *end = buffer.data() + buffer.size();
+    int i = 0;
+    for (; i < count; i++) {
+      auto attr = S3VLAttr::decode(p, end);
+      if (!attr) {
+        Logger::error("------ Malformed attributes in metadata of", uri);
+        break;
+      }
+      dset->next_attr_id = std::max(dset->next_attr_id, attr->id + 1);
+      dset->attrs.push_back(std::move(attr));
+    }
+    // absent from metadata written before ids were kept
+    uint32_t next_attr_id;
+    if (i == count && end - p >= 4) {
+      memcpy(&next_attr_id, p, 4);
+      dset->next_attr_id = std::max(dset->next_attr_id, next_attr_id);
+    }
+  }
+  return dset;
 }
 
 std::string S3VLDatasetObj::to_string() {
   std::stringstream ss;
   ss << name << " " << uri << std::endl;
   ss << dtype << " " << ndims << std::endl;
-  ss << chunk_num << " " << element_per_chunk << std::endl;
+  ss << chunk_num << " " << element_per_chunk << " " << key_stripes
+     << std::endl;
   ;
   for (int i = 0; i < ndims; i++) {
     ss << shape[i] << " ";
@@ -529,6 +1568,15 @@ std::string S3VLDatasetObj::to_string() {
     ss << chunk_shape[i] << " ";
   }
   ss << std::endl;
+  if (extensible) {
+    for (int i = 0; i < ndims; i++) {
+      if (max_shape[i] == H5S_UNLIMITED)
+        ss << "unlimited ";
+      else
+        ss << max_shape[i] << " ";
+    }
+    ss << std::endl;
+  }
   for (int i = 0; i < ndims; i++) {
     ss << num_per_dim[i] << " ";
   }
@@ -537,5 +1585,9 @@ std::string S3VLDatasetObj::to_string() {
     ss << reduc_per_dim[i] << " ";
   }
   ss << std::endl;
+  for (auto &attr : attrs)
+    ss << attr->name << (attr->spilled ? "* " : " ");
+  if (!attrs.empty())
+    ss << std::endl;
   return ss.str();
 }
@@ -2,80 +2,143 @@
 #include "arraymorph/core/constants.h"
 #include "arraymorph/core/logger.h"
 #include "arraymorph/core/operators.h"
+#include "arraymorph/core/planner.h"
+#include "arraymorph/s3vl/c_api.h"
+#include "arraymorph/s3vl/vol_info.h"
 #include <aws/core/auth/signer/AWSAuthV4Signer.h>
 #include <cstring>
-#include <stdlib.h>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <stdlib.h>
+
+// a setting of the connector info, else the environment variable
+static const char *setting(const std::string &value, const char *env) {
+  return !value.empty() ? value.c_str() : getenv(env);
+}
 
-CloudClient get_client() {
+static bool flag(std::optional<bool> value, const char *env,
+                 const char *on = "true") {
+  if (value)
+    return *value;
+  const char *v = getenv(env);
+  return v && strcmp(v, on) == 0;
+}
+
+static std::unique_ptr<StorageEndpoint>
+get_endpoint(const EndpointConfig &config, const ConcurrencyLimits &limits) {
   Logger::log("Init cloud clients");
+  auto endpoint = std::make_unique<StorageEndpoint>();
+  const char *bucket = setting(config.bucket, "BUCKET_NAME");
+  endpoint->bucket = bucket ? bucket : "";
   // AWS connection
-  CloudClient client;
   if (SP == SPlan::S3) {
-    std::string access_key = getenv("AWS_ACCESS_KEY_ID");
-    std::string secret_key = getenv("AWS_SECRET_ACCESS_KEY");
+    const char *access_key = setting(config.access_key, "AWS_ACCESS_KEY_ID");
+    const char *secret_key =
+        setting(config.secret_key, "AWS_SECRET_ACCESS_KEY");
+    if (!access_key || !secret_key) {
+      Logger::error("------ S3 credentials not set");
+      return nullptr;
+    }
     Aws::Auth::AWSCredentials cred(access_key, secret_key);
     
     std::unique_ptr<Aws::Client::ClientConfiguration> s3ClientConfig =
         std::make_unique<Aws::Client::ClientConfiguration>();
 
-    const char *use_tls =
-        getenv("AWS_USE_TLS"); // Is TLS necessary. Does not use it by default.
-
-    // Env var is char pointer by default. Checking to see if value was
-    // provided, ('true' or 'false').
+    // Is TLS necessary. Does not use it by default.
     s3ClientConfig->scheme =
-        use_tls && strcmp(use_tls, "true") == 0 ? Scheme::HTTPS : Scheme::HTTP;
-    const char *endpoint = getenv("AWS_ENDPOINT_URL_S3"); // Custom S3 endpoint
-    if (endpoint) {
-      s3ClientConfig->endpointOverride = endpoint;
+        flag(config.tls, "AWS_USE_TLS") ? Scheme::HTTPS : Scheme::HTTP;
+    const char *endpoint_url =
+        setting(config.endpoint, "AWS_ENDPOINT_URL_S3"); // Custom S3 endpoint
+    if (endpoint_url) {
+      s3ClientConfig->endpointOverride = endpoint_url;
     }
 
-    const char *region =
-        getenv("AWS_REGION"); // Region where bucket is located i.e. us-east-1
+    const char *region = setting(
+        config.region, "AWS_REGION"); // Region where bucket is located i.e.
+                                      // us-east-1
     if (region) {
       s3ClientConfig->region = region;
     }
 
-    const char *signed_payloads =
-        getenv("AWS_SIGNED_PAYLOADS"); // Whether or not to sign each payload.
-                                       // Garage requires it to be on. May have
-                                       // affect on performance, needs to be
-                                       // tested. Off by default
+    // Whether or not to sign each payload. Garage requires it to be on. May
+    // have affect on performance, needs to be tested. Off by default
     auto payload_signing_policy =
-        signed_payloads && strcmp(signed_payloads, "true") == 0
+        flag(config.signed_payloads, "AWS_SIGNED_PAYLOADS")
             ? Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Always
             : Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never;
 
-    const char *addressing_style = getenv(
-        "AWS_S3_ADDRESSING_STYLE"); // Some S3-compatible stores require path
-                                    // styles, 'bucket.endpoint' (virtual) vs
-                                    // 'endpoint/bucket'(with path-style).
+    // Some S3-compatible stores require path styles, 'bucket.endpoint'
+    // (virtual) vs 'endpoint/bucket'(with path-style).
     bool use_path_style =
-        addressing_style && strcmp(addressing_style, "path") == 0 ? true
-                                                                  : false;
+        flag(config.path_style, "AWS_S3_ADDRESSING_STYLE", "path");
 
-    s3ClientConfig->maxConnections = s3Connections;
+    endpoint->name = endpoint_url ? endpoint_url
+                                  : "s3." +
+                                        std::string(region ? region
+                                                           : "us-east-1") +
+                                        ".amazonaws.com";
+    endpoint->concurrency = &ConcurrencyController::forEndpoint(endpoint->name);
+    endpoint->concurrency->configure(limits);
+    // enough connections and executor threads for the largest window plus
+    // a burst of hedges; the window decides how many are actually used
+    size_t pool_size = endpoint->concurrency->maxWindow() + HEDGE_MAX_BURST;
+    s3ClientConfig->maxConnections = pool_size;
     s3ClientConfig->requestTimeoutMs = requestTimeoutMs;
     s3ClientConfig->connectTimeoutMs = connectTimeoutMs;
-    s3ClientConfig->retryStrategy =
-        std::make_shared<Aws::Client::StandardRetryStrategy>(retries);
+    s3ClientConfig->retryStrategy = std::make_shared<CountingRetryStrategy>(
+        endpoint->concurrency, retries);
 #ifdef POOLEXECUTOR
-    s3ClientConfig->executor =
-        Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("test",
-                                                                     poolSize);
+    // one executor for every client, sized by the first; the event loop
+    // carries every async request, so then it has nothing to run
+    static auto executor =
+        Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>(
+            "test", HttpEventLoop::getInstance() ? 1 : pool_size);
+    s3ClientConfig->executor = executor;
 #endif
-    Logger::log("------ Create Client config: maxConnections=",
+    Logger::info("------ Create Client config: maxConnections=",
                 s3ClientConfig->maxConnections);
-    client = std::make_unique<Aws::S3::S3Client>(
+    const char *pushdown_endpoint = getenv(
+        "ARRAYMORPH_PUSHDOWN_ENDPOINT"); // Subsetting executor in front of the
+                                         // store, e.g. the local sidecar in
+                                         // scripts/pushdown_sidecar.py
+    if (pushdown_endpoint && !pushdown_client) {
+      Aws::Client::ClientConfiguration pushdown_config = *s3ClientConfig;
+      pushdown_config.endpointOverride = pushdown_endpoint;
+      pushdown_concurrency =
+          &ConcurrencyController::forEndpoint(pushdown_endpoint);
+      pushdown_concurrency->configure(limits);
+      pushdown_config.retryStrategy = std::make_shared<CountingRetryStrategy>(
+          pushdown_concurrency, retries);
+      pushdown_client = std::make_unique<Aws::S3::S3Client>(
+          cred, std::move(pushdown_config), payload_signing_policy, true);
+      CostModel::getInstance().enablePushdown();
+      Logger::info("------ Pushdown executor: ", pushdown_endpoint);
+    }
+    endpoint->client = std::make_unique<Aws::S3::S3Client>(
         cred, std::move(*s3ClientConfig), payload_signing_policy,
         use_path_style);
     s3ClientConfig.reset();
   }
+  // Local file system
+  else if (SP == SPlan::LOCAL_FILE) {
+    const char *root = setting(
+        config.endpoint, "ARRAYMORPH_FILE_ROOT"); // Directory holding the
+                                                  // buckets, cwd if unset
+    endpoint->client = std::make_unique<FileClient>(root ? root : ".");
+    endpoint->name = "file://" + std::string(root ? root : ".");
+    endpoint->concurrency = &ConcurrencyController::forEndpoint(endpoint->name);
+    endpoint->concurrency->configure(limits);
+    Logger::info("------ File root: ", root ? root : ".");
+  }
   // Azure connection
   else {
-    std::string azure_connection_string =
-        getenv("AZURE_STORAGE_CONNECTION_STRING");
+    const char *azure_connection_string = setting(
+        config.connection_string, "AZURE_STORAGE_CONNECTION_STRING");
+    if (!azure_connection_string) {
+      Logger::error("------ Azure connection string not set");
+      return nullptr;
+    }
 
     Azure::Core::Http::Policies::RetryOptions retryOptions;
     retryOptions.MaxRetries = retries;
@@ -84,11 +147,119 @@ CloudClient get_client() {
 
     Azure::Storage::Blobs::BlobClientOptions clientOptions;
     clientOptions.Retry = retryOptions;
-    client = std::make_unique<BlobContainerClient>(
-        BlobContainerClient::CreateFromConnectionString(
-            azure_connection_string, BUCKET_NAME, clientOptions));
+    std::unique_ptr<BlobContainerClient> azure_client;
+    try {
+      azure_client = std::make_unique<BlobContainerClient>(
+          BlobContainerClient::CreateFromConnectionString(
+              azure_connection_string, endpoint->bucket, clientOptions));
+    } catch (const std::exception &e) {
+      Logger::error("------ Azure client not created:", e.what());
+      return nullptr;
+    }
+    endpoint->name = azure_client->GetUrl();
+    endpoint->client = std::move(azure_client);
+    endpoint->concurrency = &ConcurrencyController::forEndpoint(endpoint->name);
+    endpoint->concurrency->configure(limits);
+  }
+  return endpoint;
+}
+
+// whether the endpoint holds a client, so that no request goes out on a null
+// one
+static bool connected(const StorageEndpoint &endpoint) {
+  return std::visit(
+      [](const auto &client) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(client)>,
+                                     std::monostate>)
+          return false;
+        else
+          return client != nullptr;
+      },
+      endpoint.client);
+}
+
+// window overrides set with arraymorph_set_fapl_concurrency()
+static ConcurrencyLimits faplLimits(hid_t fapl_id) {
+  ConcurrencyLimits limits;
+  auto get = [fapl_id](const char *name, size_t &value) {
+    if (H5Pexist(fapl_id, name) > 0)
+      H5Pget(fapl_id, name, &value);
+  };
+  if (fapl_id == H5P_DEFAULT)
+    return limits;
+  get(ARRAYMORPH_FAPL_INITIAL_CONCURRENCY, limits.initial);
+  get(ARRAYMORPH_FAPL_MIN_CONCURRENCY, limits.min);
+  get(ARRAYMORPH_FAPL_MAX_CONCURRENCY, limits.max);
+  get(ARRAYMORPH_FAPL_CONCURRENCY, limits.fixed);
+  return limits;
+}
+
+// the connector info of the file access property list, empty if none
+static std::string faplConfig(hid_t fapl_id) {
+  std::string config;
+  hid_t connector_id;
+  void *info = nullptr;
+  if (fapl_id == H5P_DEFAULT || H5Pget_vol_id(fapl_id, &connector_id) < 0)
+    return config;
+  if (H5Pget_vol_info(fapl_id, &info) >= 0 && info) {
+    config = static_cast<S3VLInfo *>(info)->config;
+    H5VLfree_connector_info(connector_id, info);
+  }
+  H5VLclose(connector_id);
+  return config;
+}
+
+// one pool per distinct connector info, so files on the same stores share
+// their clients and request windows
+static std::mutex pools_mtx;
+static std::map<std::string, std::shared_ptr<EndpointPool>> pools;
+
+// connect to the stores of a file on its first use; later files may still
+// retune the windows
+static std::shared_ptr<EndpointPool> connect(hid_t fapl_id) {
+  ConcurrencyLimits limits = faplLimits(fapl_id);
+  std::string config = faplConfig(fapl_id);
+  std::lock_guard<std::mutex> lock(pools_mtx);
+  auto &pool = pools[config];
+  if (pool) {
+    if (!limits.empty())
+      for (size_t i = 0; i < pool->size(); i++)
+        pool->at(i).concurrency->configure(limits);
+    return pool;
   }
-  return client;
+  std::vector<EndpointConfig> configs;
+  if (!parseEndpoints(config, configs)) {
+    pools.erase(config);
+    return nullptr;
+  }
+  if (configs.size() > 1 && SP != SPlan::S3) {
+    Logger::warn("------ Replicas are only read from S3; using the first");
+    configs.resize(1);
+  }
+  std::vector<std::unique_ptr<StorageEndpoint>> endpoints;
+  for (auto &c : configs) {
+    auto endpoint = get_endpoint(c, limits);
+    if (!endpoint || endpoint->bucket.empty()) {
+      Logger::error("------ No bucket for the store ", c.endpoint);
+      pools.erase(config);
+      return nullptr;
+    }
+    if (!connected(*endpoint)) {
+      Logger::error("------ No client for the store ", endpoint->name);
+      pools.erase(config);
+      return nullptr;
+    }
+    Logger::info("------ Endpoint ", endpoint->name, "bucket",
+                 endpoint->bucket);
+    endpoints.push_back(std::move(endpoint));
+  }
+  pool = std::make_shared<EndpointPool>(std::move(endpoints));
+  return pool;
+}
+
+void S3VLFileCallbacks::disconnect() {
+  std::lock_guard<std::mutex> lock(pools_mtx);
+  pools.clear();
 }
 
 void *S3VLFileCallbacks::S3VL_file_create(const char *name, unsigned flags,
@@ -101,9 +272,13 @@ void *S3VLFileCallbacks::S3VL_file_create(const char *name, unsigned flags,
   }
   ret_obj->name = path;
   Logger::log("------ Create File:", path);
-  if (std::holds_alternative<std::monostate>(global_cloud_client)) {
-    global_cloud_client = get_client();
+  ret_obj->endpoints = connect(fapl_id);
+  if (!ret_obj->endpoints) {
+    delete ret_obj;
+    return NULL;
   }
+  ret_obj->groups =
+      std::make_shared<S3VLGroupTree>(ret_obj->name, ret_obj->endpoints);
   return (void *)ret_obj;
 }
 void *S3VLFileCallbacks::S3VL_file_open(const char *name, unsigned flags,
@@ -116,9 +291,13 @@ void *S3VLFileCallbacks::S3VL_file_open(const char *name, unsigned flags,
     path = path.substr(2);
   }
   ret_obj->name = path;
-  if (std::holds_alternative<std::monostate>(global_cloud_client)) {
-    global_cloud_client = get_client();
+  ret_obj->endpoints = connect(fapl_id);
+  if (!ret_obj->endpoints) {
+    delete ret_obj;
+    return NULL;
   }
+  ret_obj->groups =
+      std::make_shared<S3VLGroupTree>(ret_obj->name, ret_obj->endpoints);
   return (void *)ret_obj;
 }
 herr_t S3VLFileCallbacks::S3VL_file_close(void *file, hid_t dxpl_id,
@@ -1,115 +1,252 @@
 #include "arraymorph/s3vl/group_callbacks.h"
+#include "arraymorph/core/constants.h"
 #include "arraymorph/core/logger.h"
-#include "arraymorph/core/operators.h"
-#include "arraymorph/s3vl/dataset_callbacks.h"
-#include <aws/core/utils/threading/Executor.h>
+#include "arraymorph/s3vl/file_callbacks.h"
+#include <algorithm>
 #include <cstring>
 
-herr_t S3VLGroupCallbacks::S3VLgroup_get(void *obj, H5VL_group_get_args_t *args,
-                                         hid_t dxpl_id, void **req) {
-  Logger::log("------ Get Group");
-  // cout << "is NULL: " << (obj == NULL) << endl;
-  // if (args->args.get_info.loc_params.obj_type == H5I_type_t::H5I_GROUP ) {
-  //     S3VLObj *get_obj = (S3VLObj*)obj;
-  //     cout << "obj info: " << get_obj->idx << " " << get_obj->keys[1] <<
-  //     endl;
-  // }
-  // cout << "get type: " << args->op_type << endl;
-  // cout << "get para: " << args->args.get_info.loc_params.obj_type << " " <<
-  // args->args.get_info.loc_params.type << endl; if (args->op_type ==
-  // H5VL_group_get_t::H5VL_GROUP_GET_INFO) {
-  //     args->args.get_info.loc_params.type =
-  //     H5VL_loc_type_t::H5VL_OBJECT_BY_IDX; auto ginfo =
-  //     args->args.get_info.ginfo; ginfo->nlinks = 3; ginfo->mounted = true;
-  // }
-  // else if (args->op_type == H5VL_group_get_t::H5VL_GROUP_GET_GCPL) {
-  //     hid_t gcpl_id = H5Pcreate(H5P_GROUP_CREATE);
-  // 	args->args.get_gcpl.gcpl_id = H5Pcopy(gcpl_id);
-  // }
-  return ARRAYMORPH_SUCCESS;
+bool S3VLGroupCallbacks::locate(void *obj, H5I_type_t obj_type,
+                                S3VLGroupObj &loc) {
+  if (obj_type == H5I_FILE) {
+    loc = {((S3VLFileObj *)obj)->groups, ""};
+    return true;
+  }
+  if (obj_type == H5I_GROUP) {
+    loc = *(S3VLGroupObj *)obj;
+    return true;
+  }
+  return false;
+}
+
+bool S3VLGroupCallbacks::resolve(void *obj, const H5VL_loc_params_t *loc_params,
+                                 S3VLGroupObj &loc) {
+  if (!locate(obj, loc_params->obj_type, loc))
+    return false;
+  if (loc_params->type == H5VL_OBJECT_BY_NAME)
+    loc.path = joinPath(loc.path, loc_params->loc_data.loc_by_name.name);
+  return loc_params->type == H5VL_OBJECT_BY_SELF ||
+         loc_params->type == H5VL_OBJECT_BY_NAME;
+}
+
+bool S3VLGroupCallbacks::intermediate(hid_t lcpl_id) {
+  unsigned crt = 0;
+  if (lcpl_id != H5P_DEFAULT)
+    H5Pget_create_intermediate_group(lcpl_id, &crt);
+  return crt > 0;
+}
+
+// the links of a group in the order asked for; by name for either index
+static std::vector<std::pair<std::string, H5O_type_t>>
+ordered(S3VLGroupIndex &index, H5_iter_order_t order) {
+  auto links = index.links();
+  if (order == H5_ITER_DEC)
+    std::reverse(links.begin(), links.end());
+  return links;
+}
+
+static void fillInfo(H5L_info_t *linfo) {
+  memset(linfo, 0, sizeof(*linfo));
+  linfo->type = H5L_TYPE_HARD;
+  linfo->cset = H5T_CSET_ASCII;
+}
+
+void *S3VLGroupCallbacks::S3VLgroup_create(
+    void *obj, const H5VL_loc_params_t *loc_params, const char *name,
+    hid_t lcpl_id, hid_t gcpl_id, hid_t gapl_id, hid_t dxpl_id, void **req) {
+  Logger::log("------ Create Group", name ? name : "");
+  S3VLGroupObj loc;
+  if (!name || !locate(obj, loc_params->obj_type, loc)) {
+    Logger::error("------ Groups are only created by name in groups");
+    return NULL;
+  }
+  std::string path = joinPath(loc.path, name);
+  if (!loc.tree->create(path, intermediate(lcpl_id)))
+    return NULL;
+  return new S3VLGroupObj{loc.tree, path};
 }
 
 void *S3VLGroupCallbacks::S3VLgroup_open(void *obj,
                                          const H5VL_loc_params_t *loc_params,
                                          const char *name, hid_t gapl_id,
                                          hid_t dxpl_id, void **req) {
-  /*
-  TODO: This function is a simple way to list the dataset names using h5ls
-  */
-  Logger::log("------ Open Group");
-  Logger::log("name: ", name);
-  //     if (strcmp(name, "/") == 0) {
-  //         S3VLFileObj *f_obj = (S3VLFileObj*)obj;
-  //         std::string keys_url = f_obj->name + "/keys";
-  //         std::string bucket_name = getenv("BUCKET_NAME");
-  //         Result keys;
-  //         // aws connection
-  //         if (SP == SPlan::S3) {
-  //             std::string access_key = getenv("AWS_ACCESS_KEY_ID");
-  //             std::string secret_key = getenv("AWS_SECRET_ACCESS_KEY");
-  //             Aws::Auth::AWSCredentials cred(access_key, secret_key);
-  //             if (s3Configured == false) {
-  //                 s3Configured = true;
-  //                 s3ClientConfig = new Aws::Client::ClientConfiguration();
-  //                 s3ClientConfig->scheme = Scheme::HTTP;
-  //                 s3ClientConfig->maxConnections = s3Connections;
-  //                 s3ClientConfig->requestTimeoutMs = requestTimeoutMs;
-  //                 s3ClientConfig->connectTimeoutMs = connectTimeoutMs;
-  // #ifdef POOLEXECUTOR
-  //                 s3ClientConfig->executor =
-  //                 Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("test",
-  //                 poolSize);
-  // #endif
-  //                 Logger::log("------ Create Client config: maxConnections=",
-  //                 s3ClientConfig->maxConnections);
-  //             }
-  //             std::unique_ptr<Aws::S3::S3Client> client =
-  //             std::make_unique<Aws::S3::S3Client>(cred, *s3ClientConfig);
-  //             keys = Operators::S3Get(client.get(), bucket_name, keys_url);
-  //             // list dsets
-  //             std::cout << "datasets:" << std::endl;
-  //             std::cout.write(keys.data, keys.length);
-  //         }
-  //     }
-  return (void *)obj;
+  Logger::log("------ Open Group", name);
+  S3VLGroupObj loc;
+  if (!locate(obj, loc_params->obj_type, loc))
+    return NULL;
+  std::string path = joinPath(loc.path, name);
+  if (!loc.tree->open(path)) {
+    Logger::error("------ No group", name);
+    return NULL;
+  }
+  return new S3VLGroupObj{loc.tree, path};
 }
 
 herr_t S3VLGroupCallbacks::S3VLgroup_close(void *grp, hid_t dxpl_id,
                                            void **req) {
-  Logger::log("------ Close Group");
-  S3VLFileObj *f_obj = (S3VLFileObj *)grp;
-  // free(f_obj);
+  S3VLGroupObj *group_obj = (S3VLGroupObj *)grp;
+  Logger::log("------ Close Group", "/" + group_obj->path);
+  delete group_obj;
   return ARRAYMORPH_SUCCESS;
 }
 
+herr_t S3VLGroupCallbacks::S3VLgroup_get(void *obj, H5VL_group_get_args_t *args,
+                                         hid_t dxpl_id, void **req) {
+  Logger::log("------ Get Group", args->op_type);
+  switch (args->op_type) {
+  case H5VL_group_get_t::H5VL_GROUP_GET_GCPL:
+    args->args.get_gcpl.gcpl_id = H5Pcreate(H5P_GROUP_CREATE);
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_group_get_t::H5VL_GROUP_GET_INFO: {
+    auto &info_args = args->args.get_info;
+    S3VLGroupObj loc;
+    auto index = resolve(obj, &info_args.loc_params, loc)
+                     ? loc.tree->open(loc.path)
+                     : nullptr;
+    if (!index)
+      return ARRAYMORPH_FAIL;
+    H5G_info_t *ginfo = info_args.ginfo;
+    ginfo->storage_type = H5G_STORAGE_TYPE_COMPACT;
+    ginfo->nlinks = index->links().size();
+    ginfo->max_corder = 0;
+    ginfo->mounted = false;
+    return ARRAYMORPH_SUCCESS;
+  }
+  default:
+    Logger::warn("------ Unsupported group get operation");
+    return ARRAYMORPH_FAIL;
+  }
+}
+
+// the name of the link `loc_params` refers to, by name or by its position
+// in a group
+static bool linkName(void *obj, const H5VL_loc_params_t *loc_params,
+                     std::string &name) {
+  S3VLGroupObj loc;
+  if (!S3VLGroupCallbacks::locate(obj, loc_params->obj_type, loc))
+    return false;
+  if (loc_params->type == H5VL_OBJECT_BY_NAME) {
+    std::string path =
+        joinPath(loc.path, loc_params->loc_data.loc_by_name.name);
+    if (loc.tree->type(path) == H5O_TYPE_UNKNOWN)
+      return false;
+    name = splitPath(path).second;
+    return true;
+  }
+  if (loc_params->type != H5VL_OBJECT_BY_IDX)
+    return false;
+  auto &by_idx = loc_params->loc_data.loc_by_idx;
+  auto index = loc.tree->open(joinPath(loc.path, by_idx.name));
+  if (!index)
+    return false;
+  auto links = ordered(*index, by_idx.order);
+  if (by_idx.n >= links.size())
+    return false;
+  name = links[by_idx.n].first;
+  return true;
+}
+
 herr_t S3VLGroupCallbacks::S3VLlink_get(void *obj,
                                         const H5VL_loc_params_t *loc_params,
                                         H5VL_link_get_args_t *args,
                                         hid_t dxpl_id, void **req) {
-  Logger::log("------ Get Link");
-  // cout << "get type: " << args->op_type << endl;
-  // cout << "get para: " << args->args.get_info.loc_params.obj_type << " " <<
-  // args->args.get_info.loc_params.type << endl;
-  return ARRAYMORPH_SUCCESS;
+  Logger::log("------ Get Link", args->op_type);
+  std::string name;
+  switch (args->op_type) {
+  case H5VL_link_get_t::H5VL_LINK_GET_INFO:
+    if (!linkName(obj, loc_params, name))
+      return ARRAYMORPH_FAIL;
+    fillInfo(args->args.get_info.linfo);
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_link_get_t::H5VL_LINK_GET_NAME: {
+    if (!linkName(obj, loc_params, name))
+      return ARRAYMORPH_FAIL;
+    auto &name_args = args->args.get_name;
+    if (name_args.name && name_args.name_size > 0) {
+      size_t n = std::min(name.size(), name_args.name_size - 1);
+      memcpy(name_args.name, name.data(), n);
+      name_args.name[n] = '\0';
+    }
+    if (name_args.name_len)
+      *name_args.name_len = name.size();
+    return ARRAYMORPH_SUCCESS;
+  }
+  default:
+    Logger::warn("------ Unsupported link get operation");
+    return ARRAYMORPH_FAIL;
+  }
+}
+
+// H5Lvisit: the links below the group at `path`, named relative to where
+// the visit started, each group's links right after the group
+static herr_t visit(S3VLGroupTree &tree, const std::string &path,
+                    const std::string &prefix,
+                    const H5VL_link_iterate_args_t &it, hid_t group_id) {
+  auto index = tree.open(path);
+  if (!index)
+    return ARRAYMORPH_FAIL;
+  for (auto &[name, type] : ordered(*index, it.order)) {
+    H5L_info_t linfo;
+    fillInfo(&linfo);
+    std::string relative = prefix + name;
+    herr_t ret = it.op(group_id, relative.c_str(), &linfo, it.op_data);
+    if (ret == 0 && type == H5O_TYPE_GROUP)
+      ret = visit(tree, joinPath(path, name), relative + "/", it, group_id);
+    if (ret != 0)
+      return ret;
+  }
+  return 0;
+}
+
+// H5Literate and H5Lvisit. `op` gets an identifier of the group, as with
+// the native connector, so callbacks such as h5ls's can look the links up
+// by name relative to it.
+static herr_t iterate(const S3VLGroupObj &loc,
+                      const H5VL_link_iterate_args_t &it) {
+  auto index = loc.tree->open(loc.path);
+  if (!index)
+    return ARRAYMORPH_FAIL;
+  S3VLGroupObj *handle = new S3VLGroupObj(loc);
+  hid_t group_id = H5VLwrap_register(handle, H5I_GROUP);
+  if (group_id < 0)
+    delete handle;
+  herr_t ret = 0;
+  if (it.recursive) {
+    ret = visit(*loc.tree, loc.path, "", it, group_id);
+  } else {
+    auto links = ordered(*index, it.order);
+    hsize_t i = it.idx_p ? *it.idx_p : 0;
+    while (i < links.size() && ret == 0) {
+      H5L_info_t linfo;
+      fillInfo(&linfo);
+      ret = it.op(group_id, links[i].first.c_str(), &linfo, it.op_data);
+      i++;
+    }
+    if (it.idx_p)
+      *it.idx_p = i;
+  }
+  // closes the handle
+  if (group_id >= 0)
+    H5Idec_ref(group_id);
+  return ret;
 }
 
 herr_t S3VLGroupCallbacks::S3VLlink_specific(
     void *obj, const H5VL_loc_params_t *loc_params,
     H5VL_link_specific_args_t *args, hid_t dxpl_id, void **req) {
-  Logger::log("------ Specific Link");
-  // S3VLGroupObj *get_obj = (S3VLGroupObj*)obj;
-  // cout << "obj info: " << get_obj->keys.size() << " " << get_obj->keys[1] <<
-  // endl;
-
-  // cout << "get type: " << args->op_type << endl;
-  // // cout << "get para: " << args->args.get_info.loc_params.obj_type << " "
-  // << args->args.get_info.loc_params.type << endl; if (args->op_type ==
-  // H5VL_link_specific_t::H5VL_LINK_ITER) {
-  //     auto it_args = args->args.iterate;
-  //     cout << it_args.recursive << endl;
-  //     cout << it_args.op << endl;
-  //     // cout << *(it_args.idx_p) << endl;
-  //     // cout << loc_params->loc_data.loc_by_name.name << endl;
-  // }
-  return ARRAYMORPH_SUCCESS;
+  Logger::log("------ Specific Link", args->op_type);
+  S3VLGroupObj loc;
+  switch (args->op_type) {
+  case H5VL_link_specific_t::H5VL_LINK_EXISTS:
+    *args->args.exists.exists = resolve(obj, loc_params, loc) &&
+                                !loc.path.empty() &&
+                                loc.tree->type(loc.path) != H5O_TYPE_UNKNOWN;
+    return ARRAYMORPH_SUCCESS;
+  case H5VL_link_specific_t::H5VL_LINK_ITER:
+    if (!resolve(obj, loc_params, loc))
+      return ARRAYMORPH_FAIL;
+    return iterate(loc, args->args.iterate);
+  default:
+    Logger::warn("------ Unsupported link operation");
+    return ARRAYMORPH_FAIL;
+  }
 }
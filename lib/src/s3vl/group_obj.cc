@@ -0,0 +1,202 @@
+#include "arraymorph/s3vl/group_obj.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include <cstring>
+
+S3VLGroupIndex::S3VLGroupIndex(std::shared_ptr<EndpointPool> endpoints,
+                               const std::string &key)
+    : key(key), endpoints(std::move(endpoints)) {}
+
+// the number of links, then the name length, name and object type of each
+std::vector<char>
+S3VLGroupIndex::encode(const std::map<std::string, H5O_type_t> &entries) {
+  std::vector<char> out;
+  auto put = [&out](const void *data, size_t length) {
+    size_t c = out.size();
+    out.resize(c + length);
+    if (length)
+      memcpy(out.data() + c, data, length);
+  };
+  int count = entries.size();
+  put(&count, 4);
+  for (auto &[name, type] : entries) {
+    int name_length = name.size();
+    int obj_type = type;
+    put(&name_length, 4);
+    put(name.data(), name_length);
+    put(&obj_type, 4);
+  }
+  return out;
+}
+
+bool S3VLGroupIndex::decode(const std::vector<char> &buffer,
+                            std::map<std::string, H5O_type_t> &entries) {
+  const char *p = buffer.data(), *end = p + buffer.size();
+  auto take = [&p, end](void *data, size_t length) {
+    if (end - p < (ptrdiff_t)length)
+      return false;
+    memcpy(data, p, length);
+    p += length;
+    return true;
+  };
+  int count;
+  if (!take(&count, 4) || count < 0)
+    return false;
+  for (int i = 0; i < count; i++) {
+    int name_length, obj_type;
+    if (!take(&name_length, 4) || name_length < 0 || end - p < name_length)
+      return false;
+    std::string name(p, name_length);
+    p += name_length;
+    if (!take(&obj_type, 4))
+      return false;
+    entries[name] = static_cast<H5O_type_t>(obj_type);
+  }
+  return true;
+}
+
+herr_t S3VLGroupIndex::load() {
+  Result re = fetchObject(*endpoints, key);
+  std::lock_guard<std::mutex> lock(mtx);
+  if (re.missing)
+    return ARRAYMORPH_SUCCESS; // no links yet
+  if (re.status < 0) {
+    Logger::error("------ Cannot read group index", key);
+    return ARRAYMORPH_FAIL;
+  }
+  if (!decode(re.data, entries)) {
+    Logger::error("------ Malformed group index", key);
+    return ARRAYMORPH_FAIL;
+  }
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLGroupIndex::publish(bool merge) {
+  Logger::log("------ Upload group index", key);
+  std::lock_guard<std::mutex> lock(mtx);
+  if (merge) {
+    Result re = fetchObject(*endpoints, key);
+    std::map<std::string, H5O_type_t> stored;
+    // publishing without the stored links would drop them
+    if (!re.missing && (re.status < 0 || !decode(re.data, stored))) {
+      Logger::error("------ Cannot merge into group index", key);
+      return ARRAYMORPH_FAIL;
+    }
+    entries.insert(stored.begin(), stored.end());
+  }
+  return putObject(endpoints->primary(), key, encode(entries));
+}
+
+void S3VLGroupIndex::add(const std::string &name, H5O_type_t type) {
+  std::lock_guard<std::mutex> lock(mtx);
+  entries[name] = type;
+}
+
+H5O_type_t S3VLGroupIndex::find(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = entries.find(name);
+  return it == entries.end() ? H5O_TYPE_UNKNOWN : it->second;
+}
+
+std::vector<std::pair<std::string, H5O_type_t>> S3VLGroupIndex::links() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return {entries.begin(), entries.end()};
+}
+
+S3VLGroupTree::S3VLGroupTree(const std::string &file,
+                             std::shared_ptr<EndpointPool> endpoints)
+    : file(file), endpoints(std::move(endpoints)) {}
+
+std::string S3VLGroupTree::uri(const std::string &path) const {
+  return path.empty() ? file : file + "/" + path;
+}
+
+std::shared_ptr<S3VLGroupIndex> S3VLGroupTree::open(const std::string &path) {
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  auto it = groups.find(path);
+  if (it != groups.end())
+    return it->second;
+  if (!path.empty()) {
+    auto [parent_path, name] = splitPath(path);
+    auto up = open(parent_path);
+    if (!up || up->find(name) != H5O_TYPE_GROUP)
+      return nullptr;
+  }
+  auto index =
+      std::make_shared<S3VLGroupIndex>(endpoints, uri(path) + "/.index");
+  if (index->load() < 0)
+    return nullptr;
+  groups[path] = index;
+  return index;
+}
+
+std::shared_ptr<S3VLGroupIndex> S3VLGroupTree::parent(const std::string &path,
+                                                      bool intermediate) {
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  auto [parent_path, name] = splitPath(path);
+  if (name.empty()) {
+    Logger::error("------ The root group cannot be created");
+    return nullptr;
+  }
+  auto up = open(parent_path);
+  if (!up && intermediate)
+    up = create(parent_path, true);
+  if (!up) {
+    Logger::error("------ No group", "/" + parent_path);
+    return nullptr;
+  }
+  if (up->find(name) != H5O_TYPE_UNKNOWN) {
+    Logger::error("------ Name already exists:", "/" + path);
+    return nullptr;
+  }
+  return up;
+}
+
+std::shared_ptr<S3VLGroupIndex> S3VLGroupTree::create(const std::string &path,
+                                                      bool intermediate) {
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  auto up = parent(path, intermediate);
+  if (!up)
+    return nullptr;
+  // the group's own index first, so no stored link names a group without
+  // one
+  auto index =
+      std::make_shared<S3VLGroupIndex>(endpoints, uri(path) + "/.index");
+  if (index->publish(false) < 0)
+    return nullptr;
+  up->add(splitPath(path).second, H5O_TYPE_GROUP);
+  if (up->publish() < 0)
+    return nullptr;
+  groups[path] = index;
+  return index;
+}
+
+H5O_type_t S3VLGroupTree::type(const std::string &path) {
+  if (path.empty())
+    return H5O_TYPE_GROUP;
+  auto [parent_path, name] = splitPath(path);
+  auto up = open(parent_path);
+  return up ? up->find(name) : H5O_TYPE_UNKNOWN;
+}
+
+std::string joinPath(const std::string &base, const std::string &name) {
+  std::string path = !name.empty() && name[0] == '/' ? "" : base;
+  size_t beg = 0;
+  while (beg <= name.size()) {
+    size_t end = name.find('/', beg);
+    if (end == std::string::npos)
+      end = name.size();
+    std::string part = name.substr(beg, end - beg);
+    if (!part.empty() && part != ".")
+      path += (path.empty() ? "" : "/") + part;
+    beg = end + 1;
+  }
+  return path;
+}
+
+std::pair<std::string, std::string> splitPath(const std::string &path) {
+  size_t slash = path.rfind('/');
+  if (slash == std::string::npos)
+    return {"", path};
+  return {path.substr(0, slash), path.substr(slash + 1)};
+}
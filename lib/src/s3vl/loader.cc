@@ -0,0 +1,55 @@
+#include "arraymorph/s3vl/loader.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include <utility>
+
+S3VLLoader::S3VLLoader(S3VLDatasetObj *dset)
+    : dset(dset), pool(LOADER_THREAD_NUM) {}
+
+S3VLLoader::~S3VLLoader() {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (auto &[ticket, fut] : pending)
+    fut.wait();
+}
+
+int64_t S3VLLoader::submit(hid_t mem_space_id, hid_t file_space_id,
+                           void *buf) {
+  std::vector<std::vector<hsize_t>> ranges;
+  if (dset->fileRanges(file_space_id, ranges) < 0)
+    return 0;
+  std::vector<hsize_t> out_offsets;
+  hsize_t out_row_size = 0;
+  if (!ranges.empty()) {
+    out_row_size = dset->bufferLayout(mem_space_id, ranges, out_offsets);
+    if (!out_row_size)
+      return 0;
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  int64_t ticket = next_ticket++;
+  pending[ticket] = pool.submit(
+      [this, ranges = std::move(ranges), out_offsets = std::move(out_offsets),
+       out_row_size, buf]() mutable -> herr_t {
+        if (ranges.empty())
+          return ARRAYMORPH_SUCCESS;
+        return dset->read(ranges, out_offsets, out_row_size, buf, false);
+      });
+  return ticket;
+}
+
+herr_t S3VLLoader::wait(int64_t ticket) {
+  std::future<herr_t> fut;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = pending.find(ticket);
+    if (it == pending.end()) {
+      Logger::error("------ Unknown loader ticket", ticket);
+      return ARRAYMORPH_FAIL;
+    }
+    fut = std::move(it->second);
+    pending.erase(it);
+  }
+  herr_t status = fut.get();
+  if (status < 0)
+    Logger::error("------ Loader read of", dset->uri, "failed");
+  return status;
+}
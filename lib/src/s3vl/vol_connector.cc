@@ -1,10 +1,12 @@
 /* This connector's header */
 #include "arraymorph/core/constants.h"
+#include "arraymorph/s3vl/attribute_callbacks.h"
 #include "arraymorph/s3vl/dataset_callbacks.h"
 #include "arraymorph/s3vl/file_callbacks.h"
 #include "arraymorph/s3vl/group_callbacks.h"
 #include "arraymorph/s3vl/initialize.h"
 #include "arraymorph/s3vl/vol_connector.h"
+#include "arraymorph/s3vl/vol_info.h"
 
 #include <H5PLextern.h>
 #include <hdf5.h>
@@ -32,12 +34,12 @@ static const H5VL_class_t template_class_g = {
     S3VLINITIALIZE::s3VL_initialize_close, /* terminate                */
     {
         /* info_cls */
-        (size_t)0, /* size    */
-        NULL,      /* copy    */
-        NULL,      /* compare */
-        NULL,      /* free    */
-        NULL,      /* to_str  */
-        NULL,      /* from_str */
+        sizeof(S3VLInfo),            /* size    */
+        S3VLInfoCallbacks::copy,     /* copy    */
+        S3VLInfoCallbacks::cmp,      /* compare */
+        S3VLInfoCallbacks::free,     /* free    */
+        S3VLInfoCallbacks::to_str,   /* to_str  */
+        S3VLInfoCallbacks::from_str, /* from_str */
     },
     {
         /* wrap_cls */
@@ -49,14 +51,14 @@ static const H5VL_class_t template_class_g = {
     },
     {
         /* attribute_cls */
-        NULL, /* create       */
-        NULL, /* open         */
-        NULL, /* read         */
-        NULL, /* write        */
-        NULL, /* get          */
-        NULL, /* specific     */
-        NULL, /* optional     */
-        NULL  /* close        */
+        S3VLAttrCallbacks::S3VL_attr_create,   /* create       */
+        S3VLAttrCallbacks::S3VL_attr_open,     /* open         */
+        S3VLAttrCallbacks::S3VL_attr_read,     /* read         */
+        S3VLAttrCallbacks::S3VL_attr_write,    /* write        */
+        S3VLAttrCallbacks::S3VL_attr_get,      /* get          */
+        S3VLAttrCallbacks::S3VL_attr_specific, /* specific     */
+        NULL,                                  /* optional     */
+        S3VLAttrCallbacks::S3VL_attr_close     /* close        */
     },
     {
         /* dataset_cls */
@@ -66,7 +68,7 @@ static const H5VL_class_t template_class_g = {
         S3VLDatasetCallbacks::S3VL_dataset_write,    /* write        */
         S3VLDatasetCallbacks::S3VL_dataset_get,      /* get          */
         S3VLDatasetCallbacks::S3VL_dataset_specific, /* specific     */
-        NULL,                                        /* optional     */
+        S3VLDatasetCallbacks::S3VL_dataset_optional, /* optional     */
         S3VLDatasetCallbacks::S3VL_dataset_close     /* close        */
     },
     {
@@ -89,30 +91,29 @@ static const H5VL_class_t template_class_g = {
     },
     {
         /* group_cls */
-        NULL,                               /* create       */
-        S3VLGroupCallbacks::S3VLgroup_open, /* open         */
-        S3VLGroupCallbacks::S3VLgroup_get,  /* get          */
-        // NULL,
-        NULL,                               /* specific     */
-        NULL,                               /* optional     */
-        S3VLGroupCallbacks::S3VLgroup_close // NULL /* close        */
+        S3VLGroupCallbacks::S3VLgroup_create, /* create       */
+        S3VLGroupCallbacks::S3VLgroup_open,   /* open         */
+        S3VLGroupCallbacks::S3VLgroup_get,    /* get          */
+        NULL,                                 /* specific     */
+        NULL,                                 /* optional     */
+        S3VLGroupCallbacks::S3VLgroup_close   /* close        */
     },
     {
         /* link_cls */
-        NULL,                             /* create       */
-        NULL,                             /* copy         */
-        NULL,                             /* move         */
-        S3VLGroupCallbacks::S3VLlink_get, /* get          */
-        NULL, // S3VLGroupCallbacks::S3VLlink_specific, /* specific     */
-        NULL  /* optional     */
+        NULL,                                  /* create       */
+        NULL,                                  /* copy         */
+        NULL,                                  /* move         */
+        S3VLGroupCallbacks::S3VLlink_get,      /* get          */
+        S3VLGroupCallbacks::S3VLlink_specific, /* specific     */
+        NULL                                   /* optional     */
     },
     {
         /* object_cls */
-        S3VLDatasetCallbacks::S3VL_obj_open, /* open         */
-        NULL,                                /* copy         */
-        S3VLDatasetCallbacks::S3VL_obj_get,  /* get          */
-        NULL,                                /* specific     */
-        NULL                                 /* optional     */
+        S3VLDatasetCallbacks::S3VL_obj_open,     /* open         */
+        NULL,                                    /* copy         */
+        S3VLDatasetCallbacks::S3VL_obj_get,      /* get          */
+        S3VLDatasetCallbacks::S3VL_obj_specific, /* specific     */
+        NULL                                     /* optional     */
     },
     {
         /* introscpect_cls */
@@ -151,6 +152,8 @@ static const H5VL_class_t template_class_g = {
 
 static herr_t S3_introspect_opt_query(void *obj, H5VL_subclass_t cls,
                                       int op_type, uint64_t *flags) {
+  if (cls == H5VL_SUBCLS_DATASET && S3VLDatasetCallbacks::isOptionalOp(op_type))
+    *flags = H5VL_OPT_QUERY_SUPPORTED | H5VL_OPT_QUERY_READ_DATA;
   return ARRAYMORPH_SUCCESS;
 }
 
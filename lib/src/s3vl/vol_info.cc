@@ -0,0 +1,121 @@
+#include "arraymorph/s3vl/vol_info.h"
+#include "arraymorph/core/constants.h"
+#include "arraymorph/core/logger.h"
+#include <cstring>
+#include <sstream>
+
+static std::string trim(const std::string &s) {
+  size_t beg = s.find_first_not_of(" \t\n");
+  if (beg == std::string::npos)
+    return "";
+  size_t end = s.find_last_not_of(" \t\n");
+  return s.substr(beg, end - beg + 1);
+}
+
+static bool parseFlag(const std::string &value, std::optional<bool> &flag) {
+  if (value == "true" || value == "1")
+    flag = true;
+  else if (value == "false" || value == "0")
+    flag = false;
+  else
+    return false;
+  return true;
+}
+
+static bool parseEndpoint(const std::string &group, EndpointConfig &config) {
+  std::stringstream ss(group);
+  std::string entry;
+  while (std::getline(ss, entry, ';')) {
+    entry = trim(entry);
+    if (entry.empty())
+      continue;
+    size_t eq = entry.find('=');
+    if (eq == std::string::npos) {
+      Logger::error("------ Connector info: expected key=value: ", entry);
+      return false;
+    }
+    std::string key = trim(entry.substr(0, eq));
+    std::string value = trim(entry.substr(eq + 1));
+    bool ok = true;
+    if (key == "bucket")
+      config.bucket = value;
+    else if (key == "endpoint")
+      config.endpoint = value;
+    else if (key == "region")
+      config.region = value;
+    else if (key == "access_key")
+      config.access_key = value;
+    else if (key == "secret_key")
+      config.secret_key = value;
+    else if (key == "connection_string")
+      config.connection_string = value;
+    else if (key == "tls")
+      ok = parseFlag(value, config.tls);
+    else if (key == "path_style")
+      ok = parseFlag(value, config.path_style);
+    else if (key == "signed_payloads")
+      ok = parseFlag(value, config.signed_payloads);
+    else {
+      Logger::error("------ Connector info: unknown key ", key);
+      return false;
+    }
+    if (!ok) {
+      Logger::error("------ Connector info: ", key, "is true or false");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parseEndpoints(const std::string &config,
+                    std::vector<EndpointConfig> &endpoints) {
+  endpoints.clear();
+  std::stringstream ss(config);
+  std::string group;
+  while (std::getline(ss, group, '|')) {
+    EndpointConfig endpoint;
+    if (!parseEndpoint(group, endpoint))
+      return false;
+    endpoints.push_back(std::move(endpoint));
+  }
+  if (endpoints.empty())
+    endpoints.emplace_back();
+  return true;
+}
+
+void *S3VLInfoCallbacks::copy(const void *info) {
+  return new S3VLInfo(*static_cast<const S3VLInfo *>(info));
+}
+
+herr_t S3VLInfoCallbacks::cmp(int *cmp_value, const void *info1,
+                              const void *info2) {
+  *cmp_value = static_cast<const S3VLInfo *>(info1)->config.compare(
+      static_cast<const S3VLInfo *>(info2)->config);
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLInfoCallbacks::free(void *info) {
+  delete static_cast<S3VLInfo *>(info);
+  return ARRAYMORPH_SUCCESS;
+}
+
+// the caller releases the string with H5free_memory()
+herr_t S3VLInfoCallbacks::to_str(const void *info, char **str) {
+  const std::string &config = static_cast<const S3VLInfo *>(info)->config;
+  *str = static_cast<char *>(H5allocate_memory(config.size() + 1, false));
+  if (!*str)
+    return ARRAYMORPH_FAIL;
+  memcpy(*str, config.c_str(), config.size() + 1);
+  return ARRAYMORPH_SUCCESS;
+}
+
+herr_t S3VLInfoCallbacks::from_str(const char *str, void **info) {
+  auto parsed = new S3VLInfo{str ? trim(str) : ""};
+  std::vector<EndpointConfig> endpoints;
+  if (!parseEndpoints(parsed->config, endpoints)) {
+    delete parsed;
+    return ARRAYMORPH_FAIL;
+  }
+  *info = parsed;
+  return ARRAYMORPH_SUCCESS;
+}
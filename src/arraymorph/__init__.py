@@ -74,6 +74,176 @@ def enable() -> None:
     os.environ.setdefault("HDF5_VOL_CONNECTOR", "arraymorph")
 
 
+# ---------------------------------------------------------------------
+# Connector operations
+# ---------------------------------------------------------------------
+
+
+def reduce(dset, selection=None) -> dict:
+    """
+    Compute sum/min/max/mean/count over `selection` of an ArrayMorph dataset
+    without reading it into memory.
+
+    Chunks are streamed through the plugin's fetch engine and reduced as they
+    arrive, so memory stays bounded by the number of in-flight requests.
+    `selection` is a tuple of contiguous slices/ints; None means everything.
+    """
+    from . import _native
+
+    space = _native.selection_space(dset, selection)
+    result = _native.ReduceResult()
+    status = _native.lib().arraymorph_dataset_reduce(
+        dset.id.id, space.id if space is not None else _native.H5S_ALL, result
+    )
+    _native.check(status, "reduce")
+    return {
+        "sum": result.sum,
+        "min": result.min,
+        "max": result.max,
+        "mean": result.mean,
+        "count": result.count,
+    }
+
+
+def prefetch(dset, selection=None) -> int:
+    """
+    Start fetching the chunks covering `selection` of an ArrayMorph dataset
+    in the background and return immediately.
+
+    Later reads of those chunks are served from the dataset's readahead
+    buffer (ARRAYMORPH_READAHEAD_MB) instead of going to storage. Prefetches
+    run below demand reads in priority. Returns the number of chunk fetches
+    queued; chunks already cached or in flight are not fetched again.
+    """
+    from . import _native
+
+    space = _native.selection_space(dset, selection)
+    queued = _native.ctypes.c_size_t(0)
+    status = _native.lib().arraymorph_dataset_prefetch(
+        dset.id.id,
+        space.id if space is not None else _native.H5S_ALL,
+        _native.ctypes.byref(queued),
+    )
+    _native.check(status, "prefetch")
+    return queued.value
+
+
+def read(file, dataset=None, selection=None, out=None):
+    """
+    Read `selection` of an ArrayMorph dataset into a NumPy array.
+
+    The block is handed to the plugin's planner as start/count, without
+    h5py's selection machinery or HDF5 dataspaces, and lands directly in
+    the array. `file` is an h5py File/Group holding `dataset` (opened once
+    and reused), or the dataset itself. `selection` is a tuple of
+    contiguous slices/ints; None means everything. `out`, when given, must
+    be a C-contiguous, writeable array of the dataset's dtype with as many
+    elements as the selection; otherwise a new array shaped like
+    `dset[selection]` is returned.
+    """
+    import numpy
+    from h5py._objects import phil
+
+    from . import _native
+
+    dset = _native.open_dataset(file, dataset)
+    if dset.ndim == 0:
+        raise ValueError("scalar datasets are not supported")
+    start, count, shape = _native.selection_box(dset, selection)
+    if out is None:
+        out = numpy.empty(shape, dtype=dset.dtype)
+    elif (
+        out.dtype != dset.dtype
+        or out.size != numpy.prod(count)
+        or not out.flags.c_contiguous
+        or not out.flags.writeable
+    ):
+        raise ValueError(
+            f"out must be a writeable C-contiguous {dset.dtype} array "
+            f"of {int(numpy.prod(count))} elements"
+        )
+    start, count = _native.box(start, count)
+    with phil:
+        status = _native.lib().arraymorph_dataset_read_box(
+            dset.id.id, start, count, out.ctypes.data
+        )
+    _native.check(status, "read")
+    return out
+
+
+def write(file, dataset=None, selection=None, data=None) -> None:
+    """
+    Write `data` to `selection` of an ArrayMorph dataset.
+
+    The counterpart of read(): `data` is used in place when it is already a
+    C-contiguous array of the dataset's dtype, and converted once otherwise.
+    It must have as many elements as the selection.
+    """
+    import numpy
+    from h5py._objects import phil
+
+    from . import _native
+
+    dset = _native.open_dataset(file, dataset)
+    if dset.ndim == 0:
+        raise ValueError("scalar datasets are not supported")
+    start, count, _ = _native.selection_box(dset, selection)
+    data = numpy.ascontiguousarray(data, dtype=dset.dtype)
+    if data.size != numpy.prod(count):
+        raise ValueError(
+            f"data has {data.size} elements, the selection "
+            f"{int(numpy.prod(count))}"
+        )
+    start, count = _native.box(start, count)
+    with phil:
+        status = _native.lib().arraymorph_dataset_write_box(
+            dset.id.id, start, count, data.ctypes.data
+        )
+    _native.check(status, "write")
+
+
+def stats(dset=None) -> dict:
+    """
+    Return the plugin's I/O statistics as a dict.
+
+    Without `dset` this is {"process": ..., "planner": ..., "endpoints": ...,
+    "datasets": {...}} covering every dataset opened so far and the request
+    window of every storage endpoint; with an ArrayMorph dataset it is that
+    dataset's section only. Counters include requests, bytes transferred
+    vs. required, retries, failures and cache hits/misses; latencies are
+    histograms with p50/p90/p99 in seconds.
+    """
+    import json
+
+    from . import _native
+
+    handle = _native.lib()
+    size = 1 << 14
+    while True:
+        buf = _native.ctypes.create_string_buffer(size)
+        if dset is None:
+            length = handle.arraymorph_stats_json(buf, size)
+        else:
+            length = _native.ctypes.c_size_t(0)
+            status = handle.arraymorph_dataset_stats_json(
+                dset.id.id, buf, size, _native.ctypes.byref(length)
+            )
+            _native.check(status, "stats")
+            length = length.value
+        if length < size:
+            return json.loads(buf.value.decode())
+        size = length + 1
+
+
+def reset_stats() -> None:
+    """Zero every statistics counter and histogram of the plugin."""
+    from . import _native
+
+    _native.lib().arraymorph_reset_stats()
+
+
+from .loader import Loader  # noqa: E402
+
 # ---------------------------------------------------------------------
 # Public API
 # ---------------------------------------------------------------------
@@ -82,4 +252,11 @@ __all__ = [
     "enable",
     "get_plugin_path",
     "get_plugin_dir",
+    "reduce",
+    "prefetch",
+    "read",
+    "write",
+    "stats",
+    "reset_stats",
+    "Loader",
 ]
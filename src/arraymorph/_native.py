@@ -0,0 +1,158 @@
+"""
+ctypes bindings to the C API exported by the ArrayMorph VOL plugin
+(`lib/include/arraymorph/s3vl/c_api.h`).
+
+The plugin is the same shared object HDF5 loads through HDF5_PLUGIN_PATH, so
+these calls act on the live connector state of the process. ctypes releases
+the GIL for the duration of every call.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import weakref
+from functools import lru_cache
+
+hid_t = ctypes.c_int64
+herr_t = ctypes.c_int
+hsize_t = ctypes.c_uint64
+H5S_ALL = 0
+
+
+class ReduceResult(ctypes.Structure):
+    _fields_ = [
+        ("sum", ctypes.c_double),
+        ("min", ctypes.c_double),
+        ("max", ctypes.c_double),
+        ("mean", ctypes.c_double),
+        ("count", ctypes.c_uint64),
+    ]
+
+
+@lru_cache(maxsize=None)
+def lib() -> ctypes.CDLL:
+    from . import get_plugin_path
+
+    handle = ctypes.CDLL(get_plugin_path())
+    handle.arraymorph_dataset_reduce.argtypes = [
+        hid_t,
+        hid_t,
+        ctypes.POINTER(ReduceResult),
+    ]
+    handle.arraymorph_dataset_reduce.restype = herr_t
+    handle.arraymorph_dataset_prefetch.argtypes = [
+        hid_t,
+        hid_t,
+        ctypes.POINTER(ctypes.c_size_t),
+    ]
+    handle.arraymorph_dataset_prefetch.restype = herr_t
+    handle.arraymorph_stats_json.argtypes = [ctypes.c_char_p, ctypes.c_size_t]
+    handle.arraymorph_stats_json.restype = ctypes.c_size_t
+    handle.arraymorph_dataset_stats_json.argtypes = [
+        hid_t,
+        ctypes.c_char_p,
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_size_t),
+    ]
+    handle.arraymorph_dataset_stats_json.restype = herr_t
+    handle.arraymorph_reset_stats.argtypes = []
+    handle.arraymorph_reset_stats.restype = None
+    for name in ("arraymorph_dataset_read_box", "arraymorph_dataset_write_box"):
+        getattr(handle, name).argtypes = [
+            hid_t,
+            ctypes.POINTER(hsize_t),
+            ctypes.POINTER(hsize_t),
+            ctypes.c_void_p,
+        ]
+        getattr(handle, name).restype = herr_t
+    handle.arraymorph_loader_open.argtypes = [hid_t]
+    handle.arraymorph_loader_open.restype = ctypes.c_void_p
+    handle.arraymorph_loader_submit.argtypes = [
+        ctypes.c_void_p,
+        hid_t,
+        hid_t,
+        ctypes.c_void_p,
+    ]
+    handle.arraymorph_loader_submit.restype = ctypes.c_int64
+    handle.arraymorph_loader_wait.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+    handle.arraymorph_loader_wait.restype = herr_t
+    handle.arraymorph_loader_close.argtypes = [ctypes.c_void_p]
+    handle.arraymorph_loader_close.restype = herr_t
+    return handle
+
+
+# datasets opened by name, per h5py File/Group object: reopening one costs
+# a metadata request. Entries go away with the File/Group object.
+_datasets = weakref.WeakKeyDictionary()
+
+
+def open_dataset(parent, name=None):
+    """
+    Return the dataset `name` of `parent`, opened once per parent object;
+    `parent` itself when `name` is None.
+    """
+    if name is None:
+        return parent
+    opened = _datasets.setdefault(parent, {})
+    dset = opened.get(name)
+    if dset is None or not dset.id.valid:
+        dset = parent[name]
+        opened[name] = dset
+    return dset
+
+
+def box(start, count):
+    """Return `start` and `count` as the hsize_t arrays of the box calls."""
+    n = len(start)
+    return (hsize_t * n)(*start), (hsize_t * n)(*count)
+
+
+def selection_box(dset, selection):
+    """
+    Return (start, count, shape) of `selection` (a tuple of slices/ints) in
+    `dset`: the hyperslab it selects, and the shape NumPy indexing would give
+    the result, without the dimensions indexed by ints. None selects the
+    whole dataset.
+    """
+    if selection is None:
+        selection = ()
+    if not isinstance(selection, tuple):
+        selection = (selection,)
+    if Ellipsis in selection:
+        i = selection.index(Ellipsis)
+        fill = (slice(None),) * (len(dset.shape) - len(selection) + 1)
+        selection = selection[:i] + fill + selection[i + 1 :]
+    selection = selection + (slice(None),) * (len(dset.shape) - len(selection))
+
+    start, count, shape = [], [], []
+    for sel, n in zip(selection, dset.shape):
+        if isinstance(sel, slice):
+            lo, hi, step = sel.indices(n)
+            if step != 1:
+                raise ValueError("only contiguous slices are supported")
+            start.append(lo)
+            count.append(max(hi - lo, 0))
+            shape.append(count[-1])
+        else:
+            i = int(sel) + n if int(sel) < 0 else int(sel)
+            start.append(i)
+            count.append(1)
+    return tuple(start), tuple(count), tuple(shape)
+
+
+def selection_space(dset, selection):
+    """
+    Return an h5py SpaceID selecting `selection` (a tuple of slices/ints)
+    in `dset`, or None for the whole dataset.
+    """
+    if selection is None:
+        return None
+    start, count, _ = selection_box(dset, selection)
+    space = dset.id.get_space()
+    space.select_hyperslab(start, count)
+    return space
+
+
+def check(status: int, what: str) -> None:
+    if status < 0:
+        raise RuntimeError(f"ArrayMorph {what} failed")
@@ -0,0 +1,133 @@
+"""
+Batch loader over an ArrayMorph dataset for input pipelines.
+
+Batches are read by the plugin (`arraymorph_loader_*` in c_api.h) on threads
+of its own, straight into NumPy arrays allocated here, while the training
+loop works on the previous ones. Only queueing a batch touches HDF5; waiting
+for one is a plain ctypes call, which releases the GIL.
+"""
+
+from __future__ import annotations
+
+import collections
+import os
+
+_END = object()
+
+
+class Loader:
+    """
+    Iterate over batches of an ArrayMorph dataset as NumPy arrays.
+
+    `source` is a file path, an open h5py File/Group holding `dataset`, or
+    the dataset itself (with `dataset` left out). `selections` yields one
+    selection per batch, a tuple of contiguous slices/ints as for reduce();
+    it is consumed lazily, so it may be a generator. Up to `depth` batches
+    are queued ahead of the one being returned. Each array owns its buffer
+    and has the shape `dset[selection]` would.
+
+    Do not write the dataset while a loader reads it. Use as a context
+    manager, or call close(), to finish the queued reads and release the
+    dataset (and the file, when it was opened from a path).
+    """
+
+    def __init__(self, source, dataset=None, selections=(), depth=4):
+        import h5py
+        from h5py._objects import phil
+
+        from . import _native
+
+        if depth < 1:
+            raise ValueError("depth must be at least 1")
+        self._handle = None
+        self._file = None
+        if isinstance(source, (str, os.PathLike)):
+            self._file = h5py.File(source, "r")
+            source = self._file
+        self._dset = source if dataset is None else source[dataset]
+        self._selections = iter(selections)
+        self._depth = depth
+        self._queue = collections.deque()
+        with phil:
+            self._handle = _native.lib().arraymorph_loader_open(
+                self._dset.id.id
+            )
+        if not self._handle:
+            self.close()
+            raise RuntimeError("ArrayMorph loader open failed")
+
+    def _submit(self, selection) -> None:
+        import h5py
+        import numpy
+        from h5py._objects import phil
+
+        from . import _native
+
+        start, count, shape = _native.selection_box(self._dset, selection)
+        array = numpy.empty(shape, dtype=self._dset.dtype)
+        with phil:
+            file_space = self._dset.id.get_space()
+            file_space.select_hyperslab(start, count)
+            mem_space = h5py.h5s.create_simple(count)
+            ticket = _native.lib().arraymorph_loader_submit(
+                self._handle, mem_space.id, file_space.id, array.ctypes.data
+            )
+        if ticket == 0:
+            raise ValueError(f"invalid selection {selection!r}")
+        self._queue.append((ticket, array))
+
+    def _fill(self) -> None:
+        while len(self._queue) < self._depth:
+            selection = next(self._selections, _END)
+            if selection is _END:
+                return
+            self._submit(selection)
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        from . import _native
+
+        if not self._handle:
+            raise ValueError("loader is closed")
+        self._fill()
+        if not self._queue:
+            raise StopIteration
+        ticket, array = self._queue.popleft()
+        # keep `depth` batches in flight while this one is waited for
+        self._fill()
+        status = _native.lib().arraymorph_loader_wait(self._handle, ticket)
+        _native.check(status, "batch read")
+        return array
+
+    def close(self) -> None:
+        """Finish the queued reads and release the dataset."""
+        from h5py._objects import phil
+
+        from . import _native
+
+        if self._handle:
+            handle = _native.lib()
+            # wait outside the HDF5 lock, so other threads can use h5py
+            for ticket, _ in self._queue:
+                handle.arraymorph_loader_wait(self._handle, ticket)
+            with phil:
+                handle.arraymorph_loader_close(self._handle)
+            self._handle = None
+        self._queue.clear()
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass